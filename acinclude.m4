@@ -0,0 +1,31 @@
+dnl Project-local additions to the configure script generated by zproject,
+dnl which calls the AX_PROJECT_LOCAL_HOOK* macros defined here so they survive
+dnl re-generation of configure.ac
+
+AC_DEFUN([AX_PROJECT_LOCAL_HOOK], [
+    dnl USDT probes are compiled in when systemtap's header is available
+    AC_CHECK_HEADERS([sys/sdt.h])
+
+    dnl LuaJIT provides the Lua 5.1 API, when requested it is used instead of lua
+    AC_ARG_WITH([luajit],
+        [
+            AS_HELP_STRING([--with-luajit=yes/no],
+            [Build the evaluator against LuaJIT instead of lua, needs --with-lua=no (default no)])
+        ],
+        [],
+        [with_luajit=no])
+
+    AS_IF([test x"${with_luajit}" = xyes], [
+        AS_IF([test x"${search_lua}" != xno],
+            [AC_MSG_ERROR([--with-luajit replaces lua, configure it together with --with-lua=no])])
+        PKG_CHECK_MODULES([luajit], [luajit >= 2.0.0],
+            [
+                PKGCFG_NAMES_PRIVATE="$PKGCFG_NAMES_PRIVATE luajit >= 2.0.0"
+                CFLAGS="${luajit_CFLAGS} ${CFLAGS}"
+                CXXFLAGS="${luajit_CFLAGS} ${CXXFLAGS}"
+                LIBS="${luajit_LIBS} ${LIBS}"
+                AC_DEFINE(HAVE_LUAJIT, 1, [The evaluator is built against LuaJIT])
+            ],
+            [AC_MSG_ERROR([Cannot find pkg-config metadata for luajit 2.0.0 or higher])])
+    ])
+])
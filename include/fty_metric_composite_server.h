@@ -32,6 +32,11 @@ extern "C" {
 FTY_METRIC_COMPOSITE_EXPORT void
     fty_metric_composite_server (zsock_t *pipe, void* args);
 
+//  Wait for the reply of the actor to CONNECT or CONFIG, log the reason of an error
+//  0 - OK, -1 - ERROR or interrupted
+FTY_METRIC_COMPOSITE_EXPORT int
+    fty_metric_composite_server_wait (zactor_t *self, const char *command);
+
 //  Self test of this class
 FTY_METRIC_COMPOSITE_EXPORT void
     fty_metric_composite_server_test (bool verbose);
@@ -130,6 +130,8 @@ find %{buildroot} -name '*.la' | xargs rm -f
 %{_mandir}/man1/fty-metric-composite*
 %{_bindir}/fty-metric-composite-configurator
 %{_mandir}/man1/fty-metric-composite-configurator*
+%{_bindir}/fty-metric-composite-capture
+%{_mandir}/man1/fty-metric-composite-capture*
 %config(noreplace) %{_sysconfdir}/fty-metric-composite/fty-metric-composite.cfg
 %{SYSTEMD_UNIT_DIR}/fty-metric-composite@.service
 %config(noreplace) %{_sysconfdir}/fty-metric-composite/fty-metric-composite-configurator.cfg
@@ -30,6 +30,7 @@
 
 int
 actor_commands (
+        zsock_t *pipe,
         c_metric_conf_t *cfg,
         data_t **data_p,
         zmsg_t **message_p)
@@ -169,6 +170,83 @@ actor_commands (
         c_metric_conf_set_cfgdir (cfg, cfgdir);
         zstr_free (&cfgdir);
     }
+    else
+    if (streq (cmd, "STATS")) {
+        zmsg_t *reply = c_metric_stats_encode (c_metric_conf_stats (cfg), *data_p);
+        if (!reply) {
+            log_error ("c_metric_stats_encode () failed");
+        }
+        else
+        if (!pipe) {
+            zmsg_destroy (&reply);
+        }
+        else
+        if (zmsg_send (&reply, pipe) != 0) {
+            log_error ("zmsg_send (STATS reply) failed");
+            zmsg_destroy (&reply);
+        }
+    }
+    else
+    if (streq (cmd, "STATS_INTERVAL")) {
+        char *interval = zmsg_popstr (message);
+        if (!interval) {
+            log_error (
+                    "Expected multipart string format: STATS_INTERVAL/interval."
+                    "Received STATS_INTERVAL/nullptr");
+            zstr_free (&cmd);
+            zmsg_destroy (message_p);
+            return 0;
+        }
+        c_metric_conf_set_stats_interval (cfg, atoi (interval));
+        log_info ("Statistics are published every %d ms (0 = never)", c_metric_conf_stats_interval (cfg));
+        zstr_free (&interval);
+    }
+    else
+    if (streq (cmd, "DRY_RUN")) {
+        char *answer = zmsg_popstr (message);
+        if (!answer) {
+            log_error (
+                    "Expected multipart string format: DRY_RUN/answer."
+                    "Received DRY_RUN/nullptr");
+            zstr_free (&cmd);
+            zmsg_destroy (message_p);
+            return 0;
+        }
+        c_metric_conf_set_dry_run (cfg, streq (answer, "true"));
+        zstr_free (&answer);
+    }
+    else
+    if (streq (cmd, "MANIFEST")) {
+        char *manifest = zmsg_popstr (message);
+        if (!manifest) {
+            log_error (
+                    "Expected multipart string format: MANIFEST/name."
+                    "Received MANIFEST/nullptr");
+            zstr_free (&cmd);
+            zmsg_destroy (message_p);
+            return 0;
+        }
+        c_metric_conf_set_manifest (cfg, manifest);
+        log_info ("Composites are written %s%s", *manifest ? "into manifest " : "into a file each", manifest);
+        zstr_free (&manifest);
+    }
+    else
+    if (streq (cmd, "ASSET")) {
+        fty_proto_t *proto = fty_proto_decode (message_p);
+        if (!proto || fty_proto_id (proto) != FTY_PROTO_ASSET) {
+            log_error (
+                    "Expected multipart string format: ASSET/fty_proto ASSET message."
+                    "Received something else");
+            fty_proto_destroy (&proto);
+            zstr_free (&cmd);
+            return 0;
+        }
+        data_asset_store (*data_p, &proto);
+    }
+    else
+    if (streq (cmd, "REGENERATE")) {
+        ret = 2;
+    }
     else {
         log_warning ("Command '%s' is unknown or not implemented", cmd);
     }
@@ -216,7 +294,7 @@ actor_commands_test (bool verbose)
     // empty message - expected fail
     message = zmsg_new ();
     assert (message);
-    int rv = actor_commands (cfg, &data, &message);
+    int rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
 
@@ -226,7 +304,7 @@ actor_commands_test (bool verbose)
     message = zmsg_new ();
     assert (message);
     zmsg_addstr (message, "");
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -236,7 +314,7 @@ actor_commands_test (bool verbose)
     message = zmsg_new ();
     assert (message);
     zmsg_addstr (message, "MAGIC!");
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -247,7 +325,7 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "CFG_DIRECTORY");
     // missing config_file here
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -258,7 +336,7 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "CFG_DIRECTORY");
     zmsg_addstr (message, "/etc/passwd"); // supplied path is not a directory
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -269,7 +347,7 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "CFG_DIRECTORY");
     zmsg_addstr (message, "/sdssdf/sfef//sdfe"); // non-existing path
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -281,7 +359,7 @@ actor_commands_test (bool verbose)
     zmsg_addstr (message, "CONNECT");
     // missing endpoint here
     // missing name here
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
 
@@ -291,7 +369,7 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "CONNECT");
     zmsg_addstr (message, "ipc://bios-smtp-server-BAD");
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
 
@@ -302,7 +380,7 @@ actor_commands_test (bool verbose)
     zmsg_addstr (message, "CONSUMER");
     zmsg_addstr (message, "some-stream");
     // missing pattern here
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
 
@@ -313,7 +391,7 @@ actor_commands_test (bool verbose)
     zmsg_addstr (message, "CONSUMER");
     // missing stream here
     // missing pattern here
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
 
@@ -323,7 +401,7 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "PRODUCER");
     // missing stream here
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
 
@@ -332,7 +410,7 @@ actor_commands_test (bool verbose)
     message = zmsg_new ();
     assert (message);
     zmsg_addstr (message, "$TERM");
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 1);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -342,7 +420,7 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "CONNECT");
     zmsg_addstr (message, endpoint);
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -353,7 +431,7 @@ actor_commands_test (bool verbose)
     zmsg_addstr (message, "CONSUMER");
     zmsg_addstr (message, "some-stream");
     zmsg_addstr (message, ".+@.+");
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -363,7 +441,7 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "PRODUCER");
     zmsg_addstr (message, "some-stream");
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), ""));
@@ -373,7 +451,7 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "CFG_DIRECTORY");
     zmsg_addstr (message, "./");
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), "./"));
@@ -386,11 +464,129 @@ actor_commands_test (bool verbose)
     assert (message);
     zmsg_addstr (message, "CFG_DIRECTORY");
     zmsg_addstr (message, SELFTEST_DIR_RW);
-    rv = actor_commands (cfg, &data, &message);
+    rv = actor_commands (NULL, cfg, &data, &message);
     assert (rv == 0);
     assert (message == NULL);
     assert (streq (c_metric_conf_cfgdir (cfg), SELFTEST_DIR_RW));
 
+    // STATS_INTERVAL - expected fail
+    message = zmsg_new ();
+    assert (message);
+    zmsg_addstr (message, "STATS_INTERVAL");
+    // missing interval here
+    rv = actor_commands (NULL, cfg, &data, &message);
+    assert (rv == 0);
+    assert (message == NULL);
+    assert (c_metric_conf_stats_interval (cfg) == 0);
+
+    // STATS_INTERVAL
+    message = zmsg_new ();
+    assert (message);
+    zmsg_addstr (message, "STATS_INTERVAL");
+    zmsg_addstr (message, "15000");
+    rv = actor_commands (NULL, cfg, &data, &message);
+    assert (rv == 0);
+    assert (message == NULL);
+    assert (c_metric_conf_stats_interval (cfg) == 15000);
+
+    // STATS, reply goes to the pipe
+    {
+        zsock_t *reader = zsock_new_pair ("@inproc://actor-commands-test-stats");
+        zsock_t *writer = zsock_new_pair (">inproc://actor-commands-test-stats");
+        assert (reader && writer);
+        message = zmsg_new ();
+        assert (message);
+        zmsg_addstr (message, "STATS");
+        rv = actor_commands (writer, cfg, &data, &message);
+        assert (rv == 0);
+        assert (message == NULL);
+        zmsg_t *reply = zmsg_recv (reader);
+        assert (reply);
+        char *part = zmsg_popstr (reply);
+        assert (streq (part, "STATS"));
+        zstr_free (&part);
+        part = zmsg_popstr (reply);
+        assert (streq (part, "assets"));
+        zstr_free (&part);
+        zmsg_destroy (&reply);
+        zsock_destroy (&writer);
+        zsock_destroy (&reader);
+    }
+
+    // DRY_RUN - expected fail
+    message = zmsg_new ();
+    assert (message);
+    zmsg_addstr (message, "DRY_RUN");
+    // missing answer here
+    rv = actor_commands (NULL, cfg, &data, &message);
+    assert (rv == 0);
+    assert (message == NULL);
+    assert (c_metric_conf_dry_run (cfg) == false);
+
+    // DRY_RUN
+    message = zmsg_new ();
+    assert (message);
+    zmsg_addstr (message, "DRY_RUN");
+    zmsg_addstr (message, "true");
+    rv = actor_commands (NULL, cfg, &data, &message);
+    assert (rv == 0);
+    assert (message == NULL);
+    assert (c_metric_conf_dry_run (cfg) == true);
+
+    // MANIFEST
+    message = zmsg_new ();
+    assert (message);
+    zmsg_addstr (message, "MANIFEST");
+    zmsg_addstr (message, "composites");
+    rv = actor_commands (NULL, cfg, &data, &message);
+    assert (rv == 0);
+    assert (message == NULL);
+    assert (streq (c_metric_conf_manifest (cfg), "composites"));
+
+    // MANIFEST - empty name goes back to a file per composite
+    message = zmsg_new ();
+    assert (message);
+    zmsg_addstr (message, "MANIFEST");
+    zmsg_addstr (message, "");
+    rv = actor_commands (NULL, cfg, &data, &message);
+    assert (rv == 0);
+    assert (message == NULL);
+    assert (c_metric_conf_manifest (cfg) == NULL);
+
+    // ASSET - expected fail
+    message = zmsg_new ();
+    assert (message);
+    zmsg_addstr (message, "ASSET");
+    zmsg_addstr (message, "not a fty_proto");
+    rv = actor_commands (NULL, cfg, &data, &message);
+    assert (rv == 0);
+    assert (message == NULL);
+    assert (data_asset_count (data) == 0);
+
+    // ASSET
+    {
+        fty_proto_t *asset = fty_proto_new (FTY_PROTO_ASSET);
+        fty_proto_set_name (asset, "%s", "Rack01");
+        fty_proto_set_operation (asset, "%s", FTY_PROTO_ASSET_OP_CREATE);
+        fty_proto_aux_insert (asset, "type", "%s", "rack");
+        message = fty_proto_encode (&asset);
+        assert (message);
+        zmsg_pushstr (message, "ASSET");
+        rv = actor_commands (NULL, cfg, &data, &message);
+        assert (rv == 0);
+        assert (message == NULL);
+        assert (data_asset_count (data) == 1);
+        assert (data_asset (data, "Rack01"));
+    }
+
+    // REGENERATE
+    message = zmsg_new ();
+    assert (message);
+    zmsg_addstr (message, "REGENERATE");
+    rv = actor_commands (NULL, cfg, &data, &message);
+    assert (rv == 2);
+    assert (message == NULL);
+
     zmsg_destroy (&message);
     c_metric_conf_destroy (&cfg);
     data_destroy (&data);
@@ -50,12 +50,32 @@ extern "C" {
 //  CFG_DIRECTORY/cfg_directory
 //      set pathname of output config files to 'cfg_directory'
 //
+//  STATS
+//      reply on 'pipe' with STATS/key1/value1/key2/value2/... (see c_metric_stats)
+//
+//  STATS_INTERVAL/interval
+//      publish runtime statistics as metrics every 'interval' ms, 0 disables it
+//
+//  DRY_RUN/true|false
+//      write configuration files, but do not call systemctl
+//
+//  MANIFEST/name
+//      write all composites into one manifest <cfg_directory>/<name>.cfg,
+//      empty 'name' switches back to a file per composite
+//
+//  ASSET/<encoded fty_proto ASSET message>
+//      store the asset as if it came on ASSETS stream
+//
+//  REGENERATE
+//      regenerate configuration right now, signalled by return value 2
+//
 
 // Performs the actor commands logic
 // Destroys the message
-// Returns 1 for $TERM (means exit), 0 otherwise
+// Returns 1 for $TERM (means exit), 2 for REGENERATE, 0 otherwise
 FTY_METRIC_COMPOSITE_EXPORT int
     actor_commands (
+        zsock_t *pipe,
         c_metric_conf_t *cfg,
         data_t **data_p,
         zmsg_t **message_p);
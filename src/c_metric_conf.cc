@@ -39,6 +39,10 @@ struct _c_metric_conf_t {
     mlm_client_t *client;           // malamute client
     char *configuration_dir;        // configuration directory
     bool is_propagation_needed;     // should sensors be propagated in topology?
+    c_metric_stats_t *stats;        // runtime statistics
+    int stats_interval;             // period of self-metrics publication in ms, 0 - disabled
+    bool dry_run;                   // write configuration, but do not call systemctl
+    char *manifest;                 // name of the manifest of all composites, NULL - file per composite
 };
 
 //  --------------------------------------------------------------------------
@@ -56,7 +60,9 @@ c_metric_conf_new (const char *name)
             self->client = mlm_client_new ();
         if ( self->client)
             self->configuration_dir = strdup ("");
-        if (self->configuration_dir) {
+        if (self->configuration_dir)
+            self->stats = c_metric_stats_new ();
+        if (self->stats) {
             self->verbose = false;
             self->is_propagation_needed = true;
         }
@@ -80,6 +86,8 @@ c_metric_conf_destroy (c_metric_conf_t **self_p)
 //        data_destroy (&self->asset_data);
         mlm_client_destroy (&self->client);
         zstr_free (&self->configuration_dir);
+        zstr_free (&self->manifest);
+        c_metric_stats_destroy (&self->stats);
         // free structure itself
         free (self);
         *self_p = NULL;
@@ -126,6 +134,78 @@ c_metric_conf_set_propagation (c_metric_conf_t *self, bool is_propagation_needed
     self->is_propagation_needed = is_propagation_needed;
 }
 
+//  --------------------------------------------------------------------------
+//  Get runtime statistics
+
+c_metric_stats_t *
+c_metric_conf_stats (c_metric_conf_t *self)
+{
+    assert (self);
+    return self->stats;
+}
+
+//  --------------------------------------------------------------------------
+//  Get period of self-metrics publication in ms, 0 means disabled
+
+int
+c_metric_conf_stats_interval (c_metric_conf_t *self)
+{
+    assert (self);
+    return self->stats_interval;
+}
+
+//  --------------------------------------------------------------------------
+//  Set period of self-metrics publication in ms, 0 disables it
+
+void
+c_metric_conf_set_stats_interval (c_metric_conf_t *self, int interval)
+{
+    assert (self);
+    self->stats_interval = interval > 0 ? interval : 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Get dry run mode
+
+bool
+c_metric_conf_dry_run (c_metric_conf_t *self)
+{
+    assert (self);
+    return self->dry_run;
+}
+
+//  --------------------------------------------------------------------------
+//  Set dry run mode
+
+void
+c_metric_conf_set_dry_run (c_metric_conf_t *self, bool dry_run)
+{
+    assert (self);
+    self->dry_run = dry_run;
+}
+
+//  --------------------------------------------------------------------------
+//  Get name of the manifest, NULL if every composite has its own file
+
+const char *
+c_metric_conf_manifest (c_metric_conf_t *self)
+{
+    assert (self);
+    return self->manifest;
+}
+
+//  --------------------------------------------------------------------------
+//  Set name of the manifest, NULL or empty switches back to a file per composite
+
+void
+c_metric_conf_set_manifest (c_metric_conf_t *self, const char *manifest)
+{
+    assert (self);
+    zstr_free (&self->manifest);
+    if (manifest && *manifest)
+        self->manifest = strdup (manifest);
+}
+
 //  --------------------------------------------------------------------------
 //  Get path to configuration directory
 
@@ -223,6 +303,29 @@ c_metric_conf_test (bool verbose)
     } // scope
 
 
+    //  =================================================================
+    log_trace ("Test3: stats set/get test");
+    assert (c_metric_conf_stats (self));
+    assert (c_metric_conf_stats_interval (self) == 0);
+    c_metric_conf_set_stats_interval (self, 60000);
+    assert (c_metric_conf_stats_interval (self) == 60000);
+    c_metric_conf_set_stats_interval (self, -1);
+    assert (c_metric_conf_stats_interval (self) == 0);
+
+    //  =================================================================
+    log_trace ("Test4: dry run set/get test");
+    assert (c_metric_conf_dry_run (self) == false);
+    c_metric_conf_set_dry_run (self, true);
+    assert (c_metric_conf_dry_run (self) == true);
+
+    //  =================================================================
+    log_trace ("Test5: manifest set/get test");
+    assert (c_metric_conf_manifest (self) == NULL);
+    c_metric_conf_set_manifest (self, "composites");
+    assert (streq (c_metric_conf_manifest (self), "composites"));
+    c_metric_conf_set_manifest (self, "");
+    assert (c_metric_conf_manifest (self) == NULL);
+
     c_metric_conf_destroy (&self);
     //  @end
     log_info (" * c_metric_conf: OK\n");
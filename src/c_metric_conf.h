@@ -64,6 +64,37 @@ FTY_METRIC_COMPOSITE_EXPORT bool
 FTY_METRIC_COMPOSITE_EXPORT void
     c_metric_conf_set_propagation (c_metric_conf_t *self, bool is_propagation_needed);
 
+//  Get runtime statistics
+FTY_METRIC_COMPOSITE_EXPORT c_metric_stats_t *
+    c_metric_conf_stats (c_metric_conf_t *self);
+
+//  Get period of self-metrics publication in ms, 0 means disabled
+FTY_METRIC_COMPOSITE_EXPORT int
+    c_metric_conf_stats_interval (c_metric_conf_t *self);
+
+//  Set period of self-metrics publication in ms, 0 disables it
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_conf_set_stats_interval (c_metric_conf_t *self, int interval);
+
+//  Get dry run mode: configuration files are written, but services are
+//  not enabled, started nor stopped
+FTY_METRIC_COMPOSITE_EXPORT bool
+    c_metric_conf_dry_run (c_metric_conf_t *self);
+
+//  Set dry run mode
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_conf_set_dry_run (c_metric_conf_t *self, bool dry_run);
+
+//  Get name of the manifest: all composites are written into one file
+//  <cfgdir>/<manifest>.cfg run by service fty-metric-composite@<manifest>.
+//  NULL if every composite has its own file and service
+FTY_METRIC_COMPOSITE_EXPORT const char *
+    c_metric_conf_manifest (c_metric_conf_t *self);
+
+//  Set name of the manifest, NULL or empty switches back to a file per composite
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_conf_set_manifest (c_metric_conf_t *self, const char *manifest);
+
 //  Get path to confuration directory
 FTY_METRIC_COMPOSITE_EXPORT const char *
     c_metric_conf_cfgdir (c_metric_conf_t *self);
@@ -0,0 +1,336 @@
+/*  =========================================================================
+    c_metric_stats - runtime statistics of composite-metrics-configurator
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    c_metric_stats - runtime statistics of composite-metrics-configurator:
+                     durations of reconfiguration phases, systemctl calls,
+                     ASSETS stream throughput and queue lag.
+@discuss
+    Statistics are returned on the actor pipe as reply to STATS command
+    and optionally published as metrics '<key>@<agent name>' into shm.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+static const char *phase_names [C_METRIC_STATS_PHASES] = {
+    "last_remove_ms",
+    "last_reassign_ms",
+    "last_generate_ms",
+    "last_systemctl_ms",
+    "last_regenerate_ms"
+};
+
+struct _c_metric_stats_t {
+    int64_t phase_ms [C_METRIC_STATS_PHASES];   // duration of the last run of each phase
+    uint64_t regenerations;         // number of finished reconfigurations
+    uint64_t systemctl_calls;       // number of systemctl calls
+    uint64_t systemctl_failures;    // number of failed systemctl calls
+    int64_t systemctl_ms;           // systemctl time accumulated in current run
+    uint64_t asset_messages;        // number of processed ASSETS messages
+    uint64_t rate_messages;         // asset_messages at the start of rate window
+    int64_t rate_start;             // start of rate window (zclock_mono)
+    double rate;                    // ASSETS messages per second in last window
+    int64_t backlog_since;          // queue is non-empty since (zclock_mono), 0 - empty
+    int64_t last_queue_lag_ms;      // how long the last backlog lasted
+    int64_t max_queue_lag_ms;       // the longest backlog seen
+};
+
+//  --------------------------------------------------------------------------
+//  Create a new empty statistics
+
+c_metric_stats_t *
+c_metric_stats_new (void)
+{
+    c_metric_stats_t *self = (c_metric_stats_t *) zmalloc (sizeof (c_metric_stats_t));
+    if (self) {
+        self->rate_start = zclock_mono ();
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the c_metric_stats
+
+void
+c_metric_stats_destroy (c_metric_stats_t **self_p)
+{
+    if (!self_p)
+        return;
+    if (*self_p) {
+        free (*self_p);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Record one systemctl call, its duration and whether it failed
+
+void
+c_metric_stats_systemctl (c_metric_stats_t *self, int64_t duration_ms, bool failed)
+{
+    assert (self);
+    self->systemctl_calls++;
+    if (failed)
+        self->systemctl_failures++;
+    self->systemctl_ms += duration_ms;
+}
+
+//  --------------------------------------------------------------------------
+//  Record duration of the last run of the reconfiguration phase
+
+void
+c_metric_stats_phase (c_metric_stats_t *self, c_metric_stats_phase_t phase, int64_t duration_ms)
+{
+    assert (self);
+    assert (phase < C_METRIC_STATS_PHASES);
+    self->phase_ms [phase] = duration_ms;
+    // systemctl is not a phase of its own, it is spread over remove and
+    // generate; the whole run closes the accumulation window
+    if (phase == C_METRIC_STATS_REGENERATE) {
+        self->phase_ms [C_METRIC_STATS_SYSTEMCTL] = self->systemctl_ms;
+        self->systemctl_ms = 0;
+        self->regenerations++;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Get duration of the last run of the reconfiguration phase
+
+int64_t
+c_metric_stats_phase_duration (c_metric_stats_t *self, c_metric_stats_phase_t phase)
+{
+    assert (self);
+    assert (phase < C_METRIC_STATS_PHASES);
+    return self->phase_ms [phase];
+}
+
+//  --------------------------------------------------------------------------
+//  Record one processed ASSETS message
+
+void
+c_metric_stats_asset_message (c_metric_stats_t *self, bool pending)
+{
+    assert (self);
+    self->asset_messages++;
+    if (pending) {
+        if (self->backlog_since == 0)
+            self->backlog_since = zclock_mono ();
+    }
+    else
+    if (self->backlog_since != 0) {
+        self->last_queue_lag_ms = zclock_mono () - self->backlog_since;
+        if (self->last_queue_lag_ms > self->max_queue_lag_ms)
+            self->max_queue_lag_ms = self->last_queue_lag_ms;
+        self->backlog_since = 0;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Tell that the actor was busy since 'since_ms' and messages queued meanwhile
+
+void
+c_metric_stats_backlog (c_metric_stats_t *self, int64_t since_ms)
+{
+    assert (self);
+    if (self->backlog_since == 0 || self->backlog_since > since_ms)
+        self->backlog_since = since_ms;
+}
+
+//  --------------------------------------------------------------------------
+//  Getters
+
+uint64_t
+c_metric_stats_asset_messages (c_metric_stats_t *self)
+{
+    assert (self);
+    return self->asset_messages;
+}
+
+uint64_t
+c_metric_stats_systemctl_calls (c_metric_stats_t *self)
+{
+    assert (self);
+    return self->systemctl_calls;
+}
+
+uint64_t
+c_metric_stats_systemctl_failures (c_metric_stats_t *self)
+{
+    assert (self);
+    return self->systemctl_failures;
+}
+
+//  --------------------------------------------------------------------------
+//  Make a snapshot of all statistics as list of key/value pairs.
+//  Rate is recomputed only if at least one second passed since the last
+//  snapshot, so that frequent STATS requests do not produce noise.
+
+static std::vector <std::pair <std::string, std::string>>
+s_snapshot (c_metric_stats_t *self, data_t *data)
+{
+    int64_t now = zclock_mono ();
+    if (now - self->rate_start >= 1000) {
+        self->rate = (double) (self->asset_messages - self->rate_messages) * 1000.0 / (double) (now - self->rate_start);
+        self->rate_messages = self->asset_messages;
+        self->rate_start = now;
+    }
+    int64_t queue_lag = self->last_queue_lag_ms;
+    if (self->backlog_since != 0)
+        queue_lag = now - self->backlog_since;
+
+    std::vector <std::pair <std::string, std::string>> result;
+    result.push_back (std::make_pair ("assets", std::to_string (data ? data_asset_count (data) : 0)));
+    result.push_back (std::make_pair ("sensors_placed", std::to_string (data ? data_sensors_placed (data) : 0)));
+    result.push_back (std::make_pair ("composites", std::to_string (data ? data_get_produced_metrics (data).size () : 0)));
+    result.push_back (std::make_pair ("regenerations", std::to_string (self->regenerations)));
+    for (int i = 0; i < C_METRIC_STATS_PHASES; i++)
+        result.push_back (std::make_pair (phase_names [i], std::to_string (self->phase_ms [i])));
+    result.push_back (std::make_pair ("systemctl_calls", std::to_string (self->systemctl_calls)));
+    result.push_back (std::make_pair ("systemctl_failures", std::to_string (self->systemctl_failures)));
+    result.push_back (std::make_pair ("asset_messages", std::to_string (self->asset_messages)));
+    char rate [32];
+    snprintf (rate, sizeof (rate), "%.2f", self->rate);
+    result.push_back (std::make_pair ("asset_messages_per_sec", rate));
+    result.push_back (std::make_pair ("queue_lag_ms", std::to_string (queue_lag)));
+    result.push_back (std::make_pair ("max_queue_lag_ms", std::to_string (self->max_queue_lag_ms)));
+    return result;
+}
+
+//  --------------------------------------------------------------------------
+//  Encode statistics as a message STATS/key1/value1/key2/value2/...
+
+zmsg_t *
+c_metric_stats_encode (c_metric_stats_t *self, data_t *data)
+{
+    assert (self);
+    zmsg_t *message = zmsg_new ();
+    if (!message)
+        return NULL;
+    zmsg_addstr (message, "STATS");
+    for (const auto &item : s_snapshot (self, data)) {
+        zmsg_addstr (message, item.first.c_str ());
+        zmsg_addstr (message, item.second.c_str ());
+    }
+    return message;
+}
+
+//  --------------------------------------------------------------------------
+//  Publish statistics as metrics '<key>@<name>' into shm with given ttl
+
+void
+c_metric_stats_publish (c_metric_stats_t *self, data_t *data, const char *name, uint32_t ttl)
+{
+    assert (self);
+    assert (name);
+    for (const auto &item : s_snapshot (self, data)) {
+        fty_proto_t *metric = fty_proto_new (FTY_PROTO_METRIC);
+        fty_proto_set_name (metric, "%s", name);
+        fty_proto_set_type (metric, "configurator.%s", item.first.c_str ());
+        fty_proto_set_value (metric, "%s", item.second.c_str ());
+        fty_proto_set_unit (metric, "%s", "");
+        fty_proto_set_ttl (metric, ttl);
+        fty_proto_set_time (metric, time (NULL));
+        if (fty::shm::write_metric (metric) != 0) {
+            log_error ("shm publish of 'configurator.%s@%s' failed.", item.first.c_str (), name);
+        }
+        fty_proto_destroy (&metric);
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+c_metric_stats_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("c-metric-stats-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    c_metric_stats_t *self = c_metric_stats_new ();
+    assert (self);
+
+    c_metric_stats_systemctl (self, 10, false);
+    c_metric_stats_systemctl (self, 20, true);
+    assert (c_metric_stats_systemctl_calls (self) == 2);
+    assert (c_metric_stats_systemctl_failures (self) == 1);
+
+    c_metric_stats_phase (self, C_METRIC_STATS_REMOVE, 5);
+    c_metric_stats_phase (self, C_METRIC_STATS_REGENERATE, 50);
+    assert (c_metric_stats_phase_duration (self, C_METRIC_STATS_REMOVE) == 5);
+    assert (c_metric_stats_phase_duration (self, C_METRIC_STATS_REGENERATE) == 50);
+    // systemctl time is accumulated over the whole run
+    assert (c_metric_stats_phase_duration (self, C_METRIC_STATS_SYSTEMCTL) == 30);
+    c_metric_stats_phase (self, C_METRIC_STATS_REGENERATE, 1);
+    assert (c_metric_stats_phase_duration (self, C_METRIC_STATS_SYSTEMCTL) == 0);
+
+    c_metric_stats_asset_message (self, true);
+    c_metric_stats_asset_message (self, false);
+    assert (c_metric_stats_asset_messages (self) == 2);
+
+    data_t *data = data_new ();
+    zmsg_t *message = c_metric_stats_encode (self, data);
+    assert (message);
+    char *part = zmsg_popstr (message);
+    assert (streq (part, "STATS"));
+    zstr_free (&part);
+    // key/value pairs
+    assert (zmsg_size (message) % 2 == 0);
+    bool seen_calls = false;
+    char *key = zmsg_popstr (message);
+    while (key) {
+        char *value = zmsg_popstr (message);
+        assert (value);
+        if (streq (key, "systemctl_calls")) {
+            assert (streq (value, "2"));
+            seen_calls = true;
+        }
+        if (streq (key, "assets"))
+            assert (streq (value, "0"));
+        zstr_free (&value);
+        zstr_free (&key);
+        key = zmsg_popstr (message);
+    }
+    assert (seen_calls);
+    zmsg_destroy (&message);
+    data_destroy (&data);
+
+    c_metric_stats_destroy (&self);
+    assert (self == NULL);
+    c_metric_stats_destroy (&self);
+    //  @end
+    log_info (" * c_metric_stats: OK\n");
+}
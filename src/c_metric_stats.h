@@ -0,0 +1,104 @@
+/*  =========================================================================
+    c_metric_stats - runtime statistics of composite-metrics-configurator
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef C_METRIC_STATS_H_INCLUDED
+#define C_METRIC_STATS_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _c_metric_stats_t c_metric_stats_t;
+
+//  Phases of one reconfiguration, durations are kept for the last run
+typedef enum {
+    C_METRIC_STATS_REMOVE = 0,      // s_remove_and_stop ()
+    C_METRIC_STATS_REASSIGN,        // data_reassign_sensors ()
+    C_METRIC_STATS_GENERATE,        // s_generate_and_start () for all assets
+    C_METRIC_STATS_SYSTEMCTL,       // time spent in systemctl during the run
+    C_METRIC_STATS_REGENERATE,      // whole s_regenerate ()
+    C_METRIC_STATS_PHASES           // sentinel
+} c_metric_stats_phase_t;
+
+//  @interface
+//  Create a new empty statistics
+FTY_METRIC_COMPOSITE_EXPORT c_metric_stats_t *
+    c_metric_stats_new (void);
+
+//  Record one systemctl call, its duration and whether it failed
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_stats_systemctl (c_metric_stats_t *self, int64_t duration_ms, bool failed);
+
+//  Record duration of the last run of the reconfiguration phase
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_stats_phase (c_metric_stats_t *self, c_metric_stats_phase_t phase, int64_t duration_ms);
+
+//  Get duration of the last run of the reconfiguration phase
+FTY_METRIC_COMPOSITE_EXPORT int64_t
+    c_metric_stats_phase_duration (c_metric_stats_t *self, c_metric_stats_phase_t phase);
+
+//  Record one processed ASSETS message; 'pending' says whether more messages
+//  were already waiting in the queue after this one was received
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_stats_asset_message (c_metric_stats_t *self, bool pending);
+
+//  Tell that the actor was busy since 'since_ms' (zclock_mono) and messages
+//  queued meanwhile; queue lag is then counted from that moment
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_stats_backlog (c_metric_stats_t *self, int64_t since_ms);
+
+//  Get number of processed ASSETS messages
+FTY_METRIC_COMPOSITE_EXPORT uint64_t
+    c_metric_stats_asset_messages (c_metric_stats_t *self);
+
+//  Get number of systemctl calls
+FTY_METRIC_COMPOSITE_EXPORT uint64_t
+    c_metric_stats_systemctl_calls (c_metric_stats_t *self);
+
+//  Get number of failed systemctl calls
+FTY_METRIC_COMPOSITE_EXPORT uint64_t
+    c_metric_stats_systemctl_failures (c_metric_stats_t *self);
+
+//  Encode statistics (together with sizes taken from 'data') as a message
+//  STATS/key1/value1/key2/value2/...
+//  The caller is responsible for destroying the return value when finished with it
+FTY_METRIC_COMPOSITE_EXPORT zmsg_t *
+    c_metric_stats_encode (c_metric_stats_t *self, data_t *data);
+
+//  Publish statistics as metrics '<key>@<name>' into shm with given ttl
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_stats_publish (c_metric_stats_t *self, data_t *data, const char *name, uint32_t ttl);
+
+//  Destroy the c_metric_stats
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_stats_destroy (c_metric_stats_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    c_metric_stats_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
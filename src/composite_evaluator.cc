@@ -0,0 +1,2219 @@
+/*  =========================================================================
+    composite_evaluator - evaluation of one composite metric configuration
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    composite_evaluator - evaluation of one composite metric configuration
+@discuss
+    Keeps the last value of every input and evaluates the configured Lua
+    code and/or builtin reductions over inputs which are still valid.
+    One evaluation can produce any number of output metrics: Lua code may
+    return a table of {topic, value, unit} triples (or tables with fields
+    topic, value and unit), and every builtin reduction produces one.
+
+    With "groups" the inputs are partitioned by group key (e.g. rack name)
+    and builtin reductions produce one metric per group, "{group}" in their
+    topic is replaced by the key. Inputs are stored in one flat table
+    ordered by group and only groups with inputs updated since the last
+    evaluation are evaluated, unless "evaluate_every_ms" makes the
+    evaluation periodic - then all groups are evaluated each time. Count,
+    sum, min and max of all these groups are computed by one call of
+    reduction_kernel.
+
+    Windowed reductions (moving_average, window_min, window_max, rate and
+    ewma) work on the last N samples of one input, kept in sample_window
+    which updates the statistics in O(1) when the sample arrives.
+
+    Lua code which is exactly the average script generated by
+    fty-metric-composite-configurator (table of offsets, sum/num loop and
+    the error when all sensors are lost) is recognized when loaded and
+    replaced by the builtin average with the same offsets, topic and unit,
+    failing with the same error when no input is valid. Any other code,
+    including a script with an input without offset, is run by Lua.
+
+    Simple formulas ("expression") are compiled by composite_expression
+    when the configuration is loaded and evaluated over the input arrays
+    without Lua; inputs they read need not be listed in "in".
+
+    Lua code gets the valid inputs in global table 'mt' (topic -> value)
+    and is run in a fresh Lua state on each evaluation, so no state is
+    kept between evaluations.
+
+    Every run of the Lua code has a budget ("limits"): a count hook raises
+    an error after the given number of VM instructions, and the allocator
+    of the state accounts the memory in use and refuses allocations above
+    the limit, which Lua turns into an out of memory error. Both end the
+    run with COMPOSITE_EVALUATOR_LIMIT, the evaluator stays usable.
+
+    When built against LuaJIT (configure --with-lua=no --with-luajit), the
+    count hook of the instruction limit turns the JIT compiler off for the
+    state, so only configurations with "instructions": 0 run compiled code.
+    LuaJIT without GC64 refuses custom allocators on 64 bit; the state then
+    comes from luaL_newstate, without the arena and the memory limit.
+
+    Lua states take their memory from a lua_arena of the evaluator, which
+    is reset in bulk after lua_close, so repeated evaluations reuse the same
+    chunks instead of going through malloc for every block. Allocations and
+    peak bytes of the last run are kept for the statistics.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+#include "fty_metric_composite_trace.h"
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+#if defined (HAVE_LUAJIT)
+#include <luajit.h>
+#endif
+}
+
+#include <cmath>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <limits>
+#include <climits>
+#include <algorithm>
+#include <cxxtools/jsondeserializer.h>
+
+typedef enum {
+    REDUCTION_AVERAGE = 0,
+    REDUCTION_MIN,
+    REDUCTION_MAX,
+    REDUCTION_SUM,
+    REDUCTION_COUNT,
+    // over the window of one input
+    REDUCTION_MOVING_AVERAGE,
+    REDUCTION_WINDOW_MIN,
+    REDUCTION_WINDOW_MAX,
+    REDUCTION_RATE,
+    REDUCTION_EWMA
+} reduction_function_t;
+
+static const char *reduction_names [] = {
+    "average", "min", "max", "sum", "count",
+    "moving_average", "window_min", "window_max", "rate", "ewma", NULL
+};
+
+//  Default number of samples in the window
+#define WINDOW_SAMPLES 10
+
+//  Placeholder of the group key in topics of reductions
+#define GROUP "{group}"
+
+//  Default budget of one run of the Lua code
+#define LUA_INSTRUCTIONS    10000000
+#define LUA_MEMORY_KB       16384
+
+//  Memory of Lua states is taken from the system in chunks of this size
+#define LUA_ARENA_CHUNK     (64 * 1024)
+
+//  Accounting of one Lua state, user data of its allocator
+typedef struct {
+    lua_arena_t *arena;
+    size_t memory;                  // bytes in use
+    size_t memory_limit;            // bytes, 0 - unlimited
+    bool memory_exceeded;
+    bool instructions_exceeded;
+} lua_budget_t;
+
+typedef struct {
+    reduction_function_t function;
+    std::string topic;
+    std::string unit;
+    std::string input;      // windowed functions only
+    size_t slot;            // position of 'input'
+} reduction_t;
+
+typedef struct {
+    composite_expression_t *expression;
+    std::string topic;
+    std::string unit;
+} expression_t;
+
+struct _composite_evaluator_t {
+    std::string name;
+    std::string source;                     // file the configuration was loaded from
+    std::vector <std::string> inputs;
+    std::vector <std::string> outputs;      // declared
+    std::map <std::string, size_t> index;   // topic -> position in inputs
+    std::vector <double> values;
+    std::vector <time_t> valid_till;
+    std::vector <double> offsets;           // used by builtin reductions
+    std::vector <sample_window_t *> windows; // of inputs used by windowed reductions, NULL otherwise
+    std::vector <std::string> groups;       // group keys, empty without "groups"
+    std::vector <size_t> group_begin;       // inputs of group g are [group_begin [g], group_begin [g + 1])
+    std::vector <size_t> slot_group;        // position in inputs -> group
+    std::vector <bool> group_dirty;
+    std::vector <size_t> dirty;             // groups updated since the last evaluation
+    std::vector <reduction_stats_t> group_stats;    // of dirty groups, kept to avoid allocation
+    std::string lua_code;
+    std::string lua_chunk;                  // precompiled lua_code, empty if it does not compile
+    std::vector <reduction_t> reductions;
+    std::vector <expression_t> expressions;
+    int64_t period;                         // evaluate_every_ms, 0 - on arrival of input
+    int64_t lua_instructions;               // limits of one run, 0 - unlimited
+    int64_t lua_memory_kb;
+    bool legacy_average;                    // "evaluation" recognized as the average of the configurator
+    lua_arena_t *lua_arena;                 // memory of Lua states, NULL without "evaluation"
+    size_t lua_allocations;                 // of the last run
+    size_t lua_peak;                        // bytes
+    std::string error;
+};
+
+//  Destroy compiled formulas
+static void
+s_expressions_destroy (std::vector <expression_t> &expressions)
+{
+    for (auto &expression : expressions)
+        composite_expression_destroy (&expression.expression);
+    expressions.clear ();
+}
+
+//  Trim white space from both ends of 'line'
+static std::string
+s_trim (const std::string &line)
+{
+    size_t begin = line.find_first_not_of (" \t\r");
+    if (begin == std::string::npos)
+        return "";
+    return line.substr (begin, line.find_last_not_of (" \t\r") + 1 - begin);
+}
+
+//  Parse "<prefix>'<quoted>'<suffix>" where quoted has no quotes nor escapes
+static bool
+s_match_quoted (const std::string &line, const char *prefix, const char *suffix, std::string &quoted)
+{
+    size_t prefix_length = strlen (prefix);
+    size_t suffix_length = strlen (suffix);
+    if (line.size () < prefix_length + suffix_length + 2
+    ||  line.compare (0, prefix_length, prefix) != 0
+    ||  line.compare (line.size () - suffix_length, suffix_length, suffix) != 0
+    ||  line [prefix_length] != '\'')
+        return false;
+    size_t end = line.find ('\'', prefix_length + 1);
+    if (end != line.size () - suffix_length - 1)
+        return false;
+    quoted = line.substr (prefix_length + 1, end - prefix_length - 1);
+    return quoted.find ('\\') == std::string::npos;
+}
+
+//  Parse decimal literal of Lua, optionally negated
+static bool
+s_match_number (const std::string &text, double &value)
+{
+    size_t i = text [0] == '-' ? 1 : 0;
+    size_t digits = 0;
+    while (i < text.size () && (isdigit ((unsigned char) text [i]) || text [i] == '.')) {
+        digits += isdigit ((unsigned char) text [i]) ? 1 : 0;
+        i++;
+    }
+    if (digits == 0 || std::count (text.begin (), text.end (), '.') > 1)
+        return false;
+    if (i < text.size () && (text [i] == 'e' || text [i] == 'E')) {
+        i++;
+        if (i < text.size () && (text [i] == '+' || text [i] == '-'))
+            i++;
+        if (i == text.size ())
+            return false;
+        while (i < text.size () && isdigit ((unsigned char) text [i]))
+            i++;
+    }
+    if (i != text.size ())
+        return false;
+    value = strtod (text.c_str (), NULL);
+    return std::isfinite (value);
+}
+
+//  Recognize the average script generated by the configurator, line by line
+//  except empty lines and indentation
+static bool
+s_legacy_average (const std::string &code, std::map <std::string, double> &offsets, std::string &topic, std::string &unit)
+{
+    static const char *body [] = {
+        "sum = 0;",
+        "num = 0;",
+        "for key,value in pairs(mt) do",
+        "sum = sum + value + offsets[key];",
+        "num = num + 1;",
+        "end;",
+        "if num == 0 then error('all sensors lost'); end;",
+        "tmp = sum / num;",
+        NULL
+    };
+    std::vector <std::string> lines;
+    std::istringstream stream (code);
+    std::string line;
+    while (std::getline (stream, line)) {
+        line = s_trim (line);
+        if (!line.empty ())
+            lines.push_back (line);
+    }
+    size_t i = 0;
+    if (lines.empty () || lines [i++] != "offsets = {};")
+        return false;
+    for (; i < lines.size () && lines [i].compare (0, 8, "offsets[") == 0; i++) {
+        size_t assign = lines [i].find ("'] = ");
+        std::string offset_topic;
+        double offset;
+        if (assign == std::string::npos
+        ||  !s_match_quoted (lines [i].substr (0, assign + 2), "offsets[", "]", offset_topic)
+        ||  lines [i].back () != ';'
+        ||  !s_match_number (lines [i].substr (assign + 5, lines [i].size () - assign - 6), offset))
+            return false;
+        offsets [offset_topic] = offset;
+    }
+    for (int j = 0; body [j]; j++, i++) {
+        if (i == lines.size () || lines [i] != body [j])
+            return false;
+    }
+    if (i + 1 != lines.size ())
+        return false;
+    // return '<topic>', tmp, '<unit>', 0;
+    size_t separator = lines [i].find ("', tmp, '");
+    return separator != std::string::npos
+        && s_match_quoted (lines [i].substr (0, separator + 1), "return ", "", topic)
+        && s_match_quoted (lines [i].substr (separator + 8), "", ", 0;", unit);
+}
+
+//  Replace the placeholder in 'topic' by 'group'
+static std::string
+s_group_topic (const std::string &topic, const std::string &group)
+{
+    std::string result = topic;
+    size_t position = result.find (GROUP);
+    if (position != std::string::npos)
+        result.replace (position, strlen (GROUP), group);
+    return result;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new empty evaluator
+
+composite_evaluator_t *
+composite_evaluator_new (const char *name)
+{
+    assert (name);
+    composite_evaluator_t *self = new composite_evaluator_t ();
+    self->name = name;
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the composite_evaluator
+
+void
+composite_evaluator_destroy (composite_evaluator_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        composite_evaluator_t *self = *self_p;
+        for (auto window : self->windows)
+            sample_window_destroy (&window);
+        lua_arena_destroy (&self->lua_arena);
+        s_expressions_destroy (self->expressions);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+//  Configuration as read from a JSON or a compiled file, before it is applied
+typedef struct {
+    std::vector <std::string> inputs;
+    std::vector <std::string> outputs;                          // "out"
+    std::vector <std::pair <std::string, std::string>> groups;  // topic, group
+    std::map <std::string, double> offsets;
+    std::string lua_code;
+    std::string lua_chunk;              // precompiled lua_code, empty if not available
+    std::vector <reduction_t> reductions;
+    std::vector <std::string> formulas;         // of expressions
+    std::vector <expression_t> expressions;     // topic and unit, formulas are compiled when applied
+    uint64_t window_samples;
+    double window_alpha;
+    int64_t period;
+    int64_t lua_instructions;
+    int64_t lua_memory_kb;
+    bool legacy_average;
+} config_t;
+
+//  Configuration with all defaults
+static config_t
+s_config_new (void)
+{
+    config_t config;
+    config.window_samples = WINDOW_SAMPLES;
+    config.window_alpha = 0;
+    config.period = 0;
+    config.lua_instructions = LUA_INSTRUCTIONS;
+    config.lua_memory_kb = LUA_MEMORY_KB;
+    config.legacy_average = false;
+    return config;
+}
+
+//  Read the whole file with one read; 0 - success, -1 - error
+static int
+s_read_file (const char *filename, std::string &data)
+{
+    int fd = open (filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+    struct stat info;
+    int rv = fstat (fd, &info);
+    if (rv == 0) {
+        data.resize ((size_t) info.st_size);
+        ssize_t size = info.st_size > 0 ? read (fd, &data [0], data.size ()) : 0;
+        rv = size == (ssize_t) data.size () ? 0 : -1;
+    }
+    close (fd);
+    return rv;
+}
+
+//  Writer of lua_dump, appends to the chunk
+static int
+s_lua_writer (lua_State *L, const void *data, size_t size, void *chunk)
+{
+    (void) L;
+    ((std::string *) chunk)->append ((const char *) data, size);
+    return 0;
+}
+
+//  Precompile Lua code into 'chunk', which each evaluation then loads without
+//  the parser. Code which does not compile leaves 'chunk' empty, the error is
+//  reported by the evaluation as before.
+static void
+s_lua_compile (const std::string &code, std::string &chunk)
+{
+    chunk.clear ();
+    lua_State *L = luaL_newstate ();
+    if (!L)
+        return;
+    if (luaL_loadbuffer (L, code.c_str (), code.length (), "line") == 0) {
+#if LUA_VERSION_NUM >= 503
+        lua_dump (L, s_lua_writer, &chunk, 0);
+#else
+        lua_dump (L, s_lua_writer, &chunk);
+#endif
+    }
+    lua_close (L);
+}
+
+//  Compiled configuration: magic, table of distinct strings (topics, units, Lua
+//  code and bytecode) and the configuration referring to them by index.
+//  Numbers are in host byte order, the file is made on the host which loads it.
+
+//  Writer of the compiled form
+typedef struct {
+    std::map <std::string, uint32_t> index;
+    std::vector <std::string> strings;
+    std::string body;
+} compiled_writer_t;
+
+static void
+s_put (compiled_writer_t &writer, const void *data, size_t size)
+{
+    writer.body.append ((const char *) data, size);
+}
+
+static void
+s_put_u32 (compiled_writer_t &writer, uint32_t value)
+{
+    s_put (writer, &value, sizeof (value));
+}
+
+static void
+s_put_i64 (compiled_writer_t &writer, int64_t value)
+{
+    s_put (writer, &value, sizeof (value));
+}
+
+static void
+s_put_double (compiled_writer_t &writer, double value)
+{
+    s_put (writer, &value, sizeof (value));
+}
+
+//  Put index of the string, the string is stored once
+static void
+s_put_string (compiled_writer_t &writer, const std::string &text)
+{
+    auto it = writer.index.find (text);
+    if (it == writer.index.end ()) {
+        it = writer.index.insert (std::make_pair (text, (uint32_t) writer.strings.size ())).first;
+        writer.strings.push_back (text);
+    }
+    s_put_u32 (writer, it->second);
+}
+
+//  Encode the configuration
+static std::string
+s_encode (const config_t &config)
+{
+    compiled_writer_t writer;
+    s_put_string (writer, composite_evaluator_lua_version ());
+    s_put_u32 (writer, (uint32_t) config.inputs.size ());
+    for (const auto &topic : config.inputs)
+        s_put_string (writer, topic);
+    s_put_u32 (writer, (uint32_t) config.outputs.size ());
+    for (const auto &topic : config.outputs)
+        s_put_string (writer, topic);
+    s_put_u32 (writer, (uint32_t) config.groups.size ());
+    for (const auto &group : config.groups) {
+        s_put_string (writer, group.first);
+        s_put_string (writer, group.second);
+    }
+    s_put_u32 (writer, (uint32_t) config.offsets.size ());
+    for (const auto &offset : config.offsets) {
+        s_put_string (writer, offset.first);
+        s_put_double (writer, offset.second);
+    }
+    s_put_string (writer, config.lua_code);
+    s_put_string (writer, config.lua_chunk);
+    s_put_u32 (writer, (uint32_t) config.reductions.size ());
+    for (const auto &reduction : config.reductions) {
+        s_put_u32 (writer, (uint32_t) reduction.function);
+        s_put_string (writer, reduction.topic);
+        s_put_string (writer, reduction.unit);
+        s_put_string (writer, reduction.input);
+    }
+    s_put_u32 (writer, (uint32_t) config.expressions.size ());
+    for (size_t i = 0; i < config.expressions.size (); i++) {
+        s_put_string (writer, config.formulas [i]);
+        s_put_string (writer, config.expressions [i].topic);
+        s_put_string (writer, config.expressions [i].unit);
+    }
+    s_put_i64 (writer, (int64_t) config.window_samples);
+    s_put_double (writer, config.window_alpha);
+    s_put_i64 (writer, config.period);
+    s_put_i64 (writer, config.lua_instructions);
+    s_put_i64 (writer, config.lua_memory_kb);
+    s_put_u32 (writer, config.legacy_average ? 1 : 0);
+
+    std::string data = COMPOSITE_EVALUATOR_COMPILED_MAGIC;
+    uint32_t count = (uint32_t) writer.strings.size ();
+    data.append ((const char *) &count, sizeof (count));
+    for (const auto &text : writer.strings) {
+        uint32_t length = (uint32_t) text.size ();
+        data.append ((const char *) &length, sizeof (length));
+        data.append (text);
+    }
+    data.append (writer.body);
+    return data;
+}
+
+//  Reader of the compiled form, any read past the end marks it failed
+typedef struct {
+    const std::string *data;
+    size_t position;
+    bool failed;
+    std::vector <std::string> strings;
+} compiled_reader_t;
+
+static void
+s_get (compiled_reader_t &reader, void *value, size_t size)
+{
+    if (reader.failed || size > reader.data->size () - reader.position) {
+        reader.failed = true;
+        memset (value, 0, size);
+        return;
+    }
+    memcpy (value, reader.data->data () + reader.position, size);
+    reader.position += size;
+}
+
+static uint32_t
+s_get_u32 (compiled_reader_t &reader)
+{
+    uint32_t value;
+    s_get (reader, &value, sizeof (value));
+    return value;
+}
+
+static int64_t
+s_get_i64 (compiled_reader_t &reader)
+{
+    int64_t value;
+    s_get (reader, &value, sizeof (value));
+    return value;
+}
+
+static double
+s_get_double (compiled_reader_t &reader)
+{
+    double value;
+    s_get (reader, &value, sizeof (value));
+    return value;
+}
+
+static std::string
+s_get_string (compiled_reader_t &reader)
+{
+    uint32_t index = s_get_u32 (reader);
+    if (index >= reader.strings.size ()) {
+        reader.failed = true;
+        return "";
+    }
+    return reader.strings [index];
+}
+
+//  Count of items which are at least 'size' bytes each, bounded by the rest of the data
+static uint32_t
+s_get_count (compiled_reader_t &reader, size_t size)
+{
+    uint32_t count = s_get_u32 (reader);
+    if (!reader.failed && count > (reader.data->size () - reader.position) / size)
+        reader.failed = true;
+    return reader.failed ? 0 : count;
+}
+
+//  True if 'data' is a compiled configuration
+static bool
+s_is_compiled (const std::string &data)
+{
+    return data.compare (0, strlen (COMPOSITE_EVALUATOR_COMPILED_MAGIC), COMPOSITE_EVALUATOR_COMPILED_MAGIC) == 0;
+}
+
+//  Decode the compiled configuration; 0 - success, -1 - malformed
+static int
+s_decode (const std::string &data, config_t &config)
+{
+    if (!s_is_compiled (data))
+        return -1;
+    compiled_reader_t reader = {&data, strlen (COMPOSITE_EVALUATOR_COMPILED_MAGIC), false, {}};
+    uint32_t count = s_get_count (reader, sizeof (uint32_t));
+    for (uint32_t i = 0; i < count && !reader.failed; i++) {
+        uint32_t length = s_get_u32 (reader);
+        if (reader.failed || length > data.size () - reader.position)
+            return -1;
+        reader.strings.push_back (data.substr (reader.position, length));
+        reader.position += length;
+    }
+    // bytecode of another Lua is not loaded, the code is compiled again
+    bool same_lua = s_get_string (reader) == composite_evaluator_lua_version ();
+    count = s_get_count (reader, sizeof (uint32_t));
+    for (uint32_t i = 0; i < count; i++)
+        config.inputs.push_back (s_get_string (reader));
+    count = s_get_count (reader, sizeof (uint32_t));
+    for (uint32_t i = 0; i < count; i++)
+        config.outputs.push_back (s_get_string (reader));
+    count = s_get_count (reader, 2 * sizeof (uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        std::string topic = s_get_string (reader);
+        config.groups.push_back (std::make_pair (topic, s_get_string (reader)));
+    }
+    count = s_get_count (reader, sizeof (uint32_t) + sizeof (double));
+    for (uint32_t i = 0; i < count; i++) {
+        std::string topic = s_get_string (reader);
+        config.offsets [topic] = s_get_double (reader);
+    }
+    config.lua_code = s_get_string (reader);
+    config.lua_chunk = s_get_string (reader);
+    if (!same_lua)
+        config.lua_chunk.clear ();
+    count = s_get_count (reader, 4 * sizeof (uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        reduction_t reduction;
+        uint32_t function = s_get_u32 (reader);
+        if (function > REDUCTION_EWMA) {
+            reader.failed = true;
+            function = REDUCTION_AVERAGE;
+        }
+        reduction.function = (reduction_function_t) function;
+        reduction.topic = s_get_string (reader);
+        reduction.unit = s_get_string (reader);
+        reduction.input = s_get_string (reader);
+        reduction.slot = 0;
+        config.reductions.push_back (reduction);
+    }
+    count = s_get_count (reader, 3 * sizeof (uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        expression_t expression = {NULL, "", ""};
+        config.formulas.push_back (s_get_string (reader));
+        expression.topic = s_get_string (reader);
+        expression.unit = s_get_string (reader);
+        config.expressions.push_back (expression);
+    }
+    config.window_samples = (uint64_t) s_get_i64 (reader);
+    config.window_alpha = s_get_double (reader);
+    config.period = s_get_i64 (reader);
+    config.lua_instructions = s_get_i64 (reader);
+    config.lua_memory_kb = s_get_i64 (reader);
+    config.legacy_average = s_get_u32 (reader) != 0;
+    return reader.failed || reader.position != data.size () ? -1 : 0;
+}
+
+//  Parse the deserialized JSON configuration; 0 - success, -1 - error
+static int
+s_parse_si (const char *name, const char *filename, const cxxtools::SerializationInfo *si, config_t &config)
+{
+    try {
+        const cxxtools::SerializationInfo *member = si->findMember ("groups");
+        if (member) {
+            for (const auto &it : *member) {
+                std::string group;
+                it >>= group;
+                config.groups.push_back (std::make_pair (it.name (), group));
+            }
+        }
+        // "in" is optional only when inputs are given by "groups"
+        member = config.groups.empty () ? &si->getMember ("in") : si->findMember ("in");
+        if (member) {
+            for (const auto &it : *member) {
+                std::string topic;
+                it >>= topic;
+                config.inputs.push_back (topic);
+            }
+        }
+        member = si->findMember ("evaluation");
+        if (member)
+            *member >>= config.lua_code;
+        member = si->findMember ("expression");
+        if (member) {
+            // one {"formula", "topic", "unit"} or a list of them
+            std::vector <const cxxtools::SerializationInfo *> items;
+            if (member->isArray ()) {
+                for (const auto &it : *member)
+                    items.push_back (&it);
+            }
+            else
+                items.push_back (member);
+            for (const auto item : items) {
+                expression_t expression = {NULL, "", ""};
+                std::string formula;
+                item->getMember ("formula") >>= formula;
+                item->getMember ("topic") >>= expression.topic;
+                const cxxtools::SerializationInfo *unit = item->findMember ("unit");
+                if (unit)
+                    *unit >>= expression.unit;
+                config.formulas.push_back (formula);
+                config.expressions.push_back (expression);
+            }
+        }
+        member = si->findMember ("out");
+        if (member) {
+            for (const auto &it : *member) {
+                std::string topic;
+                it >>= topic;
+                config.outputs.push_back (topic);
+            }
+        }
+        member = si->findMember ("offsets");
+        if (member) {
+            for (const auto &it : *member) {
+                double offset;
+                it >>= offset;
+                config.offsets [it.name ()] = offset;
+            }
+        }
+        member = si->findMember ("reductions");
+        if (member) {
+            for (const auto &it : *member) {
+                std::string function;
+                reduction_t reduction;
+                it.getMember ("function") >>= function;
+                it.getMember ("topic") >>= reduction.topic;
+                const cxxtools::SerializationInfo *unit = it.findMember ("unit");
+                if (unit)
+                    *unit >>= reduction.unit;
+                int i = 0;
+                while (reduction_names [i] && function != reduction_names [i])
+                    i++;
+                if (!reduction_names [i]) {
+                    log_error ("%s:\tUnknown reduction '%s' in '%s'", name, function.c_str (), filename);
+                    return -1;
+                }
+                reduction.function = (reduction_function_t) i;
+                if (reduction.function >= REDUCTION_MOVING_AVERAGE)
+                    it.getMember ("input") >>= reduction.input;
+                config.reductions.push_back (reduction);
+            }
+        }
+        member = si->findMember ("evaluate_every_ms");
+        if (member)
+            *member >>= config.period;
+        member = si->findMember ("limits");
+        if (member) {
+            const cxxtools::SerializationInfo *limit = member->findMember ("instructions");
+            if (limit)
+                *limit >>= config.lua_instructions;
+            limit = member->findMember ("memory_kb");
+            if (limit)
+                *limit >>= config.lua_memory_kb;
+        }
+        member = si->findMember ("window");
+        if (member) {
+            const cxxtools::SerializationInfo *samples = member->findMember ("samples");
+            if (samples)
+                *samples >>= config.window_samples;
+            const cxxtools::SerializationInfo *alpha = member->findMember ("alpha");
+            if (alpha)
+                *alpha >>= config.window_alpha;
+        }
+    }
+    catch (const std::exception &e) {
+        log_error ("Cannot deserialize cfg file! with '%s'", e.what ());
+        return -1;
+    }
+    if (!config.lua_code.empty () && config.groups.empty () && config.reductions.empty () && config.expressions.empty ()) {
+        std::map <std::string, double> legacy_offsets;
+        reduction_t reduction;
+        reduction.function = REDUCTION_AVERAGE;
+        // the script fails on an input without offset, so let it do so
+        bool legacy_average = s_legacy_average (config.lua_code, legacy_offsets, reduction.topic, reduction.unit);
+        for (const auto &topic : config.inputs)
+            legacy_average = legacy_average && legacy_offsets.count (topic);
+        if (legacy_average) {
+            log_debug ("%s:\tAverage script of '%s' is evaluated natively", name, filename);
+            config.lua_code.clear ();
+            config.reductions.push_back (reduction);
+            config.offsets = legacy_offsets;
+            config.legacy_average = true;
+        }
+    }
+    return 0;
+}
+
+//  Parse the JSON configuration; 0 - success, -1 - error
+static int
+s_parse_json (const char *name, const char *filename, const std::string &data, config_t &config)
+{
+    try {
+        std::istringstream stream (data);
+        cxxtools::JsonDeserializer json (stream);
+        json.deserialize ();
+        return s_parse_si (name, filename, json.si (), config);
+    }
+    catch (const std::exception &e) {
+        log_error ("Cannot deserialize cfg file! with '%s'", e.what ());
+        return -1;
+    }
+}
+
+//  Apply the configuration to the evaluator; 0 - success, -1 - error
+static int
+s_apply (composite_evaluator_t *self, const config_t &config, const char *filename)
+{
+    std::vector <std::string> inputs = config.inputs;
+    std::vector <std::string> outputs = config.outputs;
+    const auto &groups = config.groups;
+    const auto &formulas = config.formulas;
+    const std::string &lua_code = config.lua_code;
+    std::vector <reduction_t> reductions = config.reductions;
+    std::vector <expression_t> expressions = config.expressions;
+    double window_alpha = config.window_alpha;
+    if (lua_code.empty () && reductions.empty () && expressions.empty ()) {
+        log_error ("%s:\tNeither 'evaluation', 'expression' nor 'reductions' in '%s'", self->name.c_str (), filename);
+        return -1;
+    }
+    for (size_t i = 0; i < expressions.size (); i++) {
+        std::string error;
+        expressions [i].expression = composite_expression_new (formulas [i].c_str (), error);
+        if (!expressions [i].expression) {
+            log_error ("%s:\tExpression '%s': %s in '%s'", self->name.c_str (), formulas [i].c_str (), error.c_str (), filename);
+            s_expressions_destroy (expressions);
+            return -1;
+        }
+        // inputs of formulas are implicit
+        for (const auto &topic : composite_expression_topics (expressions [i].expression)) {
+            if (std::find (inputs.begin (), inputs.end (), topic) == inputs.end ())
+                inputs.push_back (topic);
+        }
+    }
+
+    // inputs of one group are kept next to each other
+    std::vector <std::string> group_names;
+    std::vector <std::vector <std::string>> members;
+    if (groups.empty ()) {
+        group_names.push_back ("");
+        members.push_back (inputs);
+    }
+    else {
+        if (!lua_code.empty () || !expressions.empty ()) {
+            log_error ("%s:\t'evaluation' and 'expression' cannot be used with 'groups' in '%s'", self->name.c_str (), filename);
+            s_expressions_destroy (expressions);
+            return -1;
+        }
+        for (const auto &reduction : reductions) {
+            if (reduction.function >= REDUCTION_MOVING_AVERAGE) {
+                log_error ("%s:\tWindowed reduction '%s' cannot be used with 'groups' in '%s'", self->name.c_str (), reduction_names [reduction.function], filename);
+                return -1;
+            }
+            if (reduction.topic.find (GROUP) == std::string::npos) {
+                log_error ("%s:\tTopic '%s' does not contain %s in '%s'", self->name.c_str (), reduction.topic.c_str (), GROUP, filename);
+                return -1;
+            }
+        }
+        std::map <std::string, size_t> group_index;
+        for (const auto &it : groups) {
+            auto group = group_index.find (it.second);
+            if (group == group_index.end ()) {
+                group = group_index.insert (std::make_pair (it.second, group_names.size ())).first;
+                group_names.push_back (it.second);
+                members.push_back (std::vector <std::string> ());
+            }
+            members [group->second].push_back (it.first);
+        }
+        std::set <std::string> grouped;
+        for (const auto &it : groups)
+            grouped.insert (it.first);
+        for (const auto &topic : inputs) {
+            if (!grouped.count (topic)) {
+                log_error ("%s:\tInput '%s' is not in any group in '%s'", self->name.c_str (), topic.c_str (), filename);
+                return -1;
+            }
+        }
+    }
+
+    self->inputs.clear ();
+    self->index.clear ();
+    self->slot_group.clear ();
+    self->group_begin.clear ();
+    for (size_t g = 0; g < members.size (); g++) {
+        self->group_begin.push_back (self->inputs.size ());
+        for (const auto &topic : members [g]) {
+            if (self->index.count (topic))
+                continue;
+            self->index [topic] = self->inputs.size ();
+            self->inputs.push_back (topic);
+            self->slot_group.push_back (g);
+        }
+    }
+    self->group_begin.push_back (self->inputs.size ());
+    for (auto &expression : expressions) {
+        std::vector <size_t> slots;
+        for (const auto &topic : composite_expression_topics (expression.expression))
+            slots.push_back (self->index [topic]);
+        composite_expression_bind (expression.expression, slots);
+    }
+    for (auto &reduction : reductions) {
+        if (reduction.function < REDUCTION_MOVING_AVERAGE)
+            continue;
+        auto it = self->index.find (reduction.input);
+        if (it == self->index.end ()) {
+            log_error ("%s:\tWindowed reduction of '%s', which is not an input, in '%s'", self->name.c_str (), reduction.input.c_str (), filename);
+            s_expressions_destroy (expressions);
+            return -1;
+        }
+        reduction.slot = it->second;
+    }
+    self->groups = groups.empty () ? std::vector <std::string> () : group_names;
+    self->group_dirty.assign (group_names.size (), false);
+    self->dirty.clear ();
+    // all inputs start expired
+    self->values.assign (self->inputs.size (), 0.0);
+    self->valid_till.assign (self->inputs.size (), 0);
+    self->offsets.assign (self->inputs.size (), 0.0);
+    for (auto window : self->windows)
+        sample_window_destroy (&window);
+    self->windows.assign (self->inputs.size (), NULL);
+    // EWMA with the same center of mass as the moving average by default
+    if (window_alpha <= 0 || window_alpha > 1)
+        window_alpha = 2.0 / (config.window_samples + 1);
+    for (const auto &reduction : reductions) {
+        if (reduction.function >= REDUCTION_MOVING_AVERAGE && !self->windows [reduction.slot])
+            self->windows [reduction.slot] = sample_window_new (config.window_samples, window_alpha);
+    }
+    for (const auto &offset : config.offsets) {
+        auto it = self->index.find (offset.first);
+        if (it != self->index.end ())
+            self->offsets [it->second] = offset.second;
+    }
+    for (const auto &group : group_names) {
+        for (const auto &reduction : reductions) {
+            std::string topic = s_group_topic (reduction.topic, group);
+            // the average script might list its output in "out"
+            if (std::find (outputs.begin (), outputs.end (), topic) == outputs.end ())
+                outputs.push_back (topic);
+        }
+    }
+    for (const auto &expression : expressions)
+        outputs.push_back (expression.topic);
+    self->outputs = outputs;
+    self->lua_code = lua_code;
+    self->lua_chunk = config.lua_chunk;
+    if (!lua_code.empty () && self->lua_chunk.empty ())
+        s_lua_compile (lua_code, self->lua_chunk);
+    self->legacy_average = config.legacy_average;
+    self->lua_allocations = 0;
+    self->lua_peak = 0;
+    self->reductions = reductions;
+    s_expressions_destroy (self->expressions);
+    self->expressions = expressions;
+    self->period = config.period > 0 ? config.period : 0;
+    self->lua_instructions = config.lua_instructions > 0 ? config.lua_instructions : 0;
+    self->lua_memory_kb = config.lua_memory_kb > 0 ? config.lua_memory_kb : 0;
+    if (!lua_code.empty () && !self->lua_arena)
+        self->lua_arena = lua_arena_new (LUA_ARENA_CHUNK);
+    return 0;
+}
+
+//  True if the compiled file exists and is not older than the JSON one
+static bool
+s_compiled_fresh (const char *filename, const std::string &compiled)
+{
+    struct stat source, target;
+    if (stat (filename, &source) != 0 || stat (compiled.c_str (), &target) != 0)
+        return false;
+    return target.st_mtim.tv_sec > source.st_mtim.tv_sec
+        || (target.st_mtim.tv_sec == source.st_mtim.tv_sec && target.st_mtim.tv_nsec >= source.st_mtim.tv_nsec);
+}
+
+//  --------------------------------------------------------------------------
+//  Load configuration from JSON or compiled file
+
+int
+composite_evaluator_load (composite_evaluator_t *self, const char *filename)
+{
+    assert (self);
+    assert (filename);
+
+    std::string data;
+    if (s_read_file (filename, data) != 0) {
+        log_error ("%s:\tCannot open config file '%s' correctly", self->name.c_str (), filename);
+        return -1;
+    }
+    self->source = filename;
+    config_t config = s_config_new ();
+    if (s_is_compiled (data)) {
+        if (s_decode (data, config) != 0) {
+            log_error ("%s:\tCompiled config file '%s' is malformed", self->name.c_str (), filename);
+            return -1;
+        }
+        return s_apply (self, config, filename);
+    }
+    // compiled file next to the JSON one saves parsing and compiling Lua
+    std::string compiled = std::string (filename) + COMPOSITE_EVALUATOR_COMPILED_SUFFIX;
+    std::string compiled_data;
+    if (s_compiled_fresh (filename, compiled)
+    &&  s_read_file (compiled.c_str (), compiled_data) == 0
+    &&  s_is_compiled (compiled_data)) {
+        if (s_decode (compiled_data, config) == 0)
+            return s_apply (self, config, filename);
+        log_warning ("%s:\tCompiled config file '%s' is malformed, using '%s'", self->name.c_str (), compiled.c_str (), filename);
+        config = s_config_new ();
+    }
+    if (s_parse_json (self->name.c_str (), filename, data, config) != 0)
+        return -1;
+    return s_apply (self, config, filename);
+}
+
+//  Load evaluators of all composites of the deserialized manifest 'filename'
+//  into 'evaluators'; 0 - success, -1 - error (nothing is added)
+static int
+s_load_manifest (const char *filename, const cxxtools::SerializationInfo *si, std::vector <composite_evaluator_t *> &evaluators)
+{
+    int64_t version = 0;
+    uint64_t generation = 0;
+    si->getMember ("manifest") >>= version;
+    if (version != COMPOSITE_EVALUATOR_MANIFEST_VERSION) {
+        log_error ("Manifest '%s' has unsupported version %" PRIi64, filename, version);
+        return -1;
+    }
+    const cxxtools::SerializationInfo *member = si->findMember ("generation");
+    if (member)
+        *member >>= generation;
+    std::vector <composite_evaluator_t *> loaded;
+    std::set <std::string> names;
+    int rv = 0;
+    for (const auto &it : si->getMember ("composites")) {
+        std::string name = std::string (filename) + ":" + it.name ();
+        if (!names.insert (name).second) {
+            log_error ("%s:\tDefined twice in manifest '%s'", name.c_str (), filename);
+            rv = -1;
+            break;
+        }
+        composite_evaluator_t *evaluator = composite_evaluator_new (name.c_str ());
+        evaluator->source = filename;
+        loaded.push_back (evaluator);
+        config_t config = s_config_new ();
+        if (s_parse_si (name.c_str (), filename, &it, config) != 0
+        ||  s_apply (evaluator, config, filename) != 0) {
+            rv = -1;
+            break;
+        }
+    }
+    if (rv != 0) {
+        for (auto evaluator : loaded)
+            composite_evaluator_destroy (&evaluator);
+        return -1;
+    }
+    log_info ("Manifest '%s' generation %" PRIu64 " has %zu composites", filename, generation, loaded.size ());
+    evaluators.insert (evaluators.end (), loaded.begin (), loaded.end ());
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Load all configurations of a configuration file or a manifest
+
+int
+composite_evaluator_load_source (const char *filename, std::vector <composite_evaluator_t *> &evaluators)
+{
+    assert (filename);
+
+    std::string data;
+    if (s_read_file (filename, data) != 0) {
+        log_error ("Cannot open config file '%s' correctly", filename);
+        return -1;
+    }
+    // compiled configurations are never manifests, load them without JSON; a
+    // compiled file next to JSON which may be a manifest is not its binary form
+    std::string compiled = std::string (filename) + COMPOSITE_EVALUATOR_COMPILED_SUFFIX;
+    if (s_is_compiled (data)
+    ||  (data.find ("\"manifest\"") == std::string::npos && s_compiled_fresh (filename, compiled))) {
+        composite_evaluator_t *evaluator = composite_evaluator_new (filename);
+        if (composite_evaluator_load (evaluator, filename) != 0) {
+            composite_evaluator_destroy (&evaluator);
+            return -1;
+        }
+        evaluators.push_back (evaluator);
+        return 0;
+    }
+    try {
+        std::istringstream stream (data);
+        cxxtools::JsonDeserializer json (stream);
+        json.deserialize ();
+        const cxxtools::SerializationInfo *si = json.si ();
+        if (si->findMember ("manifest"))
+            return s_load_manifest (filename, si, evaluators);
+
+        composite_evaluator_t *evaluator = composite_evaluator_new (filename);
+        evaluator->source = filename;
+        config_t config = s_config_new ();
+        if (s_parse_si (filename, filename, si, config) != 0
+        ||  s_apply (evaluator, config, filename) != 0) {
+            composite_evaluator_destroy (&evaluator);
+            return -1;
+        }
+        evaluators.push_back (evaluator);
+        return 0;
+    }
+    catch (const std::exception &e) {
+        log_error ("Cannot deserialize cfg file! with '%s'", e.what ());
+        return -1;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Compile JSON configuration into its binary form
+
+int
+composite_evaluator_compile (const char *filename, const char *compiled)
+{
+    assert (filename);
+    assert (compiled);
+
+    std::string data;
+    if (s_read_file (filename, data) != 0) {
+        log_error ("Cannot open config file '%s' correctly", filename);
+        return -1;
+    }
+    config_t config = s_config_new ();
+    if (s_is_compiled (data)) {
+        if (s_decode (data, config) != 0) {
+            log_error ("Compiled config file '%s' is malformed", filename);
+            return -1;
+        }
+    }
+    else
+    if (s_parse_json (filename, filename, data, config) != 0)
+        return -1;
+    // refuse what the agent would refuse, keep the bytecode
+    composite_evaluator_t *self = composite_evaluator_new (filename);
+    int rv = s_apply (self, config, filename);
+    config.lua_chunk = self->lua_chunk;
+    composite_evaluator_destroy (&self);
+    if (rv != 0)
+        return -1;
+
+    // agents never see a part of the file
+    data = s_encode (config);
+    std::string temporary = std::string (compiled) + ".tmp";
+    FILE *file = fopen (temporary.c_str (), "w");
+    if (!file) {
+        log_error ("Cannot create '%s': %s", temporary.c_str (), strerror (errno));
+        return -1;
+    }
+    bool written = fwrite (data.data (), 1, data.size (), file) == data.size ()
+                && fflush (file) == 0
+                && fsync (fileno (file)) == 0;
+    written = fclose (file) == 0 && written;
+    if (!written || rename (temporary.c_str (), compiled) != 0) {
+        log_error ("Cannot write '%s': %s", compiled, strerror (errno));
+        unlink (temporary.c_str ());
+        return -1;
+    }
+    // the rename survives a crash only with the directory synced too
+    std::string directory = compiled;
+    size_t slash = directory.rfind ('/');
+    directory = slash == std::string::npos ? "." : directory.substr (0, slash == 0 ? 1 : slash);
+    int fd = open (directory.c_str (), O_RDONLY | O_DIRECTORY);
+    if (fd != -1) {
+        fsync (fd);
+        close (fd);
+    }
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Get name of the file the configuration was loaded from
+
+const char *
+composite_evaluator_source (composite_evaluator_t *self)
+{
+    assert (self);
+    return self->source.c_str ();
+}
+
+//  --------------------------------------------------------------------------
+//  Get name of the evaluator
+
+const char *
+composite_evaluator_name (composite_evaluator_t *self)
+{
+    assert (self);
+    return self->name.c_str ();
+}
+
+//  --------------------------------------------------------------------------
+//  Get period of evaluation
+
+int64_t
+composite_evaluator_period (composite_evaluator_t *self)
+{
+    assert (self);
+    return self->period;
+}
+
+//  --------------------------------------------------------------------------
+//  Get input topics
+
+const std::vector <std::string> &
+composite_evaluator_inputs (composite_evaluator_t *self)
+{
+    assert (self);
+    return self->inputs;
+}
+
+//  --------------------------------------------------------------------------
+//  Get declared output topics
+
+const std::vector <std::string> &
+composite_evaluator_outputs (composite_evaluator_t *self)
+{
+    assert (self);
+    return self->outputs;
+}
+
+//  --------------------------------------------------------------------------
+//  Take values of inputs both evaluators have from 'previous'
+
+size_t
+composite_evaluator_retain (composite_evaluator_t *self, composite_evaluator_t *previous)
+{
+    assert (self);
+    assert (previous);
+    size_t retained = 0;
+    for (size_t slot = 0; slot < self->inputs.size (); slot++) {
+        auto it = previous->index.find (self->inputs [slot]);
+        if (it == previous->index.end () || previous->valid_till [it->second] == 0)
+            continue;   // new or never received
+        self->values [slot] = previous->values [it->second];
+        self->valid_till [slot] = previous->valid_till [it->second];
+        size_t group = self->slot_group [slot];
+        if (!self->groups.empty () && !self->group_dirty [group]) {
+            self->group_dirty [group] = true;
+            self->dirty.push_back (group);
+        }
+        retained++;
+    }
+    return retained;
+}
+
+//  --------------------------------------------------------------------------
+//  Store new value of the input
+
+bool
+composite_evaluator_update (composite_evaluator_t *self, const std::string &topic, double value, time_t timestamp, time_t valid_till)
+{
+    assert (self);
+    auto it = self->index.find (topic);
+    if (it == self->index.end ())
+        return false;
+    self->values [it->second] = value;
+    self->valid_till [it->second] = valid_till;
+    if (self->windows [it->second])
+        sample_window_add (self->windows [it->second], timestamp, value + self->offsets [it->second]);
+    size_t group = self->slot_group [it->second];
+    if (!self->groups.empty () && !self->group_dirty [group]) {
+        self->group_dirty [group] = true;
+        self->dirty.push_back (group);
+    }
+    return true;
+}
+
+//  Builtin reductions of the group from 'stats' of its valid inputs; false if
+//  nothing was produced
+static bool
+s_evaluate_reductions (composite_evaluator_t *self, size_t group, const reduction_stats_t &stats, time_t now, std::vector <composite_output_t> &outputs)
+{
+    bool produced = false;
+    for (const auto &reduction : self->reductions) {
+        sample_window_t *window = NULL;
+        if (reduction.function >= REDUCTION_MOVING_AVERAGE) {
+            // windows of expired inputs are not used
+            window = self->windows [reduction.slot];
+            if (now > self->valid_till [reduction.slot] || sample_window_size (window) == 0)
+                continue;
+        }
+        else
+        if (stats.count == 0)
+            continue;
+        composite_output_t output;
+        output.topic = self->groups.empty () ? reduction.topic : s_group_topic (reduction.topic, self->groups [group]);
+        output.unit = reduction.unit;
+        switch (reduction.function) {
+            case REDUCTION_AVERAGE:
+                output.value = stats.sum / stats.count;
+                break;
+            case REDUCTION_MIN:
+                output.value = stats.min;
+                break;
+            case REDUCTION_MAX:
+                output.value = stats.max;
+                break;
+            case REDUCTION_SUM:
+                output.value = stats.sum;
+                break;
+            case REDUCTION_COUNT:
+                output.value = stats.count;
+                break;
+            case REDUCTION_MOVING_AVERAGE:
+                output.value = sample_window_average (window);
+                break;
+            case REDUCTION_WINDOW_MIN:
+                output.value = sample_window_min (window);
+                break;
+            case REDUCTION_WINDOW_MAX:
+                output.value = sample_window_max (window);
+                break;
+            case REDUCTION_RATE:
+                output.value = sample_window_rate (window);
+                break;
+            case REDUCTION_EWMA:
+                output.value = sample_window_ewma (window);
+                break;
+        }
+        outputs.push_back (output);
+        produced = true;
+    }
+    return produced;
+}
+
+//  Push field 'position' of the table at 'index', or field 'name' if the former is nil
+static void
+s_push_field (lua_State *L, int index, int position, const char *name)
+{
+    lua_rawgeti (L, index, position);
+    if (lua_isnil (L, -1)) {
+        lua_pop (L, 1);
+        lua_getfield (L, index, name);
+    }
+}
+
+//  Read one output from the table at 'index'; false if it is not valid
+static bool
+s_lua_output (lua_State *L, int index, composite_output_t &output)
+{
+    s_push_field (L, index, 1, "topic");
+    s_push_field (L, index, 2, "value");
+    s_push_field (L, index, 3, "unit");
+    bool valid = lua_type (L, -3) == LUA_TSTRING && lua_isnumber (L, -2);
+    if (valid) {
+        output.topic = lua_tostring (L, -3);
+        output.value = lua_tonumber (L, -2);
+        output.unit = lua_isstring (L, -1) ? lua_tostring (L, -1) : "";
+    }
+    lua_pop (L, 3);
+    return valid;
+}
+
+//  Allocator of Lua states, keeps memory in use within the budget
+static void *
+s_lua_alloc (void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    lua_budget_t *budget = (lua_budget_t *) ud;
+    // without a block 'osize' is not a size since Lua 5.2
+    size_t old = ptr ? osize : 0;
+    if (nsize == 0) {
+        lua_arena_realloc (budget->arena, ptr, osize, 0);
+        budget->memory -= old;
+        return NULL;
+    }
+    if (budget->memory_limit && nsize > old && budget->memory + (nsize - old) > budget->memory_limit) {
+        budget->memory_exceeded = true;
+        return NULL;
+    }
+    void *block = lua_arena_realloc (budget->arena, ptr, osize, nsize);
+    if (block)
+        budget->memory = budget->memory - old + nsize;
+    return block;
+}
+
+//  Key of the budget in the registry of the state
+#define LUA_BUDGET "fty-metric-composite-budget"
+
+//  Count hook, called when the instruction budget is spent
+static void
+s_lua_hook (lua_State *L, lua_Debug *ar)
+{
+    (void) ar;
+    lua_getfield (L, LUA_REGISTRYINDEX, LUA_BUDGET);
+    lua_budget_t *budget = (lua_budget_t *) lua_touserdata (L, -1);
+    lua_pop (L, 1);
+    if (budget)
+        budget->instructions_exceeded = true;
+    luaL_error (L, "instruction limit exceeded");
+}
+
+//  Errors outside of lua_pcall, like running out of memory in luaL_openlibs
+static int
+s_lua_panic (lua_State *L)
+{
+    const char *message = lua_tostring (L, -1);
+    log_fatal ("Unprotected error in Lua: %s", message ? message : "unknown error");
+    return 0;   // Lua aborts
+}
+
+//  Valid inputs passed to s_lua_set_inputs
+typedef struct {
+    composite_evaluator_t *self;
+    time_t now;
+} lua_inputs_t;
+
+//  Set global table 'mt' of valid inputs; run by lua_pcall, as it allocates
+//  within the budget of the script
+static int
+s_lua_set_inputs (lua_State *L)
+{
+    lua_inputs_t *inputs = (lua_inputs_t *) lua_touserdata (L, 1);
+    composite_evaluator_t *self = inputs->self;
+    lua_newtable (L);
+    for (size_t i = 0; i < self->inputs.size (); i++) {
+        if (inputs->now > self->valid_till [i]) {
+            // can't count average, missing measurements from sensor
+            continue;
+        }
+        log_trace ("%s - %s, %f", self->name.c_str (), self->inputs [i].c_str (), self->values [i]);
+        lua_pushstring (L, self->inputs [i].c_str ());
+        lua_pushnumber (L, self->values [i]);
+        lua_settable (L, -3);
+    }
+    lua_setglobal (L, "mt");
+    return 0;
+}
+
+//  Close the state, keep statistics of its memory and release it at once
+static void
+s_lua_close (composite_evaluator_t *self, lua_State *L)
+{
+    lua_close (L);
+    self->lua_allocations = lua_arena_allocations (self->lua_arena);
+    self->lua_peak = lua_arena_peak (self->lua_arena);
+    FTY_METRIC_COMPOSITE_TRACE3 (lua_memory, self->name.c_str (), self->lua_allocations, self->lua_peak);
+    lua_arena_reset (self->lua_arena);
+}
+
+//  Run Lua code; -1 on error, -2 when the budget was exceeded, otherwise number
+//  of outputs appended
+static int
+s_evaluate_lua (composite_evaluator_t *self, time_t now, std::vector <composite_output_t> &outputs)
+{
+    const char *name = self->name.c_str ();
+    lua_budget_t budget = {self->lua_arena, 0, 0, false, false};
+    lua_State *L = lua_newstate (s_lua_alloc, &budget);
+#if defined (HAVE_LUAJIT)
+    if (!L) {
+        if (self->lua_memory_kb > 0)
+            log_warning ("%s: LuaJIT without custom allocators, memory of Lua is not limited", name);
+        L = luaL_newstate ();
+    }
+#endif
+    if (!L) {
+        self->error = "cannot create Lua state";
+        lua_arena_reset (self->lua_arena);
+        return -1;
+    }
+    lua_atpanic (L, s_lua_panic);
+    lua_pushlightuserdata (L, &budget);
+    lua_setfield (L, LUA_REGISTRYINDEX, LUA_BUDGET);
+    luaL_openlibs (L);
+    lua_inputs_t inputs = {self, now};
+    lua_pushcfunction (L, s_lua_set_inputs);
+    lua_pushlightuserdata (L, &inputs);
+    // standard libraries are not counted into the budget of the script, its
+    // inputs are; an allocation refused outside of lua_pcall would abort
+    if (self->lua_memory_kb > 0)
+        budget.memory_limit = budget.memory + (size_t) self->lua_memory_kb * 1024;
+    if (self->lua_instructions > 0)
+        lua_sethook (L, s_lua_hook, LUA_MASKCOUNT, (int) std::min (self->lua_instructions, (int64_t) INT_MAX));
+    int error = lua_pcall (L, 1, 0, 0);
+
+    if (!error) {
+        // bytecode skips the parser, the code is loaded only when it did not compile
+        const std::string &chunk = self->lua_chunk.empty () ? self->lua_code : self->lua_chunk;
+        FTY_METRIC_COMPOSITE_TRACE2 (lua_load, name, chunk.length ());
+        error = luaL_loadbuffer (L, chunk.data (), chunk.length (), "line");
+        FTY_METRIC_COMPOSITE_TRACE2 (lua_load_done, name, error);
+    }
+    if (!error) {
+        FTY_METRIC_COMPOSITE_TRACE1 (lua_call, name);
+        error = lua_pcall (L, 0, LUA_MULTRET, 0);
+        FTY_METRIC_COMPOSITE_TRACE3 (lua_call_done, name, error, lua_gettop (L));
+    }
+    // results are converted unprotected, so without the limit
+    budget.memory_limit = 0;
+    if (error) {
+        const char *message = lua_tostring (L, -1);
+        self->error = message ? message : "unknown error";
+        if (budget.instructions_exceeded)
+            self->error = "instruction limit of " + std::to_string (self->lua_instructions) + " exceeded";
+        else
+        if (error == LUA_ERRMEM && budget.memory_exceeded)
+            self->error = "memory limit of " + std::to_string (self->lua_memory_kb) + " kB exceeded";
+        FTY_METRIC_COMPOSITE_TRACE2 (lua_error, name, self->error.c_str ());
+        s_lua_close (self, L);
+        return budget.instructions_exceeded || (error == LUA_ERRMEM && budget.memory_exceeded) ? -2 : -1;
+    }
+
+    int count = 0;
+    int results = lua_gettop (L);
+    log_trace ("%s: Total: %d", name, results);
+    if (results >= 1 && lua_istable (L, 1)) {
+        // table of outputs
+        for (int i = 1; ; i++) {
+            lua_rawgeti (L, 1, i);
+            if (lua_isnil (L, -1)) {
+                lua_pop (L, 1);
+                break;
+            }
+            composite_output_t output;
+            if (lua_istable (L, -1) && s_lua_output (L, lua_gettop (L), output)) {
+                outputs.push_back (output);
+                count++;
+            }
+            else
+                log_warning ("%s: Output %d returned by evaluation is not {topic, value, unit}", name, i);
+            lua_pop (L, 1);
+        }
+    }
+    else
+    if (results >= 3 && lua_type (L, 1) == LUA_TSTRING && lua_isnumber (L, 2)) {
+        // single topic, value, unit
+        composite_output_t output;
+        output.topic = lua_tostring (L, 1);
+        output.value = lua_tonumber (L, 2);
+        output.unit = lua_isstring (L, 3) ? lua_tostring (L, 3) : "";
+        outputs.push_back (output);
+        count++;
+    }
+    s_lua_close (self, L);
+    return count;
+}
+
+//  --------------------------------------------------------------------------
+//  Evaluate the composite with inputs valid at 'now', append results to 'outputs'
+
+composite_evaluator_result_t
+composite_evaluator_evaluate (composite_evaluator_t *self, time_t now, std::vector <composite_output_t> &outputs)
+{
+    assert (self);
+    size_t produced = outputs.size ();
+    if (!self->groups.empty ()) {
+        if (self->period > 0) {
+            // periodic evaluation gives steady output of all groups
+            self->dirty.clear ();
+            for (size_t group = 0; group < self->groups.size (); group++)
+                self->dirty.push_back (group);
+        }
+        // only groups with updated inputs, reduced in one pass
+        self->group_stats.resize (self->dirty.size ());
+        reduction_kernel_reduce_groups (self->values.data (), self->offsets.data (), self->valid_till.data (),
+                                        self->group_begin.data (), self->dirty.data (), self->dirty.size (), now,
+                                        self->group_stats.data ());
+        for (size_t i = 0; i < self->dirty.size (); i++) {
+            self->group_dirty [self->dirty [i]] = false;
+            s_evaluate_reductions (self, self->dirty [i], self->group_stats [i], now, outputs);
+        }
+        self->dirty.clear ();
+    }
+    else
+    if (!self->reductions.empty ()) {
+        reduction_stats_t stats;
+        reduction_kernel_reduce (self->values.data (), self->offsets.data (), self->valid_till.data (),
+                                 0, self->inputs.size (), now, &stats);
+        if (!s_evaluate_reductions (self, 0, stats, now, outputs) && self->legacy_average) {
+            // as the script did
+            self->error = "all sensors lost";
+            return COMPOSITE_EVALUATOR_ERROR;
+        }
+    }
+    for (const auto &expression : self->expressions) {
+        composite_output_t output;
+        if (composite_expression_evaluate (expression.expression, self->values.data (), self->valid_till.data (), now, &output.value)) {
+            output.topic = expression.topic;
+            output.unit = expression.unit;
+            outputs.push_back (output);
+        }
+    }
+    if (!self->lua_code.empty ()) {
+        int rv = s_evaluate_lua (self, now, outputs);
+        if (rv == -2)
+            return COMPOSITE_EVALUATOR_LIMIT;
+        if (rv < 0)
+            return COMPOSITE_EVALUATOR_ERROR;
+    }
+    return outputs.size () > produced ? COMPOSITE_EVALUATOR_OK : COMPOSITE_EVALUATOR_NO_DATA;
+}
+
+//  --------------------------------------------------------------------------
+//  Get message of the last COMPOSITE_EVALUATOR_ERROR
+
+const char *
+composite_evaluator_error (composite_evaluator_t *self)
+{
+    assert (self);
+    return self->error.c_str ();
+}
+
+//  --------------------------------------------------------------------------
+//  Get name and version of the Lua implementation
+
+const char *
+composite_evaluator_lua_version (void)
+{
+#if defined (HAVE_LUAJIT)
+    return LUAJIT_VERSION;
+#else
+    return LUA_RELEASE;
+#endif
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of allocations of the last run of the Lua code
+
+size_t
+composite_evaluator_lua_allocations (composite_evaluator_t *self)
+{
+    assert (self);
+    return self->lua_allocations;
+}
+
+//  --------------------------------------------------------------------------
+//  Get peak of memory in bytes of the last run of the Lua code
+
+size_t
+composite_evaluator_lua_peak (composite_evaluator_t *self)
+{
+    assert (self);
+    return self->lua_peak;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+static void
+s_write_config (const char *path, const char *contents)
+{
+    FILE *file = fopen (path, "w");
+    assert (file);
+    fputs (contents, file);
+    fclose (file);
+}
+
+void
+composite_evaluator_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("composite-evaluator-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    time_t now = time (NULL);
+    std::vector <composite_output_t> outputs;
+
+    // legacy configuration, single output
+    {
+        composite_evaluator_t *self = composite_evaluator_new ("test-legacy");
+        assert (self);
+        char *path = zsys_sprintf ("%s/fty-metric-composite.cfg.example", SELFTEST_DIR_RO);
+        int rv = composite_evaluator_load (self, path);
+        zstr_free (&path);
+        assert (rv == 0);
+        assert (composite_evaluator_inputs (self).size () == 2);
+        // the average script is recognized and declares its output
+        assert (composite_evaluator_outputs (self).size () == 1);
+        assert (!composite_evaluator_update (self, "temperature@TH3", 10, now, now + 60));
+
+        // nothing valid -> script raises error
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_ERROR);
+        assert (strstr (composite_evaluator_error (self), "all sensors lost"));
+        assert (outputs.empty ());
+
+        assert (composite_evaluator_update (self, "temperature@TH1", 40, now, now + 60));
+        assert (composite_evaluator_update (self, "temperature@TH2", 100, now, now - 1)); // expired
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 1);
+        assert (outputs [0].topic == "average.temperature@world");
+        assert (outputs [0].value == 40);
+        assert (outputs [0].unit == "C");
+        assert (composite_evaluator_lua_allocations (self) == 0);
+        outputs.clear ();
+        composite_evaluator_destroy (&self);
+        assert (self == NULL);
+    }
+
+    // configurator scripts with offsets, a script with an input without offset is left to Lua
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-legacy.cfg", SELFTEST_DIR_RW);
+        const char *script =
+            "{\n"
+            "\"in\" : [ \"humidity.1@rack\", \"humidity.2@rack\" ],\n"
+            "\"evaluation\": \"\n"
+            "    offsets = {};\n"
+            "    offsets['humidity.1@rack'] = -2.5;\n"
+            "%s"
+            "\n"
+            "    sum = 0;\n"
+            "    num = 0;\n"
+            "    for key,value in pairs(mt) do\n"
+            "        sum = sum + value + offsets[key];\n"
+            "        num = num + 1;\n"
+            "    end;\n"
+            "    if num == 0 then error('all sensors lost'); end;\n"
+            "    tmp = sum / num;\n"
+            "    return 'average.humidity@rack', tmp, '%%', 0;\"\n"
+            "}\n";
+        char *contents = zsys_sprintf (script, "    offsets['humidity.2@rack'] = 1e1;\n");
+        s_write_config (path, contents);
+        zstr_free (&contents);
+        composite_evaluator_t *self = composite_evaluator_new ("test-legacy-offsets");
+        assert (composite_evaluator_load (self, path) == 0);
+        assert (composite_evaluator_outputs (self).size () == 1);
+        composite_evaluator_update (self, "humidity.1@rack", 42.5, now, now + 60);
+        composite_evaluator_update (self, "humidity.2@rack", 50, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 1);
+        assert (outputs [0].topic == "average.humidity@rack" && outputs [0].value == 50 && outputs [0].unit == "%");
+        outputs.clear ();
+
+        contents = zsys_sprintf (script, "");
+        s_write_config (path, contents);
+        zstr_free (&contents);
+        assert (composite_evaluator_load (self, path) == 0);
+        assert (composite_evaluator_outputs (self).empty ());
+        composite_evaluator_update (self, "humidity.1@rack", 42.5, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 1 && outputs [0].value == 40);
+        outputs.clear ();
+        composite_evaluator_update (self, "humidity.2@rack", 50, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_ERROR);
+        outputs.clear ();
+        zstr_free (&path);
+        composite_evaluator_destroy (&self);
+    }
+
+    // Lua returns table of outputs
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-lua.cfg", SELFTEST_DIR_RW);
+        s_write_config (path,
+            "{\n"
+            "\"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+            "\"out\" : [ \"average.temperature@rack\", \"min.temperature@rack\", \"max.temperature@rack\" ],\n"
+            "\"evaluation\": \"\n"
+            "    sum = 0; num = 0; mn = nil; mx = nil;\n"
+            "    for key,value in pairs(mt) do\n"
+            "        sum = sum + value; num = num + 1;\n"
+            "        if mn == nil or value < mn then mn = value; end;\n"
+            "        if mx == nil or value > mx then mx = value; end;\n"
+            "    end;\n"
+            "    if num == 0 then return {}; end;\n"
+            "    return { {'average.temperature@rack', sum / num, 'C'},\n"
+            "             {topic = 'min.temperature@rack', value = mn, unit = 'C'},\n"
+            "             {'max.temperature@rack', mx, 'C'} };\"\n"
+            "}\n");
+        composite_evaluator_t *self = composite_evaluator_new ("test-lua");
+        assert (composite_evaluator_load (self, path) == 0);
+        zstr_free (&path);
+        assert (composite_evaluator_outputs (self).size () == 3);
+
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_NO_DATA);
+        assert (outputs.empty ());
+        composite_evaluator_update (self, "temperature@TH1", 20, now, now + 60);
+        composite_evaluator_update (self, "temperature@TH2", 30, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 3);
+        assert (outputs [0].topic == "average.temperature@rack" && outputs [0].value == 25);
+        assert (outputs [1].topic == "min.temperature@rack" && outputs [1].value == 20);
+        assert (outputs [2].topic == "max.temperature@rack" && outputs [2].value == 30);
+        assert (outputs [2].unit == "C");
+#if !defined (HAVE_LUAJIT)
+        // LuaJIT may not allow custom allocators
+        assert (composite_evaluator_lua_allocations (self) > 0);
+        assert (composite_evaluator_lua_peak (self) > 0);
+#endif
+        outputs.clear ();
+        composite_evaluator_destroy (&self);
+    }
+
+    // formulas evaluated without Lua
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-expression.cfg", SELFTEST_DIR_RW);
+        s_write_config (path,
+            "{\n"
+            "\"in\" : [ \"realpower@ups-1\" ],\n"
+            "\"expression\" : [\n"
+            "    { \"formula\" : \"mt['realpower@ups-1'] + default (mt['realpower@ups-2'], 0)\", \"topic\" : \"realpower@row\", \"unit\" : \"W\" },\n"
+            "    { \"formula\" : \"mt['realpower@ups-1'] / mt['realpower@ups-2']\", \"topic\" : \"ratio@row\" }\n"
+            "]\n"
+            "}\n");
+        composite_evaluator_t *self = composite_evaluator_new ("test-expression");
+        assert (composite_evaluator_load (self, path) == 0);
+        // inputs of the formulas are added to "in"
+        assert (composite_evaluator_inputs (self).size () == 2);
+        assert (composite_evaluator_outputs (self).size () == 2);
+        assert (composite_evaluator_outputs (self) [1] == "ratio@row");
+
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_NO_DATA);
+        composite_evaluator_update (self, "realpower@ups-1", 300, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 1);
+        assert (outputs [0].topic == "realpower@row" && outputs [0].value == 300 && outputs [0].unit == "W");
+        outputs.clear ();
+        composite_evaluator_update (self, "realpower@ups-2", 200, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 2);
+        assert (outputs [0].value == 500);
+        assert (outputs [1].value == 1.5 && outputs [1].unit == "");
+        assert (composite_evaluator_lua_allocations (self) == 0);
+        outputs.clear ();
+
+        // single expression, syntax error
+        s_write_config (path, "{ \"expression\" : { \"formula\" : \"mt['a@b'] * 2\", \"topic\" : \"x@y\" } }\n");
+        assert (composite_evaluator_load (self, path) == 0);
+        assert (composite_evaluator_inputs (self).size () == 1);
+        s_write_config (path, "{ \"expression\" : { \"formula\" : \"mt['a@b'] *\", \"topic\" : \"x@y\" } }\n");
+        assert (composite_evaluator_load (self, path) == -1);
+        zstr_free (&path);
+        composite_evaluator_destroy (&self);
+    }
+
+    // runaway scripts are stopped by their budget
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-limits.cfg", SELFTEST_DIR_RW);
+        s_write_config (path,
+            "{\n"
+            "\"in\" : [ \"temperature@TH1\" ],\n"
+            "\"limits\" : { \"instructions\" : 100000, \"memory_kb\" : 256 },\n"
+            "\"evaluation\": \"\n"
+            "    if mt['temperature@TH1'] == 1 then while true do end; end;\n"
+            "    if mt['temperature@TH1'] == 2 then t = {}; for i = 1, 100000000 do t [i] = i; end; end;\n"
+            "    if mt['temperature@TH1'] == 3 then s = 'x'; while true do s = s .. s; end; end;\n"
+            "    return 'max.temperature@rack', mt['temperature@TH1'], 'C';\"\n"
+            "}\n");
+        composite_evaluator_t *self = composite_evaluator_new ("test-limits");
+        assert (composite_evaluator_load (self, path) == 0);
+        zstr_free (&path);
+
+        composite_evaluator_update (self, "temperature@TH1", 1, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_LIMIT);
+        assert (strstr (composite_evaluator_error (self), "instruction limit"));
+        // memory is limited unless LuaJIT refused the allocator
+        if (composite_evaluator_lua_allocations (self) > 0) {
+            composite_evaluator_update (self, "temperature@TH1", 2, now, now + 60);
+            assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_LIMIT);
+            composite_evaluator_update (self, "temperature@TH1", 3, now, now + 60);
+            assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_LIMIT);
+            assert (strstr (composite_evaluator_error (self), "memory limit of 256 kB"));
+        }
+        assert (outputs.empty ());
+        // next evaluation is not affected
+        composite_evaluator_update (self, "temperature@TH1", 20, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 1 && outputs [0].value == 20);
+        outputs.clear ();
+        composite_evaluator_destroy (&self);
+
+        // inputs which do not fit into the memory limit stop the run, not the agent
+        path = zsys_sprintf ("%s/composite-evaluator-limits.cfg", SELFTEST_DIR_RW);
+        std::string config = "{ \"in\" : [ ";
+        for (int i = 0; i < 200; i++)
+            config += std::string (i ? ", " : "") + "\"temperature@sensor-" + std::to_string (i) + "\"";
+        config += " ], \"limits\" : { \"memory_kb\" : 1 }, \"evaluation\" : \"return 'x@y', 1, 'C'\" }\n";
+        s_write_config (path, config.c_str ());
+        self = composite_evaluator_new ("test-limits-inputs");
+        assert (composite_evaluator_load (self, path) == 0);
+        zstr_free (&path);
+        for (int i = 0; i < 200; i++)
+            composite_evaluator_update (self, "temperature@sensor-" + std::to_string (i), i, now, now + 60);
+        composite_evaluator_result_t result = composite_evaluator_evaluate (self, now, outputs);
+        // memory is limited unless LuaJIT refused the allocator
+        if (composite_evaluator_lua_allocations (self) > 0) {
+            assert (result == COMPOSITE_EVALUATOR_LIMIT);
+            assert (strstr (composite_evaluator_error (self), "memory limit of 1 kB"));
+            assert (outputs.empty ());
+        }
+        outputs.clear ();
+        composite_evaluator_destroy (&self);
+    }
+
+    // builtin reductions
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-reductions.cfg", SELFTEST_DIR_RW);
+        s_write_config (path,
+            "{\n"
+            "\"in\" : [ \"humidity@TH1\", \"humidity@TH2\", \"humidity@TH3\" ],\n"
+            "\"offsets\" : { \"humidity@TH1\" : 10 },\n"
+            "\"reductions\" : [\n"
+            "    { \"function\" : \"average\", \"topic\" : \"average.humidity@rack\", \"unit\" : \"%\" },\n"
+            "    { \"function\" : \"min\", \"topic\" : \"min.humidity@rack\", \"unit\" : \"%\" },\n"
+            "    { \"function\" : \"max\", \"topic\" : \"max.humidity@rack\", \"unit\" : \"%\" },\n"
+            "    { \"function\" : \"count\", \"topic\" : \"count.humidity@rack\" }\n"
+            "]\n"
+            "}\n");
+        composite_evaluator_t *self = composite_evaluator_new ("test-reductions");
+        assert (composite_evaluator_load (self, path) == 0);
+        assert (composite_evaluator_outputs (self).size () == 4);
+        assert (composite_evaluator_outputs (self)[3] == "count.humidity@rack");
+
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_NO_DATA);
+        composite_evaluator_update (self, "humidity@TH1", 40, now, now + 60);     // + offset 10
+        composite_evaluator_update (self, "humidity@TH2", 30, now, now + 60);
+        composite_evaluator_update (self, "humidity@TH3", 99, now, now - 60);     // expired
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 4);
+        assert (outputs [0].value == 40);
+        assert (outputs [1].value == 30);
+        assert (outputs [2].value == 50);
+        assert (outputs [3].value == 2);
+        assert (outputs [3].unit == "");
+        outputs.clear ();
+
+        // unknown reduction
+        s_write_config (path,
+            "{ \"in\" : [ \"humidity@TH1\" ], \"reductions\" : [ { \"function\" : \"median\", \"topic\" : \"x@y\" } ] }\n");
+        assert (composite_evaluator_load (self, path) == -1);
+        // nothing to evaluate
+        s_write_config (path, "{ \"in\" : [ \"humidity@TH1\" ] }\n");
+        assert (composite_evaluator_load (self, path) == -1);
+        // previous configuration is kept
+        assert (composite_evaluator_inputs (self).size () == 3);
+        assert (composite_evaluator_load (self, "/nonexistent/file.cfg") == -1);
+        zstr_free (&path);
+        composite_evaluator_destroy (&self);
+    }
+
+    // groups, one output per group and reduction
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-groups.cfg", SELFTEST_DIR_RW);
+        s_write_config (path,
+            "{\n"
+            "\"groups\" : {\n"
+            "    \"temperature@TH1-Rack01\" : \"Rack01\",\n"
+            "    \"temperature@TH1-Rack02\" : \"Rack02\",\n"
+            "    \"temperature@TH2-Rack01\" : \"Rack01\",\n"
+            "    \"temperature@TH2-Rack02\" : \"Rack02\"\n"
+            "},\n"
+            "\"offsets\" : { \"temperature@TH2-Rack02\" : -5 },\n"
+            "\"reductions\" : [\n"
+            "    { \"function\" : \"average\", \"topic\" : \"average.temperature@{group}\", \"unit\" : \"C\" },\n"
+            "    { \"function\" : \"max\", \"topic\" : \"max.temperature@{group}\", \"unit\" : \"C\" }\n"
+            "]\n"
+            "}\n");
+        composite_evaluator_t *self = composite_evaluator_new ("test-groups");
+        assert (composite_evaluator_load (self, path) == 0);
+        assert (composite_evaluator_period (self) == 0);
+        // inputs ordered by group
+        const std::vector <std::string> &inputs = composite_evaluator_inputs (self);
+        assert (inputs.size () == 4);
+        assert (inputs [0] == "temperature@TH1-Rack01");
+        assert (inputs [1] == "temperature@TH2-Rack01");
+        assert (inputs [2] == "temperature@TH1-Rack02");
+        const std::vector <std::string> &declared = composite_evaluator_outputs (self);
+        assert (declared.size () == 4);
+        assert (declared [0] == "average.temperature@Rack01");
+        assert (declared [3] == "max.temperature@Rack02");
+
+        // nothing updated, nothing evaluated
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_NO_DATA);
+        composite_evaluator_update (self, "temperature@TH1-Rack01", 20, now, now + 60);
+        composite_evaluator_update (self, "temperature@TH2-Rack01", 30, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 2);
+        assert (outputs [0].topic == "average.temperature@Rack01" && outputs [0].value == 25);
+        assert (outputs [1].topic == "max.temperature@Rack01" && outputs [1].value == 30);
+        outputs.clear ();
+
+        composite_evaluator_update (self, "temperature@TH1-Rack02", 20, now, now + 60);
+        composite_evaluator_update (self, "temperature@TH2-Rack02", 30, now, now + 60);   // - offset 5
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 2);
+        assert (outputs [0].topic == "average.temperature@Rack02" && outputs [0].value == 22.5);
+        assert (outputs [1].topic == "max.temperature@Rack02" && outputs [1].value == 25);
+        outputs.clear ();
+
+        // periodic evaluation produces all groups
+        s_write_config (path,
+            "{ \"groups\" : { \"temperature@TH1-Rack01\" : \"Rack01\", \"temperature@TH1-Rack02\" : \"Rack02\" },\n"
+            "  \"evaluate_every_ms\" : 5000,\n"
+            "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@{group}\" } ] }\n");
+        composite_evaluator_t *periodic = composite_evaluator_new ("test-groups-periodic");
+        assert (composite_evaluator_load (periodic, path) == 0);
+        assert (composite_evaluator_period (periodic) == 5000);
+        composite_evaluator_update (periodic, "temperature@TH1-Rack01", 20, now, now + 60);
+        composite_evaluator_update (periodic, "temperature@TH1-Rack02", 30, now, now + 60);
+        assert (composite_evaluator_evaluate (periodic, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 2);
+        outputs.clear ();
+        assert (composite_evaluator_evaluate (periodic, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 2);
+        outputs.clear ();
+        composite_evaluator_destroy (&periodic);
+
+        // expired group produces nothing
+        composite_evaluator_update (self, "temperature@TH1-Rack01", 20, now, now - 60);
+        composite_evaluator_update (self, "temperature@TH2-Rack01", 30, now, now - 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_NO_DATA);
+        assert (outputs.empty ());
+
+        // topic of reduction must contain {group}
+        s_write_config (path,
+            "{ \"groups\" : { \"x@TH1\" : \"Rack01\" }, \"reductions\" : [ { \"function\" : \"sum\", \"topic\" : \"sum.x@rack\" } ] }\n");
+        assert (composite_evaluator_load (self, path) == -1);
+        // every input must be in a group
+        s_write_config (path,
+            "{ \"in\" : [ \"x@TH2\" ], \"groups\" : { \"x@TH1\" : \"Rack01\" },\n"
+            "  \"reductions\" : [ { \"function\" : \"sum\", \"topic\" : \"sum.x@{group}\" } ] }\n");
+        assert (composite_evaluator_load (self, path) == -1);
+        assert (composite_evaluator_inputs (self).size () == 4);
+        zstr_free (&path);
+        composite_evaluator_destroy (&self);
+    }
+
+    // windowed reductions
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-window.cfg", SELFTEST_DIR_RW);
+        s_write_config (path,
+            "{\n"
+            "\"in\" : [ \"realpower@ups\", \"temperature@TH1\" ],\n"
+            "\"window\" : { \"samples\" : 3, \"alpha\" : 0.5 },\n"
+            "\"reductions\" : [\n"
+            "    { \"function\" : \"moving_average\", \"input\" : \"realpower@ups\", \"topic\" : \"average.realpower@ups\", \"unit\" : \"W\" },\n"
+            "    { \"function\" : \"window_max\", \"input\" : \"realpower@ups\", \"topic\" : \"max.realpower@ups\", \"unit\" : \"W\" },\n"
+            "    { \"function\" : \"rate\", \"input\" : \"realpower@ups\", \"topic\" : \"rate.realpower@ups\" },\n"
+            "    { \"function\" : \"ewma\", \"input\" : \"temperature@TH1\", \"topic\" : \"ewma.temperature@TH1\", \"unit\" : \"C\" }\n"
+            "]\n"
+            "}\n");
+        composite_evaluator_t *self = composite_evaluator_new ("test-window");
+        assert (composite_evaluator_load (self, path) == 0);
+
+        composite_evaluator_update (self, "realpower@ups", 100, now - 20, now + 60);
+        composite_evaluator_update (self, "realpower@ups", 300, now - 10, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 3);     // no sample of temperature
+        assert (outputs [0].topic == "average.realpower@ups" && outputs [0].value == 200);
+        assert (outputs [1].value == 300);
+        assert (outputs [2].topic == "rate.realpower@ups" && outputs [2].value == 20);
+        outputs.clear ();
+
+        composite_evaluator_update (self, "realpower@ups", 200, now, now + 60);
+        composite_evaluator_update (self, "realpower@ups", 100, now, now + 60);   // 100 W at now - 20 drops out
+        composite_evaluator_update (self, "temperature@TH1", 20, now, now + 60);
+        composite_evaluator_update (self, "temperature@TH1", 30, now, now + 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 4);
+        assert (outputs [0].value == 200);
+        assert (outputs [1].value == 300);
+        assert (outputs [2].value == -20);
+        assert (outputs [3].value == 25);
+        outputs.clear ();
+
+        // expired input gives no windowed output
+        composite_evaluator_update (self, "realpower@ups", 100, now - 120, now - 60);
+        assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 1);
+        outputs.clear ();
+
+        // input of windowed reduction is required and must be one of inputs
+        s_write_config (path,
+            "{ \"in\" : [ \"x@TH1\" ], \"reductions\" : [ { \"function\" : \"rate\", \"input\" : \"x@TH2\", \"topic\" : \"rate.x@TH2\" } ] }\n");
+        assert (composite_evaluator_load (self, path) == -1);
+        s_write_config (path,
+            "{ \"in\" : [ \"x@TH1\" ], \"reductions\" : [ { \"function\" : \"rate\", \"topic\" : \"rate.x@TH1\" } ] }\n");
+        assert (composite_evaluator_load (self, path) == -1);
+        zstr_free (&path);
+        composite_evaluator_destroy (&self);
+    }
+
+    // compiled configuration gives the same results as JSON
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-compiled.cfg", SELFTEST_DIR_RW);
+        std::string compiled = std::string (path) + COMPOSITE_EVALUATOR_COMPILED_SUFFIX;
+        unlink (compiled.c_str ());
+        s_write_config (path,
+            "{ \"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+            "  \"offsets\" : { \"temperature@TH2\" : -10 },\n"
+            "  \"evaluation\" : \"return 'sum.temperature@rack', mt['temperature@TH1'] + mt['temperature@TH2'], 'C'\",\n"
+            "  \"expression\" : { \"formula\" : \"mt['temperature@TH1'] * 2\", \"topic\" : \"double.temperature@TH1\" },\n"
+            "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@rack\", \"unit\" : \"C\" } ],\n"
+            "  \"out\" : [ \"sum.temperature@rack\" ], \"evaluate_every_ms\" : 1000 }\n");
+        std::vector <composite_output_t> expected;
+        for (int run = 0; run < 3; run++) {
+            composite_evaluator_t *self = composite_evaluator_new ("test-compiled");
+            if (run == 0)
+                assert (composite_evaluator_load (self, path) == 0);
+            else
+            if (run == 1)
+                assert (composite_evaluator_load (self, compiled.c_str ()) == 0);
+            else
+                assert (composite_evaluator_load (self, path) == 0);     // uses the compiled file next to it
+            assert (composite_evaluator_inputs (self).size () == 2);
+            assert (composite_evaluator_outputs (self).size () == 3);
+            assert (composite_evaluator_period (self) == 1000);
+            composite_evaluator_update (self, "temperature@TH1", 20, now, now + 60);
+            composite_evaluator_update (self, "temperature@TH2", 35, now, now + 60);
+            assert (composite_evaluator_evaluate (self, now, outputs) == COMPOSITE_EVALUATOR_OK);
+            assert (outputs.size () == 3);
+            if (run == 0) {
+                expected = outputs;
+                assert (composite_evaluator_compile (path, compiled.c_str ()) == 0);
+            }
+            for (size_t i = 0; i < outputs.size (); i++) {
+                assert (outputs [i].topic == expected [i].topic);
+                assert (outputs [i].value == expected [i].value);
+                assert (outputs [i].unit == expected [i].unit);
+            }
+            outputs.clear ();
+            composite_evaluator_destroy (&self);
+        }
+
+        // a newer JSON file wins over the compiled one
+        composite_evaluator_t *self = composite_evaluator_new ("test-compiled");
+        zclock_sleep (10);
+        s_write_config (path,
+            "{ \"in\" : [ \"temperature@TH1\" ], \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@rack\" } ] }\n");
+        assert (composite_evaluator_load (self, path) == 0);
+        assert (composite_evaluator_inputs (self).size () == 1);
+        // malformed compiled file is refused, invalid configuration is not compiled
+        std::string data;
+        assert (s_read_file (compiled.c_str (), data) == 0);
+        FILE *file = fopen (compiled.c_str (), "w");
+        assert (file);
+        fwrite (data.data (), 1, data.size () - 1, file);
+        fclose (file);
+        assert (composite_evaluator_load (self, compiled.c_str ()) == -1);
+        s_write_config (path, "{ \"in\" : [ \"temperature@TH1\" ] }\n");
+        assert (composite_evaluator_compile (path, compiled.c_str ()) == -1);
+        composite_evaluator_destroy (&self);
+        unlink (compiled.c_str ());
+        unlink (path);
+        zstr_free (&path);
+    }
+
+    // manifest of several composites is loaded as a whole or not at all
+    {
+        char *path = zsys_sprintf ("%s/composite-evaluator-manifest.cfg", SELFTEST_DIR_RW);
+        std::vector <composite_evaluator_t *> evaluators;
+        s_write_config (path, "{ \"in\" : [ \"x@TH1\" ], \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.x@TH1\" } ] }\n");
+        assert (composite_evaluator_load_source (path, evaluators) == 0);
+        assert (evaluators.size () == 1);
+        assert (streq (composite_evaluator_name (evaluators [0]), path));
+        assert (streq (composite_evaluator_source (evaluators [0]), path));
+        composite_evaluator_destroy (&evaluators [0]);
+        evaluators.clear ();
+
+        s_write_config (path,
+            "{ \"manifest\" : 1, \"generation\" : 3, \"composites\" : {\n"
+            "  \"rack-temperature\" : { \"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+            "    \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack\", \"unit\" : \"C\" } ] },\n"
+            "  \"rack-humidity\" : { \"in\" : [ \"humidity@TH1\" ],\n"
+            "    \"evaluation\" : \"return 'max.humidity@rack', mt['humidity@TH1'], '%'\" }\n"
+            "} }\n");
+        // a newer compiled file next to a manifest does not shadow it
+        char *single = zsys_sprintf ("%s/composite-evaluator-single.cfg", SELFTEST_DIR_RW);
+        std::string shadow = std::string (path) + COMPOSITE_EVALUATOR_COMPILED_SUFFIX;
+        s_write_config (single, "{ \"in\" : [ \"x@TH1\" ], \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.x@TH1\" } ] }\n");
+        assert (composite_evaluator_compile (single, shadow.c_str ()) == 0);
+        unlink (single);
+        zstr_free (&single);
+        assert (composite_evaluator_load_source (path, evaluators) == 0);
+        assert (evaluators.size () == 2);
+        unlink (shadow.c_str ());
+        std::string name = std::string (path) + ":rack-temperature";
+        assert (streq (composite_evaluator_name (evaluators [0]), name.c_str ()));
+        assert (streq (composite_evaluator_source (evaluators [1]), path));
+        composite_evaluator_update (evaluators [0], "temperature@TH1", 20, now, now + 60);
+        composite_evaluator_update (evaluators [0], "temperature@TH2", 30, now, now + 60);
+        assert (composite_evaluator_evaluate (evaluators [0], now, outputs) == COMPOSITE_EVALUATOR_OK);
+        composite_evaluator_update (evaluators [1], "humidity@TH1", 55, now, now + 60);
+        assert (composite_evaluator_evaluate (evaluators [1], now, outputs) == COMPOSITE_EVALUATOR_OK);
+        assert (outputs.size () == 2);
+        assert (outputs [0].topic == "average.temperature@rack" && outputs [0].value == 25);
+        assert (outputs [1].topic == "max.humidity@rack" && outputs [1].value == 55);
+        outputs.clear ();
+        for (auto &evaluator : evaluators)
+            composite_evaluator_destroy (&evaluator);
+        evaluators.clear ();
+
+        // one invalid composite or an unknown version refuses the whole manifest
+        s_write_config (path,
+            "{ \"manifest\" : 1, \"generation\" : 4, \"composites\" : {\n"
+            "  \"rack-temperature\" : { \"in\" : [ \"temperature@TH1\" ],\n"
+            "    \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@rack\" } ] },\n"
+            "  \"rack-humidity\" : { \"in\" : [ \"humidity@TH1\" ] }\n"
+            "} }\n");
+        assert (composite_evaluator_load_source (path, evaluators) == -1);
+        assert (evaluators.empty ());
+        s_write_config (path, "{ \"manifest\" : 2, \"generation\" : 5, \"composites\" : {} }\n");
+        assert (composite_evaluator_load_source (path, evaluators) == -1);
+        s_write_config (path, "{ \"manifest\" : 1, \"generation\" : 6, \"composites\" : {} }\n");
+        assert (composite_evaluator_load_source (path, evaluators) == 0);
+        assert (evaluators.empty ());
+        unlink (path);
+        zstr_free (&path);
+    }
+    //  @end
+    log_info (" * composite_evaluator: OK\n");
+}
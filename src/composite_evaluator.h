@@ -0,0 +1,179 @@
+/*  =========================================================================
+    composite_evaluator - evaluation of one composite metric configuration
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef COMPOSITE_EVALUATOR_H_INCLUDED
+#define COMPOSITE_EVALUATOR_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _composite_evaluator_t composite_evaluator_t;
+
+//  Compiled configuration starts with this, composite_evaluator_load uses
+//  <file><suffix> instead of JSON <file> when it is not older
+#define COMPOSITE_EVALUATOR_COMPILED_MAGIC  "FTYCMPE1"
+#define COMPOSITE_EVALUATOR_COMPILED_SUFFIX ".bin"
+
+//  Version of manifests composite_evaluator_load_source understands
+#define COMPOSITE_EVALUATOR_MANIFEST_VERSION 1
+
+//  One metric produced by the evaluation
+typedef struct {
+    std::string topic;      // <type>@<asset>
+    double value;
+    std::string unit;
+} composite_output_t;
+
+//  Result of the evaluation
+typedef enum {
+    COMPOSITE_EVALUATOR_OK = 0,         // outputs were produced
+    COMPOSITE_EVALUATOR_NO_DATA,        // not enough valid data
+    COMPOSITE_EVALUATOR_ERROR,          // script failed, see composite_evaluator_error
+    COMPOSITE_EVALUATOR_LIMIT           // script exceeded its limits, see composite_evaluator_error
+} composite_evaluator_result_t;
+
+//  @interface
+//  Create a new empty evaluator, 'name' is used in logs
+FTY_METRIC_COMPOSITE_EXPORT composite_evaluator_t *
+    composite_evaluator_new (const char *name);
+
+//  Load configuration from JSON file, or from its compiled form made by
+//  composite_evaluator_compile (either the file itself, or <filename>.bin when
+//  it exists and is not older than the JSON file)
+//      "in"            list of input topics
+//      "evaluation"    (optional) Lua code, it returns either 'topic, value, unit'
+//                      or a table of outputs {{topic, value, unit}, ...}
+//      "expression"    (optional) {"formula": "...", "topic": "...", "unit": "..."} or
+//                      a list of them, see composite_expression; inputs of formulas
+//                      are added to "in"
+//      "reductions"    (optional) list of builtin reductions computed over valid
+//                      inputs {"function": "average|min|max|sum|count",
+//                      "topic": "...", "unit": "..."}
+//      "offsets"       (optional) object topic -> number added to the input
+//                      before the builtin reductions
+//      "out"           (optional) list of topics the Lua code produces, needed
+//                      when other evaluators of the same host consume them
+//      "groups"        (optional) object input topic -> group key; builtin reductions
+//                      are then computed per group, "{group}" in their topic is
+//                      replaced by the key. "in" may be omitted, "evaluation" is
+//                      not allowed.
+//      "evaluate_every_ms" (optional) evaluate periodically instead of on arrival
+//                      of inputs, then all groups are evaluated each time
+//      "window"        (optional) {"samples": N, "alpha": a} - windowed reductions
+//                      {"function": "moving_average|window_min|window_max|rate|ewma",
+//                      "input": "...", "topic": "...", "unit": "..."} work on last N
+//                      (default 10) samples of the input, 'alpha' of EWMA defaults
+//                      to 2 / (N + 1)
+//      "limits"        (optional) {"instructions": N, "memory_kb": M} - budget of one run
+//                      of the Lua code, 0 is unlimited; defaults are 10000000 and 16384
+//  0 - success, -1 - error
+FTY_METRIC_COMPOSITE_EXPORT int
+    composite_evaluator_load (composite_evaluator_t *self, const char *filename);
+
+//  Load all configurations of 'filename' and append their evaluators to 'evaluators':
+//  one evaluator named 'filename' for a configuration (see composite_evaluator_load),
+//  or one per composite of a manifest, named <filename>:<composite>. A manifest is
+//  JSON {"manifest": 1, "generation": N, "composites": {"<composite>": {...}, ...}},
+//  each member of "composites" is a configuration as composite_evaluator_load reads.
+//  The caller owns the evaluators. 0 - success, -1 - error, then nothing is appended
+//  (a manifest is loaded as a whole or not at all)
+FTY_METRIC_COMPOSITE_EXPORT int
+    composite_evaluator_load_source (const char *filename, std::vector <composite_evaluator_t *> &evaluators);
+
+//  Compile JSON configuration 'filename' into 'compiled': strings stored once,
+//  average scripts of the configurator already recognized and other Lua code
+//  precompiled to bytecode of the Lua the library is built with, so loading it
+//  is one read without JSON parsing nor Lua compilation. The file is replaced
+//  atomically. 0 - success, -1 - error (also when the configuration is invalid)
+FTY_METRIC_COMPOSITE_EXPORT int
+    composite_evaluator_compile (const char *filename, const char *compiled);
+
+//  Get name of the evaluator
+FTY_METRIC_COMPOSITE_EXPORT const char *
+    composite_evaluator_name (composite_evaluator_t *self);
+
+//  Get name of the file the configuration was loaded from, empty if it was not loaded
+FTY_METRIC_COMPOSITE_EXPORT const char *
+    composite_evaluator_source (composite_evaluator_t *self);
+
+//  Get period of evaluation in milliseconds, 0 if evaluated on arrival of inputs
+FTY_METRIC_COMPOSITE_EXPORT int64_t
+    composite_evaluator_period (composite_evaluator_t *self);
+
+//  Get input topics
+FTY_METRIC_COMPOSITE_EXPORT const std::vector <std::string> &
+    composite_evaluator_inputs (composite_evaluator_t *self);
+
+//  Get declared output topics ("out" and topics of the builtin reductions)
+FTY_METRIC_COMPOSITE_EXPORT const std::vector <std::string> &
+    composite_evaluator_outputs (composite_evaluator_t *self);
+
+//  Store new value of the input measured at 'timestamp' and valid till
+//  'valid_till' (unix time). Returns false if 'topic' is not an input of this evaluator
+FTY_METRIC_COMPOSITE_EXPORT bool
+    composite_evaluator_update (composite_evaluator_t *self, const std::string &topic, double value, time_t timestamp, time_t valid_till);
+
+//  Take last values of inputs which 'previous' has too, when self replaces it after
+//  a reload of the configuration; windows of windowed reductions start empty.
+//  Returns number of inputs taken
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    composite_evaluator_retain (composite_evaluator_t *self, composite_evaluator_t *previous);
+
+//  Evaluate the composite with inputs valid at 'now', append results to 'outputs'.
+//  With "groups" only groups with inputs updated since the last evaluation are evaluated.
+FTY_METRIC_COMPOSITE_EXPORT composite_evaluator_result_t
+    composite_evaluator_evaluate (composite_evaluator_t *self, time_t now, std::vector <composite_output_t> &outputs);
+
+//  Get name and version of the Lua implementation the evaluator is built with
+FTY_METRIC_COMPOSITE_EXPORT const char *
+    composite_evaluator_lua_version (void);
+
+//  Get number of allocations of the last run of the Lua code
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    composite_evaluator_lua_allocations (composite_evaluator_t *self);
+
+//  Get peak of memory in bytes of the last run of the Lua code
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    composite_evaluator_lua_peak (composite_evaluator_t *self);
+
+//  Get message of the last COMPOSITE_EVALUATOR_ERROR or COMPOSITE_EVALUATOR_LIMIT
+FTY_METRIC_COMPOSITE_EXPORT const char *
+    composite_evaluator_error (composite_evaluator_t *self);
+
+//  Destroy the composite_evaluator
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_evaluator_destroy (composite_evaluator_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_evaluator_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
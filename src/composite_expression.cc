@@ -0,0 +1,776 @@
+/*  =========================================================================
+    composite_expression - arithmetic formula compiled for evaluation without Lua
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+/*
+@header
+    composite_expression - arithmetic formula compiled for evaluation without Lua
+@discuss
+    Formulas too simple to justify a Lua state, like the sum of two UPS
+    powers or a ratio, are compiled once when the configuration is loaded
+    into a short program of a stack machine over the value arrays of the
+    evaluator, so the evaluation allocates nothing and runs no interpreter.
+
+    The syntax follows Lua so that formulas read like the scripts they
+    replace:
+
+    * inputs        mt['realpower@ups-1'] or mt["realpower@ups-1"]
+    * numbers       42, 0.5, 1e3
+    * arithmetic    + - * / % ^ and unary minus, with the precedence of Lua
+    * comparisons   < <= > >= == ~= (or !=), 1 when true, 0 otherwise
+    * logic         and, or, not over numbers, nonzero is true, result 1 or 0
+    * functions     min, max, sum, avg, count (any number of arguments),
+                    if (condition, then, else), default (x, fallback),
+                    abs, sqrt, log, exp, floor, ceil
+
+    An input which is not valid at the time of the evaluation is missing,
+    and so is everything computed from it, except that min, max, sum and avg
+    skip missing arguments (they are missing only when all arguments are),
+    count counts the present ones, default replaces a missing value by the
+    fallback and if only needs the condition and the selected branch.
+    A missing or non-finite result (e.g. division by zero) produces no
+    output, like a Lua script returning nothing.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+typedef enum {
+    OP_CONSTANT = 0,
+    OP_INPUT,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_POW,
+    OP_NEG,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_OR,
+    OP_NOT,
+    OP_IF,
+    OP_DEFAULT,
+    // any number of arguments
+    OP_MIN,
+    OP_MAX,
+    OP_SUM,
+    OP_AVG,
+    OP_COUNT,
+    // one argument
+    OP_ABS,
+    OP_SQRT,
+    OP_LOG,
+    OP_EXP,
+    OP_FLOOR,
+    OP_CEIL
+} opcode_t;
+
+typedef struct {
+    opcode_t op;
+    size_t arg;             // topic (slot after bind) of OP_INPUT, number of arguments of variadic functions
+    double constant;        // of OP_CONSTANT
+} instruction_t;
+
+//  Functions and their number of arguments, 0 - any (at least one)
+static const struct {
+    const char *name;
+    opcode_t op;
+    size_t arguments;
+} functions [] = {
+    {"min", OP_MIN, 0},
+    {"max", OP_MAX, 0},
+    {"sum", OP_SUM, 0},
+    {"avg", OP_AVG, 0},
+    {"count", OP_COUNT, 0},
+    {"if", OP_IF, 3},
+    {"default", OP_DEFAULT, 2},
+    {"abs", OP_ABS, 1},
+    {"sqrt", OP_SQRT, 1},
+    {"log", OP_LOG, 1},
+    {"exp", OP_EXP, 1},
+    {"floor", OP_FLOOR, 1},
+    {"ceil", OP_CEIL, 1},
+    {NULL, OP_CONSTANT, 0}
+};
+
+//  Deepest nesting of parentheses and calls accepted
+#define MAX_NESTING 100
+
+struct _composite_expression_t {
+    std::vector <instruction_t> program;
+    std::vector <std::string> topics;
+    std::vector <double> stack;         // sized to the deepest point of the program
+};
+
+//  State of the recursive descent parser
+typedef struct {
+    const char *formula;
+    const char *position;
+    size_t depth;                       // of the stack after the emitted code
+    size_t nesting;
+    composite_expression_t *expression;
+    std::string error;
+} parser_t;
+
+static const double MISSING = std::numeric_limits <double>::quiet_NaN ();
+
+static bool s_parse_or (parser_t *parser);
+static bool s_parse_unary (parser_t *parser);
+
+//  Append instruction which changes the depth of the stack by 'delta'
+static void
+s_emit (parser_t *parser, opcode_t op, size_t arg, double constant, long delta)
+{
+    instruction_t instruction = {op, arg, constant};
+    parser->expression->program.push_back (instruction);
+    parser->depth += delta;
+    if (parser->depth > parser->expression->stack.size ())
+        parser->expression->stack.resize (parser->depth);
+}
+
+static bool
+s_fail (parser_t *parser, const char *message)
+{
+    if (parser->error.empty ())
+        parser->error = std::string (message) + " at position " + std::to_string (parser->position - parser->formula + 1);
+    return false;
+}
+
+static void
+s_skip_space (parser_t *parser)
+{
+    while (isspace ((unsigned char) *parser->position))
+        parser->position++;
+}
+
+//  Consume 'token' if it is next in the formula
+static bool
+s_accept (parser_t *parser, const char *token)
+{
+    s_skip_space (parser);
+    size_t length = strlen (token);
+    if (strncmp (parser->position, token, length) != 0)
+        return false;
+    // keywords must not be a prefix of a longer name
+    if (isalpha ((unsigned char) token [0])) {
+        char next = parser->position [length];
+        if (isalnum ((unsigned char) next) || next == '_')
+            return false;
+    }
+    parser->position += length;
+    return true;
+}
+
+//  Read name of a function or of the table of inputs
+static std::string
+s_name (parser_t *parser)
+{
+    s_skip_space (parser);
+    const char *start = parser->position;
+    if (!isalpha ((unsigned char) *start) && *start != '_')
+        return "";
+    while (isalnum ((unsigned char) *parser->position) || *parser->position == '_')
+        parser->position++;
+    return std::string (start, parser->position - start);
+}
+
+//  mt['topic'], the opening bracket is already consumed
+static bool
+s_parse_input (parser_t *parser)
+{
+    s_skip_space (parser);
+    char quote = *parser->position;
+    if (quote != '\'' && quote != '"')
+        return s_fail (parser, "expected quoted topic");
+    const char *start = ++parser->position;
+    while (*parser->position && *parser->position != quote)
+        parser->position++;
+    if (!*parser->position)
+        return s_fail (parser, "unterminated topic");
+    std::string topic (start, parser->position - start);
+    parser->position++;
+    if (!s_accept (parser, "]"))
+        return s_fail (parser, "expected ']'");
+
+    std::vector <std::string> &topics = parser->expression->topics;
+    size_t index = 0;
+    while (index < topics.size () && topics [index] != topic)
+        index++;
+    if (index == topics.size ())
+        topics.push_back (topic);
+    s_emit (parser, OP_INPUT, index, 0, 1);
+    return true;
+}
+
+//  Arguments of function 'name', the opening parenthesis is already consumed
+static bool
+s_parse_call (parser_t *parser, const std::string &name)
+{
+    int i = 0;
+    while (functions [i].name && name != functions [i].name)
+        i++;
+    if (!functions [i].name)
+        return s_fail (parser, ("unknown function '" + name + "'").c_str ());
+
+    size_t count = 0;
+    if (!s_accept (parser, ")")) {
+        do {
+            if (!s_parse_or (parser))
+                return false;
+            count++;
+        } while (s_accept (parser, ","));
+        if (!s_accept (parser, ")"))
+            return s_fail (parser, "expected ')'");
+    }
+    if (functions [i].arguments ? count != functions [i].arguments : count == 0)
+        return s_fail (parser, ("wrong number of arguments of '" + name + "'").c_str ());
+    s_emit (parser, functions [i].op, count, 0, 1 - (long) count);
+    return true;
+}
+
+//  number, input, call or parenthesized expression
+static bool
+s_parse_primary (parser_t *parser)
+{
+    s_skip_space (parser);
+    if (++parser->nesting > MAX_NESTING)
+        return s_fail (parser, "expression nested too deep");
+
+    bool ok = false;
+    const char *c = parser->position;
+    if (isdigit ((unsigned char) *c) || (*c == '.' && isdigit ((unsigned char) c [1]))) {
+        char *end;
+        double value = strtod (c, &end);
+        parser->position = end;
+        s_emit (parser, OP_CONSTANT, 0, value, 1);
+        ok = true;
+    }
+    else
+    if (s_accept (parser, "(")) {
+        ok = s_parse_or (parser);
+        if (ok && !s_accept (parser, ")"))
+            ok = s_fail (parser, "expected ')'");
+    }
+    else {
+        std::string name = s_name (parser);
+        if (name.empty ())
+            ok = s_fail (parser, *parser->position ? "unexpected character" : "unexpected end");
+        else
+        if (name == "mt" && s_accept (parser, "["))
+            ok = s_parse_input (parser);
+        else
+        if (s_accept (parser, "("))
+            ok = s_parse_call (parser, name);
+        else
+            ok = s_fail (parser, ("unknown name '" + name + "'").c_str ());
+    }
+    parser->nesting--;
+    return ok;
+}
+
+//  Power is right associative and binds tighter than unary minus on its left
+static bool
+s_parse_power (parser_t *parser)
+{
+    if (!s_parse_primary (parser))
+        return false;
+    if (s_accept (parser, "^")) {
+        if (!s_parse_unary (parser))
+            return false;
+        s_emit (parser, OP_POW, 0, 0, -1);
+    }
+    return true;
+}
+
+//  Chains of unary operators recurse too, so they count to the nesting
+static bool
+s_parse_unary (parser_t *parser)
+{
+    bool negate = s_accept (parser, "-");
+    if (!negate && !s_accept (parser, "not"))
+        return s_parse_power (parser);
+    if (++parser->nesting > MAX_NESTING)
+        return s_fail (parser, "expression nested too deep");
+
+    bool ok = s_parse_unary (parser);
+    if (ok)
+        s_emit (parser, negate ? OP_NEG : OP_NOT, 0, 0, 0);
+    parser->nesting--;
+    return ok;
+}
+
+static bool
+s_parse_product (parser_t *parser)
+{
+    if (!s_parse_unary (parser))
+        return false;
+    while (true) {
+        opcode_t op;
+        if (s_accept (parser, "*"))
+            op = OP_MUL;
+        else
+        if (s_accept (parser, "/"))
+            op = OP_DIV;
+        else
+        if (s_accept (parser, "%"))
+            op = OP_MOD;
+        else
+            return true;
+        if (!s_parse_unary (parser))
+            return false;
+        s_emit (parser, op, 0, 0, -1);
+    }
+}
+
+static bool
+s_parse_sum (parser_t *parser)
+{
+    if (!s_parse_product (parser))
+        return false;
+    while (true) {
+        opcode_t op;
+        if (s_accept (parser, "+"))
+            op = OP_ADD;
+        else
+        if (s_accept (parser, "-"))
+            op = OP_SUB;
+        else
+            return true;
+        if (!s_parse_product (parser))
+            return false;
+        s_emit (parser, op, 0, 0, -1);
+    }
+}
+
+static bool
+s_parse_comparison (parser_t *parser)
+{
+    if (!s_parse_sum (parser))
+        return false;
+    while (true) {
+        opcode_t op;
+        // two character operators first
+        if (s_accept (parser, "<="))
+            op = OP_LE;
+        else
+        if (s_accept (parser, ">="))
+            op = OP_GE;
+        else
+        if (s_accept (parser, "=="))
+            op = OP_EQ;
+        else
+        if (s_accept (parser, "~=") || s_accept (parser, "!="))
+            op = OP_NE;
+        else
+        if (s_accept (parser, "<"))
+            op = OP_LT;
+        else
+        if (s_accept (parser, ">"))
+            op = OP_GT;
+        else
+            return true;
+        if (!s_parse_sum (parser))
+            return false;
+        s_emit (parser, op, 0, 0, -1);
+    }
+}
+
+static bool
+s_parse_and (parser_t *parser)
+{
+    if (!s_parse_comparison (parser))
+        return false;
+    while (s_accept (parser, "and")) {
+        if (!s_parse_comparison (parser))
+            return false;
+        s_emit (parser, OP_AND, 0, 0, -1);
+    }
+    return true;
+}
+
+static bool
+s_parse_or (parser_t *parser)
+{
+    if (!s_parse_and (parser))
+        return false;
+    while (s_accept (parser, "or")) {
+        if (!s_parse_and (parser))
+            return false;
+        s_emit (parser, OP_OR, 0, 0, -1);
+    }
+    return true;
+}
+
+//  --------------------------------------------------------------------------
+//  Compile a new composite_expression
+
+composite_expression_t *
+composite_expression_new (const char *formula, std::string &error)
+{
+    assert (formula);
+    composite_expression_t *self = new composite_expression_t ();
+    parser_t parser = {formula, formula, 0, 0, self, ""};
+    bool ok = s_parse_or (&parser);
+    s_skip_space (&parser);
+    if (ok && *parser.position)
+        ok = s_fail (&parser, "unexpected character");
+    if (!ok) {
+        error = parser.error;
+        composite_expression_destroy (&self);
+        return NULL;
+    }
+    assert (parser.depth == 1);
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the composite_expression
+
+void
+composite_expression_destroy (composite_expression_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        delete *self_p;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Get topics the formula reads
+
+const std::vector <std::string> &
+composite_expression_topics (composite_expression_t *self)
+{
+    assert (self);
+    return self->topics;
+}
+
+//  --------------------------------------------------------------------------
+//  Bind topics to positions of the value arrays
+
+void
+composite_expression_bind (composite_expression_t *self, const std::vector <size_t> &slots)
+{
+    assert (self);
+    assert (slots.size () == self->topics.size ());
+    // the program keeps the slot in place of the topic
+    for (size_t i = 0; i < self->program.size (); i++) {
+        if (self->program [i].op == OP_INPUT)
+            self->program [i].arg = slots [self->program [i].arg];
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Evaluate the formula over inputs valid at 'now'
+
+bool
+composite_expression_evaluate (composite_expression_t *self, const double *values, const time_t *valid_till, time_t now, double *result)
+{
+    assert (self);
+    assert (result);
+    double *top = self->stack.data () - 1;
+    for (const instruction_t &instruction : self->program) {
+        switch (instruction.op) {
+            case OP_CONSTANT:
+                *++top = instruction.constant;
+                break;
+            case OP_INPUT:
+                *++top = now > valid_till [instruction.arg] ? MISSING : values [instruction.arg];
+                break;
+            case OP_ADD:
+                top [-1] += top [0];
+                top--;
+                break;
+            case OP_SUB:
+                top [-1] -= top [0];
+                top--;
+                break;
+            case OP_MUL:
+                top [-1] *= top [0];
+                top--;
+                break;
+            case OP_DIV:
+                top [-1] /= top [0];
+                top--;
+                break;
+            case OP_MOD:
+                // sign of the divisor, as in Lua
+                top [-1] = top [-1] - floor (top [-1] / top [0]) * top [0];
+                top--;
+                break;
+            case OP_POW:
+                top [-1] = pow (top [-1], top [0]);
+                top--;
+                break;
+            case OP_NEG:
+                top [0] = -top [0];
+                break;
+            case OP_LT:
+            case OP_LE:
+            case OP_GT:
+            case OP_GE:
+            case OP_EQ:
+            case OP_NE:
+            case OP_AND:
+            case OP_OR: {
+                double a = top [-1], b = top [0];
+                top--;
+                if (std::isnan (a) || std::isnan (b)) {
+                    *top = MISSING;
+                    break;
+                }
+                bool truth;
+                switch (instruction.op) {
+                    case OP_LT:  truth = a < b; break;
+                    case OP_LE:  truth = a <= b; break;
+                    case OP_GT:  truth = a > b; break;
+                    case OP_GE:  truth = a >= b; break;
+                    case OP_EQ:  truth = a == b; break;
+                    case OP_NE:  truth = a != b; break;
+                    case OP_AND: truth = a != 0 && b != 0; break;
+                    default:     truth = a != 0 || b != 0; break;
+                }
+                *top = truth ? 1 : 0;
+                break;
+            }
+            case OP_NOT:
+                if (!std::isnan (top [0]))
+                    top [0] = top [0] == 0 ? 1 : 0;
+                break;
+            case OP_IF:
+                top -= 2;
+                if (!std::isnan (top [0]))
+                    top [0] = top [0] != 0 ? top [1] : top [2];
+                break;
+            case OP_DEFAULT:
+                top--;
+                if (std::isnan (top [0]))
+                    top [0] = top [1];
+                break;
+            case OP_MIN:
+            case OP_MAX:
+            case OP_SUM:
+            case OP_AVG:
+            case OP_COUNT: {
+                top -= instruction.arg - 1;
+                size_t count = 0;
+                double sum = 0;
+                double min = std::numeric_limits <double>::infinity ();
+                double max = -std::numeric_limits <double>::infinity ();
+                for (size_t i = 0; i < instruction.arg; i++) {
+                    double value = top [i];
+                    if (std::isnan (value))
+                        continue;
+                    count++;
+                    sum += value;
+                    min = std::min (min, value);
+                    max = std::max (max, value);
+                }
+                if (instruction.op == OP_COUNT)
+                    *top = count;
+                else
+                if (count == 0)
+                    *top = MISSING;
+                else
+                    *top = instruction.op == OP_MIN ? min :
+                           instruction.op == OP_MAX ? max :
+                           instruction.op == OP_SUM ? sum : sum / count;
+                break;
+            }
+            case OP_ABS:
+                top [0] = fabs (top [0]);
+                break;
+            case OP_SQRT:
+                top [0] = sqrt (top [0]);
+                break;
+            case OP_LOG:
+                top [0] = log (top [0]);
+                break;
+            case OP_EXP:
+                top [0] = exp (top [0]);
+                break;
+            case OP_FLOOR:
+                top [0] = floor (top [0]);
+                break;
+            case OP_CEIL:
+                top [0] = ceil (top [0]);
+                break;
+        }
+    }
+    assert (top == self->stack.data ());
+    if (!std::isfinite (*top))
+        return false;
+    *result = *top;
+    return true;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+//  Compile and evaluate 'formula' over inputs a, b, c (c is expired)
+static bool
+s_evaluate (const char *formula, double *result)
+{
+    std::string error;
+    composite_expression_t *self = composite_expression_new (formula, error);
+    assert (self);
+    // inputs are stored in reverse order to test the binding
+    static const char *names [] = {"c", "b", "a"};
+    double values [] = {100, 4, 10};
+    time_t valid_till [] = {10, 2000, 2000};
+    std::vector <size_t> slots;
+    for (const auto &topic : composite_expression_topics (self)) {
+        size_t slot = 0;
+        while (topic != names [slot])
+            slot++;
+        slots.push_back (slot);
+    }
+    composite_expression_bind (self, slots);
+    bool ok = composite_expression_evaluate (self, values, valid_till, 1000, result);
+    composite_expression_destroy (&self);
+    return ok;
+}
+
+static double
+s_value (const char *formula)
+{
+    double result = 0;
+    bool ok = s_evaluate (formula, &result);
+    assert (ok);
+    return result;
+}
+
+static bool
+s_missing (const char *formula)
+{
+    double result;
+    return !s_evaluate (formula, &result);
+}
+
+void
+composite_expression_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("composite-expression-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+
+    //  @selftest
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    std::string error;
+    composite_expression_t *self = composite_expression_new ("mt['a@x'] + mt[\"b@x\"] * mt['a@x']", error);
+    assert (self);
+    assert (composite_expression_topics (self).size () == 2);
+    assert (composite_expression_topics (self) [0] == "a@x");
+    assert (composite_expression_topics (self) [1] == "b@x");
+    composite_expression_destroy (&self);
+    assert (self == NULL);
+
+    // arithmetic and precedence of Lua
+    assert (s_value ("mt['a'] + mt['b']") == 14);
+    assert (s_value ("mt['a'] / mt['b']") == 2.5);
+    assert (s_value ("1 + 2 * 3") == 7);
+    assert (s_value ("(1 + 2) * 3") == 9);
+    assert (s_value ("10 - 4 - 3") == 3);
+    assert (s_value ("2 ^ 3 ^ 2") == 512);
+    assert (s_value ("-2 ^ 2") == -4);
+    assert (s_value ("-7 % 3") == 2);
+    assert (s_value ("1.5e1 + .5") == 15.5);
+
+    // comparisons, logic and conditionals
+    assert (s_value ("mt['a'] > mt['b']") == 1);
+    assert (s_value ("mt['a'] <= mt['b']") == 0);
+    assert (s_value ("mt['a'] ~= 10") == 0);
+    assert (s_value ("mt['a'] != 4") == 1);
+    assert (s_value ("1 < 2 and 3 < 2 or not 0") == 1);
+    assert (s_value ("if (mt['a'] > 5, 1, 2)") == 1);
+    assert (s_value ("if (mt['a'] > 50, 1, 2)") == 2);
+
+    // functions
+    assert (s_value ("min (mt['a'], mt['b'], 7)") == 4);
+    assert (s_value ("max (mt['a'], mt['b'], 7)") == 10);
+    assert (s_value ("sum (mt['a'], mt['b'])") == 14);
+    assert (s_value ("avg (mt['a'], mt['b'])") == 7);
+    assert (s_value ("abs (-3) + sqrt (16) + floor (1.5) + ceil (1.5)") == 10);
+    assert (fabs (s_value ("log (exp (2))") - 2) < 1e-12);
+
+    // missing inputs
+    assert (s_missing ("mt['c']"));
+    assert (s_missing ("mt['a'] + mt['c']"));
+    assert (s_missing ("mt['c'] > 1"));
+    assert (s_missing ("not mt['c']"));
+    assert (s_missing ("if (mt['c'], 1, 2)"));
+    assert (s_missing ("min (mt['c'])"));
+    assert (s_value ("if (mt['a'] > 5, 1, mt['c'])") == 1);
+    assert (s_value ("avg (mt['a'], mt['b'], mt['c'])") == 7);
+    assert (s_value ("count (mt['a'], mt['b'], mt['c'])") == 2);
+    assert (s_value ("default (mt['c'], 0) + mt['a']") == 10);
+    assert (s_value ("default (mt['b'], 0)") == 4);
+    // non-finite results are not published
+    assert (s_missing ("mt['a'] / 0"));
+    assert (s_missing ("sqrt (-1)"));
+
+    // syntax errors
+    const char *invalid [] = {
+        "", "1 +", "(1", "1)", "mt[a]", "mt['a'", "mt['a]", "foo (1)", "bar",
+        "min ()", "if (1, 2)", "abs (1, 2)", "1 $ 2", "mt 'a'", "'a'", NULL
+    };
+    for (int i = 0; invalid [i]; i++) {
+        error.clear ();
+        self = composite_expression_new (invalid [i], error);
+        assert (!self);
+        assert (!error.empty ());
+        log_debug ("'%s': %s", invalid [i], error.c_str ());
+    }
+    self = composite_expression_new ("1 + foo (2)", error);
+    assert (!self);
+    assert (error == "unknown function 'foo' at position 10");
+    std::string deep (MAX_NESTING + 1, '(');
+    deep += "1" + std::string (MAX_NESTING + 1, ')');
+    assert (!composite_expression_new (deep.c_str (), error));
+    std::string negated (MAX_NESTING + 1, '-');
+    negated += "1";
+    assert (!composite_expression_new (negated.c_str (), error));
+    assert (error.find ("nested too deep") != std::string::npos);
+    // keywords are not prefixes of names
+    assert (!composite_expression_new ("1 andy 2", error));
+    //  @end
+    log_info (" * composite_expression: OK\n");
+}
@@ -0,0 +1,68 @@
+/*  =========================================================================
+    composite_expression - arithmetic formula compiled for evaluation without Lua
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+#ifndef COMPOSITE_EXPRESSION_H_INCLUDED
+#define COMPOSITE_EXPRESSION_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _composite_expression_t composite_expression_t;
+
+//  @interface
+//  Compile 'formula', NULL on syntax error (see 'error' then)
+FTY_METRIC_COMPOSITE_EXPORT composite_expression_t *
+    composite_expression_new (const char *formula, std::string &error);
+
+//  Get topics the formula reads, in order of their first use
+FTY_METRIC_COMPOSITE_EXPORT const std::vector <std::string> &
+    composite_expression_topics (composite_expression_t *self);
+
+//  Bind topics to positions of the value arrays given to evaluate,
+//  'slots' [i] is the position of composite_expression_topics [i]
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_expression_bind (composite_expression_t *self, const std::vector <size_t> &slots);
+
+//  Evaluate the formula over inputs valid at 'now', inputs with 'valid_till'
+//  before 'now' are missing. Returns false if the result is missing or not finite.
+FTY_METRIC_COMPOSITE_EXPORT bool
+    composite_expression_evaluate (composite_expression_t *self, const double *values, const time_t *valid_till, time_t now, double *result);
+
+//  Destroy the composite_expression
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_expression_destroy (composite_expression_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_expression_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,865 @@
+/*  =========================================================================
+    composite_graph - composite evaluators of one host ordered as a DAG
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    composite_graph - composite evaluators of one host ordered as a DAG
+@discuss
+    Evaluator B depends on evaluator A when one of B's inputs is a declared
+    output of A. Evaluators are kept in topological order of these edges
+    (ties broken by the order of addition), an evaluator closing a cycle is
+    refused.
+
+    Outputs of an evaluation are stored directly into the evaluators
+    consuming them, which are then evaluated later in the same pass, so
+    a row average computed from rack averages needs no round-trip through
+    shm and malamute. Each evaluator runs at most once per pass; outputs
+    which were not declared and reach an evaluator earlier in the order are
+    only stored and used by its next evaluation.
+
+    Evaluators with "evaluate_every_ms" only store their inputs; they are
+    evaluated by composite_graph_tick when their period elapses, and the
+    evaluators consuming their outputs follow in the same pass.
+
+    composite_graph_split divides the evaluators into independent graphs for
+    evaluation in separate threads: connected components of the shared
+    topics are never split, so outputs are still passed in memory, and
+    components are placed largest first into the graph with fewest inputs.
+
+    composite_graph_replace swaps in a reloaded configuration in one step:
+    the new evaluator gets the last values of the inputs it shares with the
+    old one, so its first evaluation does not wait for all sensors again.
+    composite_graph_reload does the same for all evaluators loaded from one
+    file, e.g. a manifest of the configurator: the new generation replaces
+    the old one in one step, composites missing from it are removed.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+#include "fty_metric_composite_trace.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+struct _composite_graph_t {
+    std::vector <composite_evaluator_t *> evaluators;           // topological order
+    std::map <std::string, std::vector <size_t>> consumers;     // topic -> positions
+    std::set <std::string> produced;                            // declared outputs
+    std::vector <bool> dirty;
+    std::vector <int64_t> due;                                  // of periodic evaluators (zclock_mono)
+};
+
+//  Sort 'list' topologically by declared outputs; false if there is a cycle
+static bool
+s_sort (std::vector <composite_evaluator_t *> &list)
+{
+    std::map <std::string, std::vector <size_t>> producers;
+    for (size_t i = 0; i < list.size (); i++) {
+        for (const auto &topic : composite_evaluator_outputs (list [i]))
+            producers [topic].push_back (i);
+    }
+    std::vector <std::vector <size_t>> edges (list.size ());
+    std::vector <size_t> indegree (list.size (), 0);
+    for (size_t i = 0; i < list.size (); i++) {
+        for (const auto &topic : composite_evaluator_inputs (list [i])) {
+            auto it = producers.find (topic);
+            if (it == producers.end ())
+                continue;
+            for (size_t producer : it->second) {
+                edges [producer].push_back (i);
+                indegree [i]++;
+            }
+        }
+    }
+
+    // Kahn's algorithm, always taking the first ready evaluator
+    std::set <size_t> ready;
+    for (size_t i = 0; i < list.size (); i++) {
+        if (indegree [i] == 0)
+            ready.insert (i);
+    }
+    std::vector <composite_evaluator_t *> sorted;
+    while (!ready.empty ()) {
+        size_t i = *ready.begin ();
+        ready.erase (ready.begin ());
+        sorted.push_back (list [i]);
+        for (size_t next : edges [i]) {
+            if (--indegree [next] == 0)
+                ready.insert (next);
+        }
+    }
+    if (sorted.size () != list.size ()) {
+        for (size_t i = 0; i < list.size (); i++) {
+            if (indegree [i] > 0)
+                log_error ("%s:\tIs part of a cycle of composite metrics", composite_evaluator_name (list [i]));
+        }
+        return false;
+    }
+    list = sorted;
+    return true;
+}
+
+//  Set sorted 'list' as the evaluators of the graph, keep periodic evaluations
+//  of evaluators in 'due' in their phase
+static void
+s_assign (composite_graph_t *self, const std::vector <composite_evaluator_t *> &list, const std::map <composite_evaluator_t *, int64_t> &due)
+{
+    self->due.clear ();
+    for (auto evaluator : list) {
+        auto it = due.find (evaluator);
+        self->due.push_back (it != due.end () ? it->second : zclock_mono () + composite_evaluator_period (evaluator));
+    }
+
+    self->evaluators = list;
+    self->consumers.clear ();
+    self->produced.clear ();
+    for (size_t i = 0; i < list.size (); i++) {
+        for (const auto &topic : composite_evaluator_inputs (list [i]))
+            self->consumers [topic].push_back (i);
+        for (const auto &topic : composite_evaluator_outputs (list [i]))
+            self->produced.insert (topic);
+    }
+    // positions changed, pending evaluations will be done on next update
+    self->dirty.assign (list.size (), false);
+}
+
+//  Add phases of periodic evaluations of the graph to 'due'
+static void
+s_due (composite_graph_t *self, std::map <composite_evaluator_t *, int64_t> &due)
+{
+    for (size_t i = 0; i < self->evaluators.size (); i++)
+        due [self->evaluators [i]] = self->due [i];
+}
+
+//  Find representative of the component, halving the path
+static size_t
+s_find_root (std::vector <size_t> &parent, size_t i)
+{
+    while (parent [i] != i) {
+        parent [i] = parent [parent [i]];
+        i = parent [i];
+    }
+    return i;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new empty graph
+
+composite_graph_t *
+composite_graph_new (void)
+{
+    return new composite_graph_t ();
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the composite_graph and all its evaluators
+
+void
+composite_graph_destroy (composite_graph_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        composite_graph_t *self = *self_p;
+        for (auto evaluator : self->evaluators)
+            composite_evaluator_destroy (&evaluator);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Add evaluator, refuse it if it makes a cycle
+
+int
+composite_graph_add (composite_graph_t *self, composite_evaluator_t **evaluator_p)
+{
+    assert (self);
+    assert (evaluator_p);
+    assert (*evaluator_p);
+
+    std::vector <composite_evaluator_t *> list = self->evaluators;
+    list.push_back (*evaluator_p);
+    if (!s_sort (list))
+        return -1;
+    *evaluator_p = NULL;
+
+    std::map <composite_evaluator_t *, int64_t> due;
+    s_due (self, due);
+    s_assign (self, list, due);
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Replace the evaluator with the same name, keep values of retained inputs
+
+int
+composite_graph_replace (composite_graph_t *self, composite_evaluator_t **evaluator_p)
+{
+    assert (self);
+    assert (evaluator_p);
+    assert (*evaluator_p);
+
+    composite_evaluator_t *evaluator = *evaluator_p;
+    const char *name = composite_evaluator_name (evaluator);
+    std::vector <composite_evaluator_t *> list = self->evaluators;
+    composite_evaluator_t *previous = NULL;
+    for (auto &item : list) {
+        if (streq (composite_evaluator_name (item), name)) {
+            previous = item;
+            item = evaluator;
+            break;
+        }
+    }
+    if (!previous)
+        return composite_graph_add (self, evaluator_p);
+    if (!s_sort (list))
+        return -1;
+    *evaluator_p = NULL;
+
+    size_t retained = composite_evaluator_retain (evaluator, previous);
+    log_info ("%s:\tReloaded, %zu inputs kept their values", name, retained);
+    std::map <composite_evaluator_t *, int64_t> due;
+    s_due (self, due);
+    if (composite_evaluator_period (evaluator) == composite_evaluator_period (previous))
+        due [evaluator] = due [previous];
+    due.erase (previous);
+    s_assign (self, list, due);
+    composite_evaluator_destroy (&previous);
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Replace all evaluators loaded from 'source' by 'evaluators'
+
+int
+composite_graph_reload (composite_graph_t *self, const char *source, std::vector <composite_evaluator_t *> &evaluators)
+{
+    assert (self);
+    assert (source);
+
+    std::map <std::string, composite_evaluator_t *> previous;  // name -> evaluator of the source
+    std::vector <composite_evaluator_t *> list;
+    for (auto item : self->evaluators) {
+        if (streq (composite_evaluator_source (item), source))
+            previous [composite_evaluator_name (item)] = item;
+        else
+            list.push_back (item);
+    }
+    list.insert (list.end (), evaluators.begin (), evaluators.end ());
+    if (!s_sort (list))
+        return -1;
+
+    std::map <composite_evaluator_t *, int64_t> due;
+    s_due (self, due);
+    size_t replaced = 0, retained = 0;
+    for (auto evaluator : evaluators) {
+        auto it = previous.find (composite_evaluator_name (evaluator));
+        if (it == previous.end ())
+            continue;
+        replaced++;
+        retained += composite_evaluator_retain (evaluator, it->second);
+        if (composite_evaluator_period (evaluator) == composite_evaluator_period (it->second))
+            due [evaluator] = due [it->second];
+    }
+    for (const auto &item : previous)
+        due.erase (item.second);
+    s_assign (self, list, due);
+    for (auto &item : previous)
+        composite_evaluator_destroy (&item.second);
+    log_info ("%s:\tReloaded, %zu composites replaced, %zu added, %zu removed, %zu inputs kept their values",
+        source, replaced, evaluators.size () - replaced, previous.size () - replaced, retained);
+    evaluators.clear ();
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Move all evaluators into at most 'count' new graphs
+
+std::vector <composite_graph_t *>
+composite_graph_split (composite_graph_t *self, size_t count)
+{
+    assert (self);
+    assert (count > 0);
+
+    // components of evaluators sharing inputs or outputs
+    size_t size = self->evaluators.size ();
+    std::vector <size_t> parent (size);
+    for (size_t i = 0; i < size; i++)
+        parent [i] = i;
+    std::map <std::string, size_t> owner;
+    for (size_t i = 0; i < size; i++) {
+        std::vector <std::string> topics = composite_evaluator_inputs (self->evaluators [i]);
+        const auto &outputs = composite_evaluator_outputs (self->evaluators [i]);
+        topics.insert (topics.end (), outputs.begin (), outputs.end ());
+        for (const auto &topic : topics) {
+            auto it = owner.find (topic);
+            if (it == owner.end ())
+                owner [topic] = i;
+            else
+                parent [s_find_root (parent, i)] = s_find_root (parent, it->second);
+        }
+    }
+    // members stay in topological order
+    std::map <size_t, std::vector <size_t>> members;
+    std::map <size_t, size_t> load;
+    for (size_t i = 0; i < size; i++) {
+        size_t root = s_find_root (parent, i);
+        members [root].push_back (i);
+        load [root] += composite_evaluator_inputs (self->evaluators [i]).size () + 1;
+    }
+    std::vector <size_t> roots;
+    for (const auto &item : members)
+        roots.push_back (item.first);
+    std::stable_sort (roots.begin (), roots.end (),
+        [&load] (size_t a, size_t b) { return load [a] > load [b]; });
+
+    std::map <composite_evaluator_t *, int64_t> due;
+    s_due (self, due);
+    std::vector <std::vector <composite_evaluator_t *>> lists (std::min (count, roots.size ()));
+    std::vector <size_t> loads (lists.size (), 0);
+    for (size_t root : roots) {
+        size_t target = std::min_element (loads.begin (), loads.end ()) - loads.begin ();
+        loads [target] += load [root];
+        for (size_t i : members [root])
+            lists [target].push_back (self->evaluators [i]);
+    }
+    // a list gathered from sorted components is sorted too
+    std::vector <composite_graph_t *> graphs;
+    for (const auto &list : lists) {
+        composite_graph_t *graph = composite_graph_new ();
+        std::vector <composite_evaluator_t *> sorted = list;
+        s_sort (sorted);
+        s_assign (graph, sorted, due);
+        graphs.push_back (graph);
+    }
+    s_assign (self, std::vector <composite_evaluator_t *> (), due);
+    return graphs;
+}
+
+//  --------------------------------------------------------------------------
+//  Move all evaluators of 'other' into self and destroy 'other'
+
+int
+composite_graph_join (composite_graph_t *self, composite_graph_t **other_p)
+{
+    assert (self);
+    assert (other_p);
+    assert (*other_p);
+    composite_graph_t *other = *other_p;
+
+    std::vector <composite_evaluator_t *> list = self->evaluators;
+    list.insert (list.end (), other->evaluators.begin (), other->evaluators.end ());
+    if (!s_sort (list))
+        return -1;
+
+    std::map <composite_evaluator_t *, int64_t> due;
+    s_due (self, due);
+    s_due (other, due);
+    s_assign (self, list, due);
+    // evaluators now belong to self
+    other->evaluators.clear ();
+    composite_graph_destroy (other_p);
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of evaluators
+
+size_t
+composite_graph_size (composite_graph_t *self)
+{
+    assert (self);
+    return self->evaluators.size ();
+}
+
+//  --------------------------------------------------------------------------
+//  Get evaluator at position 'index' of the topological order
+
+composite_evaluator_t *
+composite_graph_at (composite_graph_t *self, size_t index)
+{
+    assert (self);
+    return index < self->evaluators.size () ? self->evaluators [index] : NULL;
+}
+
+//  --------------------------------------------------------------------------
+//  Return true if 'topic' is a declared output of some evaluator
+
+bool
+composite_graph_produces (composite_graph_t *self, const std::string &topic)
+{
+    assert (self);
+    return self->produced.count (topic) > 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Store new value of an external input
+
+bool
+composite_graph_update (composite_graph_t *self, const std::string &topic, double value, time_t timestamp, time_t valid_till)
+{
+    assert (self);
+    auto it = self->consumers.find (topic);
+    if (it == self->consumers.end ())
+        return false;
+    for (size_t i : it->second) {
+        composite_evaluator_update (self->evaluators [i], topic, value, timestamp, valid_till);
+        if (composite_evaluator_period (self->evaluators [i]) == 0)
+            self->dirty [i] = true;
+    }
+    return true;
+}
+
+//  --------------------------------------------------------------------------
+//  Evaluate marked evaluators in topological order
+
+size_t
+composite_graph_evaluate (composite_graph_t *self, time_t now, time_t ttl, std::vector <composite_output_t> &outputs, composite_stats_t *stats)
+{
+    assert (self);
+    size_t evaluations = 0;
+    std::vector <composite_output_t> produced;
+    for (size_t i = 0; i < self->evaluators.size (); i++) {
+        if (!self->dirty [i])
+            continue;
+        self->dirty [i] = false;
+        evaluations++;
+        composite_evaluator_t *evaluator = self->evaluators [i];
+        if (stats)
+            composite_stats_count (stats, COMPOSITE_STATS_EVALUATIONS);
+
+        produced.clear ();
+        composite_evaluator_result_t result = composite_evaluator_evaluate (evaluator, now, produced);
+        if (stats && composite_evaluator_lua_allocations (evaluator) > 0) {
+            composite_stats_add (stats, COMPOSITE_STATS_LUA_ALLOCATIONS, composite_evaluator_lua_allocations (evaluator));
+            composite_stats_maximum (stats, COMPOSITE_STATS_LUA_PEAK_KB, composite_evaluator_lua_peak (evaluator) / 1024);
+        }
+        if (result == COMPOSITE_EVALUATOR_ERROR) {
+            if (stats)
+                composite_stats_count (stats, COMPOSITE_STATS_LUA_ERRORS);
+            log_error ("%s: %s", composite_evaluator_name (evaluator), composite_evaluator_error (evaluator));
+        }
+        else
+        if (result == COMPOSITE_EVALUATOR_LIMIT) {
+            if (stats)
+                composite_stats_count (stats, COMPOSITE_STATS_LUA_LIMITS);
+            log_error ("%s: Evaluation stopped, %s", composite_evaluator_name (evaluator), composite_evaluator_error (evaluator));
+        }
+        else
+        if (result == COMPOSITE_EVALUATOR_NO_DATA) {
+            FTY_METRIC_COMPOSITE_TRACE1 (not_enough_data, composite_evaluator_name (evaluator));
+            if (stats)
+                composite_stats_count (stats, COMPOSITE_STATS_NOT_ENOUGH_DATA);
+            log_error ("%s: Not enough valid data...", composite_evaluator_name (evaluator));
+        }
+
+        for (const auto &output : produced) {
+            auto it = self->consumers.find (output.topic);
+            if (it == self->consumers.end ())
+                continue;
+            for (size_t consumer : it->second) {
+                composite_evaluator_update (self->evaluators [consumer], output.topic, output.value, now, now + ttl);
+                if (consumer > i && composite_evaluator_period (self->evaluators [consumer]) == 0)
+                    self->dirty [consumer] = true;
+            }
+        }
+        outputs.insert (outputs.end (), produced.begin (), produced.end ());
+    }
+    return evaluations;
+}
+
+//  --------------------------------------------------------------------------
+//  Evaluate periodic evaluators which are due
+
+size_t
+composite_graph_tick (composite_graph_t *self, int64_t mono, time_t now, time_t ttl, std::vector <composite_output_t> &outputs, composite_stats_t *stats)
+{
+    assert (self);
+    bool any = false;
+    for (size_t i = 0; i < self->evaluators.size (); i++) {
+        int64_t period = composite_evaluator_period (self->evaluators [i]);
+        if (period == 0 || self->due [i] > mono)
+            continue;
+        self->dirty [i] = true;
+        any = true;
+        // keep the phase, but do not try to catch up missed periods
+        self->due [i] += period * ((mono - self->due [i]) / period + 1);
+    }
+    return any ? composite_graph_evaluate (self, now, ttl, outputs, stats) : 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Get milliseconds till the next periodic evaluation
+
+int64_t
+composite_graph_timeout (composite_graph_t *self, int64_t mono)
+{
+    assert (self);
+    int64_t timeout = -1;
+    for (size_t i = 0; i < self->evaluators.size (); i++) {
+        if (composite_evaluator_period (self->evaluators [i]) == 0)
+            continue;
+        int64_t remaining = self->due [i] > mono ? self->due [i] - mono : 0;
+        if (timeout < 0 || remaining < timeout)
+            timeout = remaining;
+    }
+    return timeout;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+static composite_evaluator_t *
+s_evaluator (const char *dir, const char *name, const char *contents)
+{
+    char *path = zsys_sprintf ("%s/composite-graph-%s.cfg", dir, name);
+    assert (path);
+    FILE *file = fopen (path, "w");
+    assert (file);
+    fputs (contents, file);
+    fclose (file);
+    composite_evaluator_t *evaluator = composite_evaluator_new (name);
+    int rv = composite_evaluator_load (evaluator, path);
+    assert (rv == 0);
+    unlink (path);
+    zstr_free (&path);
+    return evaluator;
+}
+
+static void
+s_load_source (const char *path, const char *contents, std::vector <composite_evaluator_t *> &evaluators)
+{
+    FILE *file = fopen (path, "w");
+    assert (file);
+    fputs (contents, file);
+    fclose (file);
+    int rv = composite_evaluator_load_source (path, evaluators);
+    assert (rv == 0);
+}
+
+static const composite_output_t *
+s_find (const std::vector <composite_output_t> &outputs, const char *topic)
+{
+    for (const auto &output : outputs) {
+        if (output.topic == topic)
+            return &output;
+    }
+    return NULL;
+}
+
+void
+composite_graph_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("composite-graph-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    composite_graph_t *self = composite_graph_new ();
+    assert (self);
+
+    // added in reverse order of dependencies
+    composite_evaluator_t *evaluator = s_evaluator (SELFTEST_DIR_RW, "room",
+        "{ \"in\" : [ \"average.temperature@row1\" ],\n"
+        "  \"out\" : [ \"average.temperature@room1\" ],\n"
+        "  \"evaluation\" : \"return 'average.temperature@room1', mt['average.temperature@row1'], 'C'\" }\n");
+    assert (composite_graph_add (self, &evaluator) == 0);
+    assert (evaluator == NULL);
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "row",
+        "{ \"in\" : [ \"average.temperature@rack1\", \"average.temperature@rack2\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@row1\", \"unit\" : \"C\" },\n"
+        "                   { \"function\" : \"max\", \"topic\" : \"max.temperature@row1\", \"unit\" : \"C\" } ] }\n");
+    assert (composite_graph_add (self, &evaluator) == 0);
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "rack1",
+        "{ \"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack1\", \"unit\" : \"C\" } ] }\n");
+    assert (composite_graph_add (self, &evaluator) == 0);
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "rack2",
+        "{ \"in\" : [ \"temperature@TH3\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack2\", \"unit\" : \"C\" } ] }\n");
+    assert (composite_graph_add (self, &evaluator) == 0);
+    assert (composite_graph_size (self) == 4);
+    assert (streq (composite_evaluator_name (composite_graph_at (self, 0)), "rack1"));
+    assert (streq (composite_evaluator_name (composite_graph_at (self, 1)), "rack2"));
+    assert (streq (composite_evaluator_name (composite_graph_at (self, 2)), "row"));
+    assert (streq (composite_evaluator_name (composite_graph_at (self, 3)), "room"));
+    assert (composite_graph_at (self, 4) == NULL);
+    assert (composite_graph_produces (self, "average.temperature@rack1"));
+    assert (!composite_graph_produces (self, "temperature@TH1"));
+
+    // cycles are refused
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "cycle",
+        "{ \"in\" : [ \"average.temperature@room1\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"sum\", \"topic\" : \"average.temperature@rack1\" } ] }\n");
+    assert (composite_graph_add (self, &evaluator) == -1);
+    assert (evaluator);
+    composite_evaluator_destroy (&evaluator);
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "loop",
+        "{ \"in\" : [ \"power@ups\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"sum\", \"topic\" : \"power@ups\" } ] }\n");
+    assert (composite_graph_add (self, &evaluator) == -1);
+    composite_evaluator_destroy (&evaluator);
+    assert (composite_graph_size (self) == 4);
+    assert (streq (composite_evaluator_name (composite_graph_at (self, 3)), "room"));
+
+    // one pass propagates through all levels
+    composite_stats_t *stats = composite_stats_new ();
+    time_t now = time (NULL);
+    std::vector <composite_output_t> outputs;
+    assert (!composite_graph_update (self, "temperature@TH4", 20, now, now + 60));
+    assert (composite_graph_update (self, "temperature@TH1", 20, now, now + 60));
+    assert (composite_graph_update (self, "temperature@TH2", 30, now, now + 60));
+    assert (composite_graph_update (self, "temperature@TH3", 40, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 4);
+    assert (outputs.size () == 5);
+    assert (s_find (outputs, "average.temperature@rack1")->value == 25);
+    assert (s_find (outputs, "average.temperature@rack2")->value == 40);
+    assert (s_find (outputs, "average.temperature@row1")->value == 32.5);
+    assert (s_find (outputs, "max.temperature@row1")->value == 40);
+    assert (s_find (outputs, "average.temperature@room1")->value == 32.5);
+    assert (composite_stats_counter (stats, COMPOSITE_STATS_EVALUATIONS) == 4);
+
+    // nothing changed, nothing evaluated
+    outputs.clear ();
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 0);
+    assert (outputs.empty ());
+
+    // only the affected path is evaluated
+    assert (composite_graph_update (self, "temperature@TH3", 50, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 3);
+    assert (!s_find (outputs, "average.temperature@rack1"));
+    assert (s_find (outputs, "average.temperature@row1")->value == 37.5);
+    assert (s_find (outputs, "average.temperature@room1")->value == 37.5);
+
+    // expired sensor -> no data, nothing further down is evaluated
+    outputs.clear ();
+    assert (composite_graph_update (self, "temperature@TH3", 50, now, now - 1));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 1);
+    assert (outputs.empty ());
+    assert (composite_stats_counter (stats, COMPOSITE_STATS_NOT_ENOUGH_DATA) == 1);
+
+    // reload: kept inputs keep their values, outputs follow the new configuration
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "rack2",
+        "{ \"in\" : [ \"temperature@TH3\", \"temperature@TH4\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"average.temperature@rack2\", \"unit\" : \"C\" } ] }\n");
+    assert (composite_graph_replace (self, &evaluator) == 0);
+    assert (evaluator == NULL);
+    assert (composite_graph_size (self) == 4);
+    assert (streq (composite_evaluator_name (composite_graph_at (self, 1)), "rack2"));
+    assert (composite_evaluator_inputs (composite_graph_at (self, 1)).size () == 2);
+    outputs.clear ();
+    assert (composite_graph_update (self, "temperature@TH4", 45, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 3);
+    assert (s_find (outputs, "average.temperature@rack2")->value == 45);   // TH3 expired before
+    assert (composite_graph_update (self, "temperature@TH3", 50, now, now + 60));
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "rack2",
+        "{ \"in\" : [ \"temperature@TH3\", \"temperature@TH4\", \"temperature@TH5\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack2\", \"unit\" : \"C\" } ] }\n");
+    assert (composite_graph_replace (self, &evaluator) == 0);
+    outputs.clear ();
+    assert (composite_graph_update (self, "temperature@TH5", 40, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 3);
+    assert (s_find (outputs, "average.temperature@rack2")->value == 45);   // (50 + 45 + 40) / 3
+    // a reload closing a cycle is refused, the old configuration stays
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "rack2",
+        "{ \"in\" : [ \"average.temperature@room1\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"average.temperature@rack2\" } ] }\n");
+    assert (composite_graph_replace (self, &evaluator) == -1);
+    assert (evaluator);
+    composite_evaluator_destroy (&evaluator);
+    assert (composite_evaluator_inputs (composite_graph_at (self, 1)).size () == 3);
+    // unknown name is added
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "rack3",
+        "{ \"in\" : [ \"temperature@TH6\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack3\" } ] }\n");
+    assert (composite_graph_replace (self, &evaluator) == 0);
+    assert (composite_graph_size (self) == 5);
+
+    composite_graph_destroy (&self);
+    assert (self == NULL);
+
+    // reload of a manifest: its composites are replaced, added and removed in one step
+    self = composite_graph_new ();
+    char *path = zsys_sprintf ("%s/composite-graph-manifest.cfg", SELFTEST_DIR_RW);
+    std::vector <composite_evaluator_t *> evaluators;
+    s_load_source (path,
+        "{ \"manifest\" : 1, \"generation\" : 1, \"composites\" : {\n"
+        "  \"rack1\" : { \"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack1\" } ] },\n"
+        "  \"rack2\" : { \"in\" : [ \"temperature@TH3\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack2\" } ] },\n"
+        "  \"row\" : { \"in\" : [ \"average.temperature@rack1\", \"average.temperature@rack2\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@row1\" } ] }\n"
+        "} }\n", evaluators);
+    assert (composite_graph_reload (self, path, evaluators) == 0);
+    assert (evaluators.empty ());
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "room",
+        "{ \"in\" : [ \"average.temperature@row1\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"average.temperature@room1\" } ] }\n");
+    assert (composite_graph_add (self, &evaluator) == 0);
+    assert (composite_graph_size (self) == 4);
+    outputs.clear ();
+    assert (composite_graph_update (self, "temperature@TH1", 20, now, now + 60));
+    assert (composite_graph_update (self, "temperature@TH2", 30, now, now + 60));
+    assert (composite_graph_update (self, "temperature@TH3", 40, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 4);
+    assert (s_find (outputs, "average.temperature@row1")->value == 32.5);
+
+    // rack1 changed, rack2 removed, rack3 added; other files are not touched
+    s_load_source (path,
+        "{ \"manifest\" : 1, \"generation\" : 2, \"composites\" : {\n"
+        "  \"rack1\" : { \"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"average.temperature@rack1\" } ] },\n"
+        "  \"rack3\" : { \"in\" : [ \"temperature@TH5\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack3\" } ] },\n"
+        "  \"row\" : { \"in\" : [ \"average.temperature@rack1\", \"average.temperature@rack3\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@row1\" } ] }\n"
+        "} }\n", evaluators);
+    assert (composite_graph_reload (self, path, evaluators) == 0);
+    assert (composite_graph_size (self) == 4);
+    assert (streq (composite_evaluator_name (composite_graph_at (self, 3)), "room"));
+    assert (!composite_graph_update (self, "temperature@TH3", 40, now, now + 60));
+    outputs.clear ();
+    assert (composite_graph_update (self, "temperature@TH5", 50, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 3);
+    assert (s_find (outputs, "average.temperature@row1")->value == 37.5);    // rack1 kept 25
+    outputs.clear ();
+    assert (composite_graph_update (self, "temperature@TH1", 20, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 3);
+    assert (s_find (outputs, "average.temperature@rack1")->value == 30);     // TH2 kept 30
+
+    // a generation closing a cycle is refused as a whole
+    s_load_source (path,
+        "{ \"manifest\" : 1, \"generation\" : 3, \"composites\" : {\n"
+        "  \"row\" : { \"in\" : [ \"average.temperature@room1\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@row1\" } ] }\n"
+        "} }\n", evaluators);
+    assert (composite_graph_reload (self, path, evaluators) == -1);
+    assert (evaluators.size () == 1);
+    composite_evaluator_destroy (&evaluators [0]);
+    assert (composite_graph_size (self) == 4);
+    assert (composite_graph_produces (self, "average.temperature@rack3"));
+    unlink (path);
+    zstr_free (&path);
+    composite_graph_destroy (&self);
+
+    // periodic evaluation
+    self = composite_graph_new ();
+    assert (composite_graph_timeout (self, zclock_mono ()) == -1);
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "periodic",
+        "{ \"in\" : [ \"temperature@TH1\" ], \"evaluate_every_ms\" : 1000,\n"
+        "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack1\" } ] }\n");
+    int64_t mono = zclock_mono ();
+    assert (composite_graph_add (self, &evaluator) == 0);
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "downstream",
+        "{ \"in\" : [ \"average.temperature@rack1\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@row1\" } ] }\n");
+    assert (composite_graph_add (self, &evaluator) == 0);
+    int64_t timeout = composite_graph_timeout (self, mono);
+    assert (timeout >= 1000 && timeout < 1100);
+
+    // inputs only update the state
+    outputs.clear ();
+    assert (composite_graph_update (self, "temperature@TH1", 20, now, now + 60));
+    assert (composite_graph_update (self, "temperature@TH1", 30, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 0);
+    assert (composite_graph_tick (self, mono, now, 300, outputs, stats) == 0);
+    assert (outputs.empty ());
+
+    // period elapsed, downstream follows
+    assert (composite_graph_tick (self, mono + timeout, now, 300, outputs, stats) == 2);
+    assert (outputs.size () == 2);
+    assert (s_find (outputs, "average.temperature@rack1")->value == 30);
+    assert (s_find (outputs, "max.temperature@row1")->value == 30);
+    assert (composite_graph_timeout (self, mono + timeout) == 1000);
+    // missed periods are skipped
+    outputs.clear ();
+    assert (composite_graph_tick (self, mono + timeout + 5500, now, 300, outputs, stats) == 2);
+    assert (composite_graph_timeout (self, mono + timeout + 5500) == 500);
+    composite_graph_destroy (&self);
+
+    // split keeps connected evaluators together and balances the rest
+    self = composite_graph_new ();
+    const char *configs [][2] = {
+        {"a-rack", "{ \"in\" : [ \"temperature@A1\", \"temperature@A2\" ],\n"
+                   "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rackA\" } ] }\n"},
+        {"a-row",  "{ \"in\" : [ \"average.temperature@rackA\" ],\n"
+                   "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@rowA\" } ] }\n"},
+        {"b-rack", "{ \"in\" : [ \"temperature@B1\" ],\n"
+                   "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rackB\" } ] }\n"},
+        {"b-other","{ \"in\" : [ \"temperature@B1\" ],\n"
+                   "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@rackB\" } ] }\n"},
+        {"c-rack", "{ \"in\" : [ \"temperature@C1\" ],\n"
+                   "  \"reductions\" : [ { \"function\" : \"min\", \"topic\" : \"min.temperature@rackC\" } ] }\n"}
+    };
+    for (const auto &config : configs) {
+        evaluator = s_evaluator (SELFTEST_DIR_RW, config [0], config [1]);
+        assert (composite_graph_add (self, &evaluator) == 0);
+    }
+    std::vector <composite_graph_t *> graphs = composite_graph_split (self, 2);
+    assert (graphs.size () == 2);
+    assert (composite_graph_size (self) == 0);
+    assert (!composite_graph_update (self, "temperature@A1", 20, now, now + 60));
+    // a-* (load 5) alone, b-* (load 4) with c-rack (load 2)
+    assert (composite_graph_size (graphs [0]) == 2);
+    assert (composite_graph_size (graphs [1]) == 3);
+    assert (streq (composite_evaluator_name (composite_graph_at (graphs [0], 0)), "a-rack"));
+    assert (streq (composite_evaluator_name (composite_graph_at (graphs [0], 1)), "a-row"));
+    assert (composite_graph_update (graphs [0], "temperature@A1", 20, now, now + 60));
+    outputs.clear ();
+    assert (composite_graph_evaluate (graphs [0], now, 300, outputs, stats) == 2);
+    assert (s_find (outputs, "max.temperature@rowA")->value == 20);
+    assert (!composite_graph_update (graphs [1], "temperature@A1", 20, now, now + 60));
+    assert (composite_graph_update (graphs [1], "temperature@B1", 20, now, now + 60));
+
+    // join returns them, with the state
+    for (auto graph : graphs) {
+        assert (composite_graph_join (self, &graph) == 0);
+        assert (graph == NULL);
+    }
+    assert (composite_graph_size (self) == 5);
+    outputs.clear ();
+    assert (composite_graph_update (self, "temperature@A2", 30, now, now + 60));
+    assert (composite_graph_evaluate (self, now, 300, outputs, stats) == 2);
+    assert (s_find (outputs, "average.temperature@rackA")->value == 25);
+    composite_graph_destroy (&self);
+
+    // more graphs than components
+    self = composite_graph_new ();
+    evaluator = s_evaluator (SELFTEST_DIR_RW, "single", configs [4][1]);
+    assert (composite_graph_add (self, &evaluator) == 0);
+    graphs = composite_graph_split (self, 4);
+    assert (graphs.size () == 1);
+    composite_graph_destroy (&graphs [0]);
+    composite_graph_destroy (&self);
+    composite_stats_destroy (&stats);
+    //  @end
+    log_info (" * composite_graph: OK\n");
+}
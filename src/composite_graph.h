@@ -0,0 +1,125 @@
+/*  =========================================================================
+    composite_graph - composite evaluators of one host ordered as a DAG
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef COMPOSITE_GRAPH_H_INCLUDED
+#define COMPOSITE_GRAPH_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _composite_graph_t composite_graph_t;
+
+//  @interface
+//  Create a new empty graph
+FTY_METRIC_COMPOSITE_EXPORT composite_graph_t *
+    composite_graph_new (void);
+
+//  Add evaluator, the graph takes ownership of it and sets *evaluator_p to NULL.
+//  Returns -1 and leaves the evaluator with the caller if the declared outputs
+//  would make a cycle, 0 otherwise.
+FTY_METRIC_COMPOSITE_EXPORT int
+    composite_graph_add (composite_graph_t *self, composite_evaluator_t **evaluator_p);
+
+//  Replace the evaluator with the same name by the new one, which takes over last
+//  values of inputs both have (see composite_evaluator_retain) and the phase of
+//  periodic evaluation if the period did not change; the old one is destroyed.
+//  Without an evaluator of that name it is added. Takes ownership and sets
+//  *evaluator_p to NULL. Returns -1 and leaves the graph and the evaluator
+//  untouched if the result would have a cycle, 0 otherwise.
+FTY_METRIC_COMPOSITE_EXPORT int
+    composite_graph_replace (composite_graph_t *self, composite_evaluator_t **evaluator_p);
+
+//  Replace all evaluators loaded from 'source' (see composite_evaluator_source) by
+//  'evaluators' in one step: those with the name of an old one take over its last
+//  values of inputs and its phase as composite_graph_replace does, old ones without
+//  a successor are destroyed. Takes ownership and clears 'evaluators'. Returns -1
+//  and leaves the graph and 'evaluators' untouched if the result would have a cycle,
+//  0 otherwise.
+FTY_METRIC_COMPOSITE_EXPORT int
+    composite_graph_reload (composite_graph_t *self, const char *source, std::vector <composite_evaluator_t *> &evaluators);
+
+//  Get number of evaluators
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    composite_graph_size (composite_graph_t *self);
+
+//  Get evaluator at position 'index' of the topological order
+FTY_METRIC_COMPOSITE_EXPORT composite_evaluator_t *
+    composite_graph_at (composite_graph_t *self, size_t index);
+
+//  Return true if 'topic' is a declared output of some evaluator in the graph
+FTY_METRIC_COMPOSITE_EXPORT bool
+    composite_graph_produces (composite_graph_t *self, const std::string &topic);
+
+//  Store new value of an external input in all evaluators consuming it and
+//  mark those which are not periodic for evaluation. Returns false if no evaluator consumes 'topic'.
+FTY_METRIC_COMPOSITE_EXPORT bool
+    composite_graph_update (composite_graph_t *self, const std::string &topic, double value, time_t timestamp, time_t valid_till);
+
+//  Evaluate marked evaluators in topological order. Outputs are passed in memory
+//  to evaluators consuming them (valid for 'ttl' seconds from 'now') and all are
+//  appended to 'outputs'. Outcomes are counted in 'stats' if it is not NULL.
+//  Returns number of evaluations done.
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    composite_graph_evaluate (composite_graph_t *self, time_t now, time_t ttl, std::vector <composite_output_t> &outputs, composite_stats_t *stats);
+
+//  Evaluate periodic evaluators whose period elapsed at 'mono' (zclock_mono),
+//  together with evaluators consuming their outputs; see composite_graph_evaluate.
+//  Returns number of evaluations done.
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    composite_graph_tick (composite_graph_t *self, int64_t mono, time_t now, time_t ttl, std::vector <composite_output_t> &outputs, composite_stats_t *stats);
+
+//  Get milliseconds from 'mono' (zclock_mono) till the next periodic evaluation,
+//  -1 if there is no periodic evaluator
+FTY_METRIC_COMPOSITE_EXPORT int64_t
+    composite_graph_timeout (composite_graph_t *self, int64_t mono);
+
+//  Move all evaluators into at most 'count' new graphs, self is left empty.
+//  Evaluators sharing a topic (directly or through others) stay together, the
+//  groups are spread so that the graphs have about the same number of inputs
+//  and evaluators.
+//  The caller owns the returned graphs.
+FTY_METRIC_COMPOSITE_EXPORT std::vector <composite_graph_t *>
+    composite_graph_split (composite_graph_t *self, size_t count);
+
+//  Move all evaluators of 'other' into self and destroy 'other'. Returns -1 and
+//  leaves both untouched if the result would have a cycle, 0 otherwise.
+FTY_METRIC_COMPOSITE_EXPORT int
+    composite_graph_join (composite_graph_t *self, composite_graph_t **other_p);
+
+//  Destroy the composite_graph and all its evaluators
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_graph_destroy (composite_graph_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_graph_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
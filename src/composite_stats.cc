@@ -0,0 +1,483 @@
+/*  =========================================================================
+    composite_stats - runtime statistics of composite metrics evaluator
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    composite_stats - runtime statistics of composite metrics evaluator:
+                      per topic counters, error counters and latency
+                      histograms of decode, evaluate and publish.
+@discuss
+    Histograms are HDR-style log-linear: values below 32us have a bucket
+    each, above that every power of two is split into 16 buckets, so any
+    value is known with precision better than 1/16 of its magnitude while
+    the whole histogram is a fixed array of counters (no allocation when
+    recording).
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <map>
+#include <string>
+
+#define HISTOGRAM_SUB_BITS      4
+#define HISTOGRAM_SUB_COUNT     (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_LINEAR        (2 * HISTOGRAM_SUB_COUNT)
+#define HISTOGRAM_MAX_BIT       40      // ~12 days in microseconds, larger values are clamped
+#define HISTOGRAM_BUCKETS       (HISTOGRAM_LINEAR + (HISTOGRAM_MAX_BIT - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_COUNT)
+
+static const char *counter_names [COMPOSITE_STATS_COUNTERS] = {
+    "dropped",
+    "evaluations",
+    "lua_errors",
+    "lua_limits",
+    "lua_allocations",
+    "not_enough_data",
+    "shm_failures",
+    "ring_full"
+};
+
+static const char *histogram_names [COMPOSITE_STATS_HISTOGRAMS] = {
+    "decode_us",
+    "evaluate_us",
+    "publish_us"
+};
+
+static const char *gauge_names [COMPOSITE_STATS_GAUGES] = {
+    "lua_peak_kb"
+};
+
+typedef struct {
+    uint64_t buckets [HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    int64_t min;
+    int64_t max;
+} histogram_t;
+
+struct _composite_stats_t {
+    std::map <std::string, uint64_t> received;      // topic -> number of received messages
+    std::map <std::string, uint64_t> published;     // topic -> number of published metrics
+    uint64_t received_total;
+    uint64_t counters [COMPOSITE_STATS_COUNTERS];
+    histogram_t histograms [COMPOSITE_STATS_HISTOGRAMS];
+    uint64_t gauges [COMPOSITE_STATS_GAUGES];
+};
+
+//  --------------------------------------------------------------------------
+//  Histogram helpers
+
+static int
+s_bucket_index (uint64_t value)
+{
+    if (value < HISTOGRAM_LINEAR)
+        return (int) value;
+    int msb = 63 - __builtin_clzll (value);
+    if (msb >= HISTOGRAM_MAX_BIT)
+        return HISTOGRAM_BUCKETS - 1;
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    int sub = (int) ((value >> shift) & (HISTOGRAM_SUB_COUNT - 1));
+    return HISTOGRAM_LINEAR + (msb - HISTOGRAM_SUB_BITS - 1) * HISTOGRAM_SUB_COUNT + sub;
+}
+
+//  Middle of the range of values which fall into the bucket
+static int64_t
+s_bucket_value (int index)
+{
+    if (index < HISTOGRAM_LINEAR)
+        return index;
+    int msb = (index - HISTOGRAM_LINEAR) / HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_BITS + 1;
+    int sub = (index - HISTOGRAM_LINEAR) % HISTOGRAM_SUB_COUNT;
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    int64_t low = ((int64_t) (HISTOGRAM_SUB_COUNT + sub)) << shift;
+    return low + (((int64_t) 1 << shift) >> 1);
+}
+
+static int64_t
+s_histogram_quantile (histogram_t *histogram, double quantile)
+{
+    if (histogram->count == 0)
+        return 0;
+    if (quantile <= 0.0)
+        return histogram->min;
+    if (quantile >= 1.0)
+        return histogram->max;
+    uint64_t rank = (uint64_t) (quantile * (double) histogram->count);
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets [i];
+        if (seen >= rank) {
+            int64_t value = s_bucket_value (i);
+            // do not report more than was really seen
+            if (value > histogram->max)
+                value = histogram->max;
+            if (value < histogram->min)
+                value = histogram->min;
+            return value;
+        }
+    }
+    return histogram->max;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new empty statistics
+
+composite_stats_t *
+composite_stats_new (void)
+{
+    composite_stats_t *self = new composite_stats_t ();
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the composite_stats
+
+void
+composite_stats_destroy (composite_stats_t **self_p)
+{
+    if (!self_p)
+        return;
+    if (*self_p) {
+        delete *self_p;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Count message received for the topic
+
+void
+composite_stats_received (composite_stats_t *self, const char *topic)
+{
+    assert (self);
+    assert (topic);
+    self->received_total++;
+    self->received [topic]++;
+}
+
+//  --------------------------------------------------------------------------
+//  Count metric published for the topic
+
+void
+composite_stats_published (composite_stats_t *self, const char *topic)
+{
+    assert (self);
+    assert (topic);
+    self->published [topic]++;
+}
+
+//  --------------------------------------------------------------------------
+//  Increment the counter
+
+void
+composite_stats_count (composite_stats_t *self, composite_stats_counter_t counter)
+{
+    assert (self);
+    assert (counter < COMPOSITE_STATS_COUNTERS);
+    self->counters [counter]++;
+}
+
+//  --------------------------------------------------------------------------
+//  Add 'value' to the counter
+
+void
+composite_stats_add (composite_stats_t *self, composite_stats_counter_t counter, uint64_t value)
+{
+    assert (self);
+    assert (counter < COMPOSITE_STATS_COUNTERS);
+    self->counters [counter] += value;
+}
+
+//  --------------------------------------------------------------------------
+//  Get value of the counter
+
+uint64_t
+composite_stats_counter (composite_stats_t *self, composite_stats_counter_t counter)
+{
+    assert (self);
+    assert (counter < COMPOSITE_STATS_COUNTERS);
+    return self->counters [counter];
+}
+
+//  --------------------------------------------------------------------------
+//  Record duration (in microseconds) into the histogram
+
+void
+composite_stats_record (composite_stats_t *self, composite_stats_histogram_t which, int64_t usec)
+{
+    assert (self);
+    assert (which < COMPOSITE_STATS_HISTOGRAMS);
+    if (usec < 0)
+        usec = 0;
+    histogram_t *histogram = &self->histograms [which];
+    histogram->buckets [s_bucket_index ((uint64_t) usec)]++;
+    if (histogram->count == 0 || usec < histogram->min)
+        histogram->min = usec;
+    if (usec > histogram->max)
+        histogram->max = usec;
+    histogram->count++;
+    histogram->sum += (uint64_t) usec;
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of values recorded into the histogram
+
+uint64_t
+composite_stats_histogram_count (composite_stats_t *self, composite_stats_histogram_t which)
+{
+    assert (self);
+    assert (which < COMPOSITE_STATS_HISTOGRAMS);
+    return self->histograms [which].count;
+}
+
+//  --------------------------------------------------------------------------
+//  Get value at given quantile of the histogram in microseconds
+
+int64_t
+composite_stats_histogram_quantile (composite_stats_t *self, composite_stats_histogram_t which, double quantile)
+{
+    assert (self);
+    assert (which < COMPOSITE_STATS_HISTOGRAMS);
+    return s_histogram_quantile (&self->histograms [which], quantile);
+}
+
+//  --------------------------------------------------------------------------
+//  Raise the gauge to 'value' if it is larger
+
+void
+composite_stats_maximum (composite_stats_t *self, composite_stats_gauge_t gauge, uint64_t value)
+{
+    assert (self);
+    assert (gauge < COMPOSITE_STATS_GAUGES);
+    if (value > self->gauges [gauge])
+        self->gauges [gauge] = value;
+}
+
+//  --------------------------------------------------------------------------
+//  Get value of the gauge
+
+uint64_t
+composite_stats_gauge (composite_stats_t *self, composite_stats_gauge_t gauge)
+{
+    assert (self);
+    assert (gauge < COMPOSITE_STATS_GAUGES);
+    return self->gauges [gauge];
+}
+
+//  --------------------------------------------------------------------------
+//  Add all counts and histograms of 'other' to self, gauges take the larger value
+
+void
+composite_stats_merge (composite_stats_t *self, composite_stats_t *other)
+{
+    assert (self);
+    assert (other);
+    for (const auto &item : other->received)
+        self->received [item.first] += item.second;
+    for (const auto &item : other->published)
+        self->published [item.first] += item.second;
+    self->received_total += other->received_total;
+    for (int i = 0; i < COMPOSITE_STATS_COUNTERS; i++)
+        self->counters [i] += other->counters [i];
+    for (int i = 0; i < COMPOSITE_STATS_GAUGES; i++)
+        if (other->gauges [i] > self->gauges [i])
+            self->gauges [i] = other->gauges [i];
+    for (int i = 0; i < COMPOSITE_STATS_HISTOGRAMS; i++) {
+        histogram_t *histogram = &self->histograms [i];
+        histogram_t *added = &other->histograms [i];
+        if (added->count == 0)
+            continue;
+        for (int j = 0; j < HISTOGRAM_BUCKETS; j++)
+            histogram->buckets [j] += added->buckets [j];
+        if (histogram->count == 0 || added->min < histogram->min)
+            histogram->min = added->min;
+        if (added->max > histogram->max)
+            histogram->max = added->max;
+        histogram->count += added->count;
+        histogram->sum += added->sum;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Encode statistics as a message STATS/key1/value1/key2/value2/...
+
+zmsg_t *
+composite_stats_encode (composite_stats_t *self)
+{
+    assert (self);
+    zmsg_t *message = zmsg_new ();
+    if (!message)
+        return NULL;
+    zmsg_addstr (message, "STATS");
+
+    zmsg_addstr (message, "received");
+    zmsg_addstrf (message, "%" PRIu64, self->received_total);
+    for (const auto &item : self->received) {
+        zmsg_addstrf (message, "received.%s", item.first.c_str ());
+        zmsg_addstrf (message, "%" PRIu64, item.second);
+    }
+    for (const auto &item : self->published) {
+        zmsg_addstrf (message, "published.%s", item.first.c_str ());
+        zmsg_addstrf (message, "%" PRIu64, item.second);
+    }
+    for (int i = 0; i < COMPOSITE_STATS_COUNTERS; i++) {
+        zmsg_addstr (message, counter_names [i]);
+        zmsg_addstrf (message, "%" PRIu64, self->counters [i]);
+    }
+    for (int i = 0; i < COMPOSITE_STATS_GAUGES; i++) {
+        zmsg_addstr (message, gauge_names [i]);
+        zmsg_addstrf (message, "%" PRIu64, self->gauges [i]);
+    }
+
+    static const struct {
+        const char *name;
+        double quantile;
+    } quantiles [] = {
+        {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}
+    };
+    for (int i = 0; i < COMPOSITE_STATS_HISTOGRAMS; i++) {
+        histogram_t *histogram = &self->histograms [i];
+        zmsg_addstrf (message, "%s.count", histogram_names [i]);
+        zmsg_addstrf (message, "%" PRIu64, histogram->count);
+        zmsg_addstrf (message, "%s.min", histogram_names [i]);
+        zmsg_addstrf (message, "%" PRIi64, histogram->min);
+        zmsg_addstrf (message, "%s.mean", histogram_names [i]);
+        zmsg_addstrf (message, "%" PRIu64, histogram->count ? histogram->sum / histogram->count : 0);
+        for (const auto &q : quantiles) {
+            zmsg_addstrf (message, "%s.%s", histogram_names [i], q.name);
+            zmsg_addstrf (message, "%" PRIi64, s_histogram_quantile (histogram, q.quantile));
+        }
+        zmsg_addstrf (message, "%s.max", histogram_names [i]);
+        zmsg_addstrf (message, "%" PRIi64, histogram->max);
+    }
+    return message;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+composite_stats_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("composite-stats-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    // bucket boundaries are consistent
+    for (uint64_t v = 0; v < 1000000; v += 7) {
+        int index = s_bucket_index (v);
+        int64_t middle = s_bucket_value (index);
+        assert (index < HISTOGRAM_BUCKETS);
+        // error is at most 1/16 of the value
+        assert ((int64_t) v - middle <= (int64_t) (v / HISTOGRAM_SUB_COUNT) + 1);
+        assert (middle - (int64_t) v <= (int64_t) (v / HISTOGRAM_SUB_COUNT) + 1);
+    }
+
+    composite_stats_t *self = composite_stats_new ();
+    assert (self);
+
+    composite_stats_received (self, "temperature@TH1");
+    composite_stats_received (self, "temperature@TH1");
+    composite_stats_received (self, "temperature@TH2");
+    composite_stats_published (self, "average.temperature@world");
+    composite_stats_count (self, COMPOSITE_STATS_EVALUATIONS);
+    composite_stats_count (self, COMPOSITE_STATS_EVALUATIONS);
+    composite_stats_count (self, COMPOSITE_STATS_LUA_ERRORS);
+    assert (composite_stats_counter (self, COMPOSITE_STATS_EVALUATIONS) == 2);
+    assert (composite_stats_counter (self, COMPOSITE_STATS_LUA_ERRORS) == 1);
+    assert (composite_stats_counter (self, COMPOSITE_STATS_DROPPED) == 0);
+    composite_stats_add (self, COMPOSITE_STATS_LUA_ALLOCATIONS, 250);
+    composite_stats_add (self, COMPOSITE_STATS_LUA_ALLOCATIONS, 50);
+    assert (composite_stats_counter (self, COMPOSITE_STATS_LUA_ALLOCATIONS) == 300);
+
+    for (int i = 1; i <= 1000; i++)
+        composite_stats_record (self, COMPOSITE_STATS_EVALUATE, i);
+    assert (composite_stats_histogram_count (self, COMPOSITE_STATS_EVALUATE) == 1000);
+    assert (composite_stats_histogram_count (self, COMPOSITE_STATS_DECODE) == 0);
+    int64_t p50 = composite_stats_histogram_quantile (self, COMPOSITE_STATS_EVALUATE, 0.5);
+    assert (p50 >= 500 - 500 / 16 && p50 <= 500 + 500 / 16);
+    int64_t p99 = composite_stats_histogram_quantile (self, COMPOSITE_STATS_EVALUATE, 0.99);
+    assert (p99 >= 990 - 990 / 16 && p99 <= 1000);
+    assert (composite_stats_histogram_quantile (self, COMPOSITE_STATS_EVALUATE, 1.0) == 1000);
+    assert (composite_stats_histogram_quantile (self, COMPOSITE_STATS_EVALUATE, 0.0) == 1);
+
+    // merge adds everything of the other statistics
+    composite_stats_t *other = composite_stats_new ();
+    composite_stats_received (other, "temperature@TH1");
+    composite_stats_count (other, COMPOSITE_STATS_RING_FULL);
+    composite_stats_record (other, COMPOSITE_STATS_EVALUATE, 5000);
+    composite_stats_maximum (self, COMPOSITE_STATS_LUA_PEAK_KB, 64);
+    composite_stats_maximum (self, COMPOSITE_STATS_LUA_PEAK_KB, 16);
+    assert (composite_stats_gauge (self, COMPOSITE_STATS_LUA_PEAK_KB) == 64);
+    composite_stats_maximum (other, COMPOSITE_STATS_LUA_PEAK_KB, 128);
+    composite_stats_merge (self, other);
+    composite_stats_destroy (&other);
+    assert (composite_stats_counter (self, COMPOSITE_STATS_RING_FULL) == 1);
+    assert (composite_stats_gauge (self, COMPOSITE_STATS_LUA_PEAK_KB) == 128);
+    assert (composite_stats_counter (self, COMPOSITE_STATS_EVALUATIONS) == 2);
+    assert (composite_stats_histogram_count (self, COMPOSITE_STATS_EVALUATE) == 1001);
+    assert (composite_stats_histogram_quantile (self, COMPOSITE_STATS_EVALUATE, 1.0) == 5000);
+    assert (composite_stats_histogram_quantile (self, COMPOSITE_STATS_EVALUATE, 0.0) == 1);
+
+    zmsg_t *message = composite_stats_encode (self);
+    assert (message);
+    char *part = zmsg_popstr (message);
+    assert (streq (part, "STATS"));
+    zstr_free (&part);
+    assert (zmsg_size (message) % 2 == 0);
+    bool seen_topic = false;
+    char *key = zmsg_popstr (message);
+    while (key) {
+        char *value = zmsg_popstr (message);
+        assert (value);
+        if (streq (key, "received.temperature@TH1")) {
+            assert (streq (value, "3"));
+            seen_topic = true;
+        }
+        if (streq (key, "received"))
+            assert (streq (value, "4"));
+        if (streq (key, "evaluate_us.count"))
+            assert (streq (value, "1001"));
+        if (streq (key, "lua_peak_kb"))
+            assert (streq (value, "128"));
+        zstr_free (&value);
+        zstr_free (&key);
+        key = zmsg_popstr (message);
+    }
+    assert (seen_topic);
+    zmsg_destroy (&message);
+
+    composite_stats_destroy (&self);
+    assert (self == NULL);
+    //  @end
+    log_info (" * composite_stats: OK\n");
+}
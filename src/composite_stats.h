@@ -0,0 +1,127 @@
+/*  =========================================================================
+    composite_stats - runtime statistics of composite metrics evaluator
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef COMPOSITE_STATS_H_INCLUDED
+#define COMPOSITE_STATS_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _composite_stats_t composite_stats_t;
+
+//  Counters kept by the evaluator
+typedef enum {
+    COMPOSITE_STATS_DROPPED = 0,        // message for topic which is not in the cache
+    COMPOSITE_STATS_EVALUATIONS,        // evaluations run
+    COMPOSITE_STATS_LUA_ERRORS,         // errors from luaL_loadbuffer/lua_pcall
+    COMPOSITE_STATS_LUA_LIMITS,         // Lua code exceeded its instruction or memory limit
+    COMPOSITE_STATS_LUA_ALLOCATIONS,    // allocations of Lua states
+    COMPOSITE_STATS_NOT_ENOUGH_DATA,    // evaluation did not return a result
+    COMPOSITE_STATS_SHM_FAILURES,       // fty::shm::write_metric failed
+    COMPOSITE_STATS_RING_FULL,          // message lost, ring of the evaluating thread was full
+    COMPOSITE_STATS_COUNTERS            // sentinel
+} composite_stats_counter_t;
+
+//  Latency histograms kept by the evaluator
+typedef enum {
+    COMPOSITE_STATS_DECODE = 0,         // decode of incoming message
+    COMPOSITE_STATS_EVALUATE,           // evaluation of the composite
+    COMPOSITE_STATS_PUBLISH,            // publication of the results
+    COMPOSITE_STATS_HISTOGRAMS          // sentinel
+} composite_stats_histogram_t;
+
+//  Gauges kept by the evaluator, each keeps the largest value seen
+typedef enum {
+    COMPOSITE_STATS_LUA_PEAK_KB = 0,    // peak memory of one run of Lua code, in kB
+    COMPOSITE_STATS_GAUGES              // sentinel
+} composite_stats_gauge_t;
+
+//  @interface
+//  Create a new empty statistics
+FTY_METRIC_COMPOSITE_EXPORT composite_stats_t *
+    composite_stats_new (void);
+
+//  Count message received for the topic
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_received (composite_stats_t *self, const char *topic);
+
+//  Count metric published for the topic
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_published (composite_stats_t *self, const char *topic);
+
+//  Increment the counter
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_count (composite_stats_t *self, composite_stats_counter_t counter);
+
+//  Add 'value' to the counter
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_add (composite_stats_t *self, composite_stats_counter_t counter, uint64_t value);
+
+//  Get value of the counter
+FTY_METRIC_COMPOSITE_EXPORT uint64_t
+    composite_stats_counter (composite_stats_t *self, composite_stats_counter_t counter);
+
+//  Record duration (in microseconds) into the histogram
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_record (composite_stats_t *self, composite_stats_histogram_t histogram, int64_t usec);
+
+//  Get number of values recorded into the histogram
+FTY_METRIC_COMPOSITE_EXPORT uint64_t
+    composite_stats_histogram_count (composite_stats_t *self, composite_stats_histogram_t histogram);
+
+//  Get value at given quantile (0.0 - 1.0) of the histogram in microseconds;
+//  the value is exact up to 1/16 of its magnitude
+FTY_METRIC_COMPOSITE_EXPORT int64_t
+    composite_stats_histogram_quantile (composite_stats_t *self, composite_stats_histogram_t histogram, double quantile);
+
+//  Raise the gauge to 'value' if it is larger
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_maximum (composite_stats_t *self, composite_stats_gauge_t gauge, uint64_t value);
+
+//  Get value of the gauge
+FTY_METRIC_COMPOSITE_EXPORT uint64_t
+    composite_stats_gauge (composite_stats_t *self, composite_stats_gauge_t gauge);
+
+//  Add all counts and histograms of 'other' to self, gauges take the larger value
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_merge (composite_stats_t *self, composite_stats_t *other);
+
+//  Encode statistics as a message STATS/key1/value1/key2/value2/...
+//  The caller is responsible for destroying the return value when finished with it
+FTY_METRIC_COMPOSITE_EXPORT zmsg_t *
+    composite_stats_encode (composite_stats_t *self);
+
+//  Destroy the composite_stats
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_destroy (composite_stats_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    composite_stats_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
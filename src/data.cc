@@ -29,6 +29,7 @@
 */
 
 #include "fty_metric_composite_classes.h"
+#include "fty_metric_composite_trace.h"
 #include <set>
 #include <set>
 #include <string>
@@ -45,6 +46,7 @@ struct _data_t {
     std::set<std::string> produced_metrics; // list of metrics, that are now produced by composite_metric
     std::map <std::string, std::string> devmap;
     char* ipc_name;
+    size_t sensors_placed; // number of sensors assigned to a logical asset by the last reassignment
 };
 
 //  --------------------------------------------------------------------------
@@ -136,6 +138,8 @@ data_reassign_sensors (data_t *self, bool is_propagation_needed)
     zhashx_purge (self->last_configuration);
     // explicitly say, that we suppose, that no further reconfiguration is neened
     self->is_reconfig_needed = false;
+    self->sensors_placed = 0;
+    FTY_METRIC_COMPOSITE_TRACE1 (reassign_sensors, zhashx_size (self->all_assets));
 
     // go through every known sensor (if it is not sensor, skip it)
     zlistx_t *asset_names = data_asset_names (self);
@@ -199,6 +203,7 @@ data_reassign_sensors (data_t *self, bool is_propagation_needed)
         zlistx_t *already_assigned_sensors = s_get_assigned_sensors (self, logical_asset_name);
         // add sensor to the list
         zlistx_add_end (already_assigned_sensors, (void *) one_sensor);
+        self->sensors_placed++;
 
         if ( is_propagation_needed ) {
             // BIOS-2484: start - propagate sensor in physical topology
@@ -229,6 +234,7 @@ data_reassign_sensors (data_t *self, bool is_propagation_needed)
         one_sensor_name = (char *) zlistx_next (asset_names);
     }
     zlistx_destroy (&asset_names);
+    FTY_METRIC_COMPOSITE_TRACE2 (reassign_sensors_done, self->sensors_placed, self->is_reconfig_needed);
 }
 
 //  --------------------------------------------------------------------------
@@ -421,6 +427,7 @@ data_asset_store (data_t *self, fty_proto_t **message_p)
     const char *name = fty_proto_name (message);
     const char *operation = fty_proto_operation (message);
     log_debug ("Process message: op='%s', asset_name='%s'", operation, fty_proto_name (message));
+    FTY_METRIC_COMPOSITE_TRACE2 (asset_store, name, operation);
     const char *type = fty_proto_aux_string (message, "type", "");
 
     const char *subtype = fty_proto_aux_string (message, "subtype", "");
@@ -556,6 +563,27 @@ data_is_reconfig_needed (data_t *self)
     return self->is_reconfig_needed;
 }
 
+//  --------------------------------------------------------------------------
+//  Get number of known assets
+
+size_t
+data_asset_count (data_t *self)
+{
+    assert (self);
+    return zhashx_size (self->all_assets);
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of sensors placed to a logical asset by the last
+//  'data_reassign_sensors' call (propagated copies are not counted)
+
+size_t
+data_sensors_placed (data_t *self)
+{
+    assert (self);
+    return self->sensors_placed;
+}
+
 //  --------------------------------------------------------------------------
 //  Get asset names
 //  The caller is responsible for destroying the return value when finished with it.
@@ -81,6 +81,15 @@ FTY_METRIC_COMPOSITE_EXPORT void
 FTY_METRIC_COMPOSITE_EXPORT std::set <std::string>
     data_get_produced_metrics (data_t *self);
 
+//  Get number of known assets
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    data_asset_count (data_t *self);
+
+//  Get number of sensors placed to a logical asset by the last
+//  'data_reassign_sensors' call (propagated copies are not counted)
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    data_sensors_placed (data_t *self);
+
 //  Get asset names
 //  The caller is responsible for destroying the return value when finished with it
 FTY_METRIC_COMPOSITE_EXPORT zlistx_t *
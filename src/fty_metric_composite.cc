@@ -26,6 +26,16 @@
 @end
 */
 
+#include <getopt.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 #include "fty_metric_composite_classes.h"
 
 extern "C" {
@@ -38,22 +48,140 @@ extern "C" {
 #include <vector>
 #include <string>
 #include <map>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cxxtools/jsondeserializer.h>
 #include <cxxtools/directory.h>
 #include <fty_proto.h>
 
+void usage (const char *argv0) {
+    printf ("Syntax: %s [options] config [config ...]\n"
+            "  --stats-interval / -s  log own runtime statistics every N seconds (default 0 = never)\n"
+            "  --shm-poll / -p        read inputs from shm every N milliseconds instead of malamute\n"
+            "  --shards / -j          evaluate in N threads, receiving stays in one (default 1)\n"
+            "  --snapshot / -S        keep last values of inputs in this file and restore them on start\n"
+            "  --help / -h            this information\n"
+            "A config can be a manifest of many composites written by fty-metric-composite-configurator\n"
+            "SIGHUP reloads the configuration files without restarting\n",
+            argv0);
+}
+
+//  Log STATS/key1/value1/... reply of the actor, one line per statistic
+static void
+s_log_stats (zmsg_t *reply)
+{
+    char *key = zmsg_popstr (reply);
+    while (key) {
+        char *value = zmsg_popstr (reply);
+        log_info ("stats: %s = %s", key, value ? value : "");
+        zstr_free (&value);
+        zstr_free (&key);
+        key = zmsg_popstr (reply);
+    }
+}
+
+//  Tell systemd the agent is ready (service Type=notify), see sd_notify(3);
+//  the protocol is one datagram, so libsystemd is not needed
+static void
+s_notify_ready (void)
+{
+    const char *path = getenv ("NOTIFY_SOCKET");
+    if (!path || (path [0] != '/' && path [0] != '@'))
+        return;     // not started by systemd
+    struct sockaddr_un address;
+    size_t length = strlen (path);
+    if (length >= sizeof (address.sun_path))
+        return;
+    memset (&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    memcpy (address.sun_path, path, length);
+    if (address.sun_path [0] == '@')
+        address.sun_path [0] = 0;   // abstract namespace
+    int fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        log_error ("Cannot notify systemd: %s", strerror (errno));
+        return;
+    }
+    static const char ready [] = "READY=1";
+    if (sendto (fd, ready, sizeof (ready) - 1, 0, (struct sockaddr *) &address,
+                (socklen_t) (offsetof (struct sockaddr_un, sun_path) + length)) == -1)
+        log_error ("Cannot notify systemd: %s", strerror (errno));
+    close (fd);
+}
+
 int
 main (int argc, char** argv) {
 
+    int help = 0;
+    int stats_interval = 0;
+    int shm_poll = 0;
+    int shards = 1;
+    const char *snapshot = NULL;
+
+// Some systems define struct option with non-"const" "char *"
+#if defined(__GNUC__) || defined(__GNUG__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wwrite-strings"
+#endif
+    static const char *short_options = "hs:p:j:S:";
+    static struct option long_options[] =
+    {
+            {"help",            no_argument,        0,  'h'},
+            {"stats-interval",  required_argument,  0,  's'},
+            {"shm-poll",        required_argument,  0,  'p'},
+            {"shards",          required_argument,  0,  'j'},
+            {"snapshot",        required_argument,  0,  'S'},
+            {0,                 0,                  0,  0}
+    };
+#if defined(__GNUC__) || defined(__GNUG__)
+#pragma GCC diagnostic pop
+#endif
+
+    while (true) {
+
+        int option_index = 0;
+        int c = getopt_long (argc, argv, short_options, long_options, &option_index);
+        if (c == -1)
+            break;
+        switch (c) {
+            case 's':
+            {
+                stats_interval = atoi (optarg);
+                break;
+            }
+            case 'p':
+            {
+                shm_poll = atoi (optarg);
+                break;
+            }
+            case 'j':
+            {
+                shards = atoi (optarg);
+                break;
+            }
+            case 'S':
+            {
+                snapshot = optarg;
+                break;
+            }
+            case 'h':
+            default:
+            {
+                help = 1;
+                break;
+            }
+        }
+    }
+
     // Read configuration
-    if(argc < 2) {
-        printf("Syntax: %s config\n", argv[0]);
+    if (help || optind >= argc) {
+        usage (argv[0]);
         exit(0);
     }
+    const char *config = argv[optind];
 
-    char *tmp_arg = strdup(argv[1]);
+    char *tmp_arg = strdup(config);
     char *name;
     char *tmp_basename = tmp_arg;
     for (int tmp_i = 0; tmp_arg[tmp_i] != '\0'; tmp_i++) {
@@ -64,23 +192,101 @@ main (int argc, char** argv) {
         exit(1);
     }
 
+    // SIGHUP is blocked in all threads started from now on and read from a
+    // signalfd polled together with the actor, so none is lost between polls;
+    // one received during the start stays pending till the main loop
+    sigset_t hangup;
+    sigemptyset (&hangup);
+    sigaddset (&hangup, SIGHUP);
+    pthread_sigmask (SIG_BLOCK, &hangup, NULL);
+    int reload_fd = signalfd (-1, &hangup, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (reload_fd == -1)
+        log_warning ("signalfd () failed, SIGHUP will not reload: %s", strerror (errno));
+
     ManageFtyLog::setInstanceFtylog (name, LOG_CONFIG);
     zactor_t *cm_server = zactor_new (fty_metric_composite_server, (void*) name);
     free(name);
     free(tmp_arg);
     tmp_basename = NULL;
 
-    zstr_sendx (cm_server, "CONNECT", "ipc://@/malamute", NULL);
-    zclock_sleep (500);  // to settle down the things
-    zstr_sendx (cm_server, "CONFIG", argv[1], NULL);
+    if (shm_poll > 0)
+        zstr_sendx (cm_server, "SHM", std::to_string (shm_poll).c_str (), NULL);
+    else {
+        zstr_sendx (cm_server, "CONNECT", "ipc://@/malamute", NULL);
+        if (fty_metric_composite_server_wait (cm_server, "CONNECT") != 0) {
+            zactor_destroy (&cm_server);
+            exit (1);
+        }
+    }
+    if (shards > 1)
+        zstr_sendx (cm_server, "SHARDS", std::to_string (shards).c_str (), NULL);
+    if (snapshot)
+        zstr_sendx (cm_server, "SNAPSHOT", snapshot, NULL);
+    // composites of one process can consume outputs of each other
+    // a configuration which cannot be loaded fails the start, systemd restarts the agent
+    for (int i = optind; i < argc; i++) {
+        zstr_sendx (cm_server, "CONFIG", argv[i], NULL);
+        if (fty_metric_composite_server_wait (cm_server, "CONFIG") != 0) {
+            zactor_destroy (&cm_server);
+            exit (1);
+        }
+    }
+    s_notify_ready ();
 
     //  Accept and print any message back from server
     //  copy from src/malamute.c under MPL license
+    zmq_pollitem_t items [] = {
+        { zsock_resolve (cm_server), 0, ZMQ_POLLIN, 0 },
+        { NULL, reload_fd, ZMQ_POLLIN, 0 }
+    };
+    int64_t stats_due = zclock_mono () + stats_interval * 1000;
     while (true) {
-        char *message = zstr_recv (cm_server);
+        long timeout = -1;
+        if (stats_interval > 0)
+            timeout = (long) std::max ((int64_t) 0, stats_due - zclock_mono ());
+        int rv = zmq_poll (items, reload_fd == -1 ? 1 : 2, timeout);
+        if (rv == -1) {
+            puts ("interrupted");
+            break;
+        }
+        if (reload_fd != -1 && (items [1].revents & ZMQ_POLLIN)) {
+            // signals which came meanwhile are served by one reload
+            struct signalfd_siginfo info;
+            while (read (reload_fd, &info, sizeof (info)) == (ssize_t) sizeof (info))
+                ;
+            // files are loaded again, the actor swaps in those which load
+            log_info ("Reloading configuration");
+            for (int i = optind; i < argc; i++)
+                zstr_sendx (cm_server, "CONFIG", argv[i], NULL);
+        }
+        if (rv == 0) {
+            zstr_sendx (cm_server, "STATS", NULL);
+            stats_due = zclock_mono () + stats_interval * 1000;
+            continue;
+        }
+        if (!(items [0].revents & ZMQ_POLLIN))
+            continue;
+        zmsg_t *message = zmsg_recv (cm_server);
         if (message) {
-            puts (message);
-            free (message);
+            char *command = zmsg_popstr (message);
+            if (command && streq (command, "STATS"))
+                s_log_stats (message);
+            else
+            if (command && streq (command, "CONFIG")) {
+                char *status = zmsg_popstr (message);
+                char *reason = zmsg_popstr (message);
+                if (status && streq (status, "OK"))
+                    log_info ("Configuration reloaded");
+                else
+                    log_error ("Reload failed, previous configuration is kept: %s", reason ? reason : "");
+                zstr_free (&reason);
+                zstr_free (&status);
+            }
+            else
+            if (command)
+                puts (command);
+            zstr_free (&command);
+            zmsg_destroy (&message);
         }
         else {
             puts ("interrupted");
@@ -88,6 +294,8 @@ main (int argc, char** argv) {
         }
     }
 
+    if (reload_fd != -1)
+        close (reload_fd);
     zactor_destroy (&cm_server);
     return 0;
 }
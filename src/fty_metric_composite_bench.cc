@@ -0,0 +1,711 @@
+/*  =========================================================================
+    fty_metric_composite_bench - Benchmarks of composite metrics
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    fty_metric_composite_bench - Benchmarks of composite metrics
+@discuss
+    configurator benchmark builds synthetic topologies (see topology_generator)
+    of growing size, feeds them through data_asset_store, times
+    data_reassign_sensors and the whole regeneration in the configurator
+    actor with systemctl calls stubbed (DRY_RUN) and reports time and memory.
+    With --manifest the configurator writes one manifest instead of a file
+    per composite.
+
+    subscriptions benchmark compares one _METRICS_SENSOR pattern per input
+    with the consolidated patterns of subscription_patterns on an inproc
+    malamute broker: time to register the consumer and time to deliver
+    messages about all inputs, where the broker matches every message
+    against every pattern of the consumer.
+
+    decode benchmark compares fty_proto_decode followed by atof with
+    proto_metric_decode on a typical sensor metric.
+
+    evaluation benchmark times composite_evaluator_evaluate of typical
+    hand-written formulas, with the default instruction limit and without
+    it. Built against LuaJIT the count hook of the limit keeps the JIT
+    compiler off, so the two columns compare the interpreter with the JIT;
+    comparing with stock Lua means running the benchmark of both builds.
+    Formulas which can be written as "expression" are timed that way too.
+
+    reductions benchmark reduces the given numbers of aggregates of 2 to 20
+    inputs, a fifth of them expired, once aggregate by aggregate with the
+    scalar loop and once by one reduction_kernel_reduce_groups call, as the
+    evaluator of a configuration with groups does.
+
+    load benchmark writes the given numbers of configurations, half of them
+    average scripts of the configurator, half other Lua formulas, and times
+    composite_evaluator_load of the JSON files and of their compiled form
+    (composite_evaluator_compile), as agents started after a regeneration
+    do, together with the first evaluation, which compiles the Lua code
+    when it was not precompiled, and loading of all of them from one
+    manifest (composite_evaluator_load_source).
+@end
+*/
+
+#include <getopt.h>
+
+#include "fty_metric_composite_classes.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+
+static const char *AGENT_NAME = "fty-metric-composite-bench";
+
+void usage () {
+    puts ("fty-metric-composite-bench [options] benchmark\n"
+          "benchmarks:\n"
+          "  configurator           scaling of configurator with the size of inventory\n"
+          "  subscriptions          per input vs consolidated stream subscriptions\n"
+          "  decode                 full vs partial decoding of metric messages\n"
+          "  evaluation             Lua formulas with and without instruction limit\n"
+          "  reductions             scalar vs vectorized reductions of many small groups\n"
+          "  load                   loading JSON vs compiled configurations\n"
+          "options:\n"
+          "  --verbose / -v         verbose logging mode\n"
+          "  --sizes / -n           comma separated inventory sizes (default 100,1000,10000,100000),\n"
+          "                         number of inputs for subscriptions, of groups for reductions,\n"
+          "                         of configurations for load\n"
+          "  --propagation / -p     propagate sensors in topology\n"
+          "  --manifest / -m        configurator writes one manifest instead of a file per composite\n"
+          "  --help / -h            this information\n"
+          );
+}
+
+//  Get value in kB of 'key' (like "VmRSS:") from /proc/self/status, -1 if not known
+static long
+s_memory (const char *key)
+{
+    FILE *file = fopen ("/proc/self/status", "r");
+    if (!file)
+        return -1;
+    long result = -1;
+    char line [256];
+    while (fgets (line, sizeof (line), file)) {
+        if (strncmp (line, key, strlen (key)) == 0) {
+            result = atol (line + strlen (key));
+            break;
+        }
+    }
+    fclose (file);
+    return result;
+}
+
+//  Parse STATS/key1/value1/... reply of the configurator
+static std::map <std::string, std::string>
+s_stats (zactor_t *server)
+{
+    std::map <std::string, std::string> result;
+    zstr_sendx (server, "STATS", NULL);
+    zmsg_t *reply = zmsg_recv (server);
+    if (!reply)
+        return result;
+    char *key = zmsg_popstr (reply);
+    zstr_free (&key);   // STATS
+    key = zmsg_popstr (reply);
+    while (key) {
+        char *value = zmsg_popstr (reply);
+        result [key] = value ? value : "";
+        zstr_free (&value);
+        zstr_free (&key);
+        key = zmsg_popstr (reply);
+    }
+    zmsg_destroy (&reply);
+    return result;
+}
+
+static int
+s_bench_configurator (const std::vector <size_t> &sizes, bool propagation, bool manifest)
+{
+    char directory [] = "/tmp/fty-metric-composite-bench-XXXXXX";
+    if (!mkdtemp (directory)) {
+        log_error ("Cannot create temporary directory");
+        return EXIT_FAILURE;
+    }
+
+    printf ("%10s %10s %10s %12s %12s %12s %12s %12s %10s %10s %10s\n",
+            "assets", "sensors", "composites",
+            "store_ms", "reassign_ms", "remove_ms", "generate_ms", "regen_ms",
+            "data_kB", "rss_kB", "peak_kB");
+
+    for (size_t size : sizes) {
+        topology_generator_t *topology = topology_generator_new_for_size (size);
+        assert (topology);
+
+        // 1. data_asset_store and data_reassign_sensors in this thread
+        long rss_before = s_memory ("VmRSS:");
+        data_t *data = data_new ();
+        int64_t start = zclock_usecs ();
+        fty_proto_t *asset = topology_generator_next (topology);
+        while (asset) {
+            data_asset_store (data, &asset);
+            asset = topology_generator_next (topology);
+        }
+        int64_t store_us = zclock_usecs () - start;
+        long data_kb = s_memory ("VmRSS:") - rss_before;
+
+        start = zclock_usecs ();
+        data_reassign_sensors (data, propagation);
+        int64_t reassign_us = zclock_usecs () - start;
+        data_destroy (&data);
+
+        // 2. whole regeneration inside the configurator actor, without systemctl
+        zactor_t *server = zactor_new (fty_metric_composite_configurator_server, (void *) AGENT_NAME);
+        assert (server);
+        zstr_sendx (server, "CFG_DIRECTORY", directory, NULL);
+        zstr_sendx (server, "DRY_RUN", "true", NULL);
+        if (manifest)
+            zstr_sendx (server, "MANIFEST", "bench", NULL);
+        if (propagation)
+            zstr_sendx (server, "IS_PROPAGATION_NEEDED", "true", NULL);
+        topology_generator_reset (topology);
+        asset = topology_generator_next (topology);
+        while (asset) {
+            zmsg_t *message = fty_proto_encode (&asset);
+            zmsg_pushstr (message, "ASSET");
+            zmsg_send (&message, server);
+            asset = topology_generator_next (topology);
+        }
+        zstr_sendx (server, "REGENERATE", NULL);
+        std::map <std::string, std::string> stats = s_stats (server);
+        long rss = s_memory ("VmRSS:");
+        // second run removes what the first one generated
+        zstr_sendx (server, "REGENERATE", NULL);
+        std::map <std::string, std::string> stats_again = s_stats (server);
+        zactor_destroy (&server);
+
+        printf ("%10zu %10zu %10s %12.1f %12.1f %12s %12s %12s %10ld %10ld %10ld\n",
+                topology_generator_size (topology),
+                topology_generator_sensors (topology),
+                stats ["composites"].c_str (),
+                store_us / 1000.0,
+                reassign_us / 1000.0,
+                stats_again ["last_remove_ms"].c_str (),
+                stats ["last_generate_ms"].c_str (),
+                stats ["last_regenerate_ms"].c_str (),
+                data_kb,
+                rss,
+                s_memory ("VmHWM:"));
+        fflush (stdout);
+        topology_generator_destroy (&topology);
+    }
+
+    zdir_t *dir = zdir_new (directory, NULL);
+    if (dir) {
+        zdir_remove (dir, true);
+        zdir_destroy (&dir);
+    }
+    return EXIT_SUCCESS;
+}
+
+//  Register 'patterns' and deliver 'messages' metrics about 'topics' through
+//  an inproc broker, returns times of the registration and of the delivery in us
+static void
+s_subscribe_and_deliver (const std::vector <std::string> &topics, const std::vector <std::string> &patterns,
+                         size_t messages, int64_t &subscribe_us, int64_t &deliver_us)
+{
+    static const char *endpoint = "inproc://fty-metric-composite-bench-subscriptions";
+    zactor_t *broker = zactor_new (mlm_server, (void *) "Malamute");
+    zstr_sendx (broker, "BIND", endpoint, NULL);
+
+    mlm_client_t *producer = mlm_client_new ();
+    mlm_client_connect (producer, endpoint, 1000, "producer");
+    mlm_client_set_producer (producer, "_METRICS_SENSOR");
+
+    mlm_client_t *consumer = mlm_client_new ();
+    mlm_client_connect (consumer, endpoint, 1000, "consumer");
+    int64_t start = zclock_usecs ();
+    for (const auto &pattern : patterns)
+        mlm_client_set_consumer (consumer, "_METRICS_SENSOR", pattern.c_str ());
+    subscribe_us = zclock_usecs () - start;
+
+    start = zclock_usecs ();
+    for (size_t i = 0; i < messages; i++) {
+        const std::string &topic = topics [i % topics.size ()];
+        size_t at = topic.find ('@');
+        zmsg_t *message = fty_proto_encode_metric (
+            NULL, ::time (NULL), 300, topic.substr (0, at).c_str (), topic.substr (at + 1).c_str (), "21.5", "C");
+        mlm_client_send (producer, topic.c_str (), &message);
+    }
+    for (size_t i = 0; i < messages; i++) {
+        zmsg_t *message = mlm_client_recv (consumer);
+        if (!message)
+            break;
+        zmsg_destroy (&message);
+    }
+    deliver_us = zclock_usecs () - start;
+
+    mlm_client_destroy (&consumer);
+    mlm_client_destroy (&producer);
+    zactor_destroy (&broker);
+}
+
+static int
+s_bench_subscriptions (const std::vector <size_t> &sizes)
+{
+    static const size_t MESSAGES = 10000;
+
+    printf ("%10s %10s %12s %12s %12s %12s %12s\n",
+            "inputs", "patterns", "topic_sub_ms", "pattern_sub_ms",
+            "topic_msg_us", "pattern_msg_us", "speedup");
+
+    for (size_t size : sizes) {
+        std::vector <std::string> topics;
+        std::vector <std::string> per_topic;
+        for (size_t i = 0; i < size; i++) {
+            topics.push_back ("temperature@sensor-" + std::to_string (i));
+            per_topic.push_back ("^" + subscription_patterns_escape (topics.back ()) + "$");
+        }
+        std::vector <std::string> patterns = subscription_patterns_build (topics, SUBSCRIPTION_PATTERNS_MAX_LENGTH);
+
+        int64_t topic_sub_us, topic_deliver_us, pattern_sub_us, pattern_deliver_us;
+        s_subscribe_and_deliver (topics, per_topic, MESSAGES, topic_sub_us, topic_deliver_us);
+        s_subscribe_and_deliver (topics, patterns, MESSAGES, pattern_sub_us, pattern_deliver_us);
+
+        printf ("%10zu %10zu %12.1f %12.1f %12.2f %12.2f %12.1f\n",
+                size, patterns.size (),
+                topic_sub_us / 1000.0, pattern_sub_us / 1000.0,
+                (double) topic_deliver_us / MESSAGES, (double) pattern_deliver_us / MESSAGES,
+                pattern_deliver_us > 0 ? (double) topic_deliver_us / pattern_deliver_us : 0.0);
+        fflush (stdout);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int
+s_bench_decode (void)
+{
+    static const size_t ROUNDS = 1000000;
+
+    fty_proto_t *metric = fty_proto_new (FTY_PROTO_METRIC);
+    fty_proto_aux_insert (metric, "port", "%s", "1");
+    fty_proto_aux_insert (metric, "sname", "%s", "sensor-0012");
+    fty_proto_set_time (metric, ::time (NULL));
+    fty_proto_set_ttl (metric, 300);
+    fty_proto_set_type (metric, "%s", "temperature");
+    fty_proto_set_name (metric, "%s", "sensor-0012");
+    fty_proto_set_value (metric, "%s", "21.37");
+    fty_proto_set_unit (metric, "%s", "C");
+    zmsg_t *message = fty_proto_encode (&metric);
+    assert (message);
+
+    // both paths consume their own copy of the message as the server does
+    volatile double sink = 0;
+    int64_t start = zclock_usecs ();
+    for (size_t i = 0; i < ROUNDS; i++) {
+        zmsg_t *copy = zmsg_dup (message);
+        fty_proto_t *decoded = fty_proto_decode (&copy);
+        sink = atof (fty_proto_value (decoded)) + fty_proto_ttl (decoded) + fty_proto_time (decoded);
+        fty_proto_destroy (&decoded);
+    }
+    int64_t full_us = zclock_usecs () - start;
+
+    start = zclock_usecs ();
+    for (size_t i = 0; i < ROUNDS; i++) {
+        zmsg_t *copy = zmsg_dup (message);
+        proto_metric_values_t values;
+        int rv = proto_metric_decode (copy, &values);
+        assert (rv == 0);
+        sink = values.value + values.ttl + values.time;
+        zmsg_destroy (&copy);
+    }
+    int64_t partial_us = zclock_usecs () - start;
+    zmsg_destroy (&message);
+    (void) sink;
+
+    printf ("%10s %12s %12s %12s\n", "messages", "full_ns", "partial_ns", "speedup");
+    printf ("%10zu %12.1f %12.1f %12.1f\n", ROUNDS,
+            full_us * 1000.0 / ROUNDS, partial_us * 1000.0 / ROUNDS,
+            partial_us > 0 ? (double) full_us / partial_us : 0.0);
+    return EXIT_SUCCESS;
+}
+
+//  Time one evaluation of the configuration in 'path' in microseconds
+static double
+s_evaluation_us (const char *path, const std::vector <std::string> &inputs, size_t rounds)
+{
+    composite_evaluator_t *evaluator = composite_evaluator_new ("bench");
+    if (composite_evaluator_load (evaluator, path) != 0) {
+        composite_evaluator_destroy (&evaluator);
+        return -1;
+    }
+    time_t now = ::time (NULL);
+    for (size_t i = 0; i < inputs.size (); i++)
+        composite_evaluator_update (evaluator, inputs [i], 20.0 + i % 10, now, now + 3600);
+    std::vector <composite_output_t> outputs;
+    int64_t start = zclock_usecs ();
+    for (size_t i = 0; i < rounds; i++) {
+        composite_evaluator_update (evaluator, inputs [i % inputs.size ()], 20.0 + i % 7, now, now + 3600);
+        outputs.clear ();
+        composite_evaluator_evaluate (evaluator, now, outputs);
+    }
+    double result = (double) (zclock_usecs () - start) / rounds;
+    composite_evaluator_destroy (&evaluator);
+    return result;
+}
+
+static int
+s_bench_evaluation (void)
+{
+    static const size_t ROUNDS = 20000;
+    char directory [] = "/tmp/fty-metric-composite-bench-XXXXXX";
+    if (!mkdtemp (directory)) {
+        log_error ("Cannot create temporary directory");
+        return EXIT_FAILURE;
+    }
+
+    struct {
+        const char *name;
+        std::vector <std::string> inputs;
+        const char *code;
+        std::string formula;        // the same as "expression", empty if it cannot be written so
+    } scripts [] = {
+        {"pue", {"realpower@ups-1", "realpower@ups-2", "realpower@epdu-1", "realpower@epdu-2"},
+            "it = mt['realpower@epdu-1'] + mt['realpower@epdu-2'];"
+            " total = mt['realpower@ups-1'] + mt['realpower@ups-2'];"
+            " return 'pue@datacenter', total / it, '';",
+            "(mt['realpower@ups-1'] + mt['realpower@ups-2']) / (mt['realpower@epdu-1'] + mt['realpower@epdu-2'])"},
+        {"dewpoint", {"temperature@TH1", "humidity@TH1"},
+            "t = mt['temperature@TH1']; rh = mt['humidity@TH1'];"
+            " g = math.log (rh / 100) + 17.62 * t / (243.12 + t);"
+            " return 'dewpoint@TH1', 243.12 * g / (17.62 - g), 'C';",
+            "243.12 * (log (mt['humidity@TH1'] / 100) + 17.62 * mt['temperature@TH1'] / (243.12 + mt['temperature@TH1']))"
+            " / (17.62 - (log (mt['humidity@TH1'] / 100) + 17.62 * mt['temperature@TH1'] / (243.12 + mt['temperature@TH1'])))"},
+        {"average-100", {}, NULL, ""},
+        {"polynomial", {"realpower@ups-1"},
+            "x = mt['realpower@ups-1']; s = 0;"
+            " for i = 1, 2000 do s = s + (x * i) % 7; end;"
+            " return 'load@ups-1', s, '';",
+            ""}
+    };
+    for (int i = 0; i < 100; i++)
+        scripts [2].inputs.push_back ("temperature@sensor-" + std::to_string (i));
+    scripts [2].code =
+        "sum = 0; num = 0; for key, value in pairs (mt) do sum = sum + value; num = num + 1; end;"
+        " return 'average.temperature@row', sum / num, 'C';";
+    scripts [2].formula = "avg (";
+    for (const auto &input : scripts [2].inputs)
+        scripts [2].formula += (input == scripts [2].inputs [0] ? "mt['" : ", mt['") + input + "']";
+    scripts [2].formula += ")";
+
+    printf ("%s\n", composite_evaluator_lua_version ());
+    printf ("%-12s %8s %14s %14s %14s\n", "script", "inputs", "limited_us", "unlimited_us", "expression_us");
+    for (const auto &script : scripts) {
+        double results [3] = {0, 0, -1};
+        for (int unlimited = 0; unlimited < 2; unlimited++) {
+            std::string inputs;
+            for (const auto &input : script.inputs)
+                inputs += (inputs.empty () ? "\"" : ", \"") + input + "\"";
+            std::string path = std::string (directory) + "/" + script.name + ".cfg";
+            FILE *file = fopen (path.c_str (), "w");
+            if (!file)
+                return EXIT_FAILURE;
+            fprintf (file, "{ \"in\" : [ %s ],%s \"evaluation\" : \"%s\" }\n",
+                     inputs.c_str (), unlimited ? " \"limits\" : { \"instructions\" : 0 }," : "", script.code);
+            fclose (file);
+            results [unlimited] = s_evaluation_us (path.c_str (), script.inputs, ROUNDS);
+            unlink (path.c_str ());
+        }
+        if (!script.formula.empty ()) {
+            std::string path = std::string (directory) + "/" + script.name + "-expression.cfg";
+            FILE *file = fopen (path.c_str (), "w");
+            if (!file)
+                return EXIT_FAILURE;
+            fprintf (file, "{ \"expression\" : { \"formula\" : \"%s\", \"topic\" : \"%s@bench\" } }\n",
+                     script.formula.c_str (), script.name);
+            fclose (file);
+            results [2] = s_evaluation_us (path.c_str (), script.inputs, ROUNDS);
+            unlink (path.c_str ());
+        }
+        printf ("%-12s %8zu %14.2f %14.2f %14.2f\n", script.name, script.inputs.size (), results [0], results [1], results [2]);
+        fflush (stdout);
+    }
+    rmdir (directory);
+    return EXIT_SUCCESS;
+}
+
+//  Load configurations 'paths' and evaluate each once, returns microseconds per configuration
+static double
+s_load_us (const std::vector <std::string> &paths)
+{
+    time_t now = ::time (NULL);
+    std::vector <composite_output_t> outputs;
+    int64_t start = zclock_usecs ();
+    for (const auto &path : paths) {
+        composite_evaluator_t *evaluator = composite_evaluator_new (path.c_str ());
+        if (composite_evaluator_load (evaluator, path.c_str ()) != 0) {
+            composite_evaluator_destroy (&evaluator);
+            return -1;
+        }
+        for (const auto &input : composite_evaluator_inputs (evaluator))
+            composite_evaluator_update (evaluator, input, 21.5, now, now + 3600);
+        outputs.clear ();
+        composite_evaluator_evaluate (evaluator, now, outputs);
+        composite_evaluator_destroy (&evaluator);
+    }
+    return (double) (zclock_usecs () - start) / paths.size ();
+}
+
+//  Load all configurations of manifest 'path' and evaluate each once, returns
+//  microseconds per configuration
+static double
+s_load_manifest_us (const std::string &path)
+{
+    time_t now = ::time (NULL);
+    std::vector <composite_output_t> outputs;
+    std::vector <composite_evaluator_t *> evaluators;
+    int64_t start = zclock_usecs ();
+    if (composite_evaluator_load_source (path.c_str (), evaluators) != 0 || evaluators.empty ())
+        return -1;
+    for (auto evaluator : evaluators) {
+        for (const auto &input : composite_evaluator_inputs (evaluator))
+            composite_evaluator_update (evaluator, input, 21.5, now, now + 3600);
+        outputs.clear ();
+        composite_evaluator_evaluate (evaluator, now, outputs);
+    }
+    double result = (double) (zclock_usecs () - start) / evaluators.size ();
+    for (auto &evaluator : evaluators)
+        composite_evaluator_destroy (&evaluator);
+    return result;
+}
+
+static int
+s_bench_load (const std::vector <size_t> &sizes)
+{
+    char directory [] = "/tmp/fty-metric-composite-bench-XXXXXX";
+    if (!mkdtemp (directory)) {
+        log_error ("Cannot create temporary directory");
+        return EXIT_FAILURE;
+    }
+    printf ("%s\n", composite_evaluator_lua_version ());
+    printf ("%10s %12s %12s %14s %14s %10s %14s\n", "configs", "json_bytes", "compiled", "json_us", "compiled_us", "speedup", "manifest_us");
+    for (size_t size : sizes) {
+        std::vector <std::string> sources, compiled;
+        size_t json_bytes = 0, compiled_bytes = 0;
+        std::string manifest = "{ \"manifest\" : 1, \"generation\" : 1, \"composites\" : {\n";
+        for (size_t i = 0; i < size; i++) {
+            std::string rack = "rack-" + std::to_string (i);
+            std::string inputs, offsets;
+            for (int port = 1; port <= 4; port++) {
+                std::string topic = "temperature.TH" + std::to_string (port) + "@" + rack;
+                inputs += (port == 1 ? "\"" : ", \"") + topic + "\"";
+                offsets += "    offsets['" + topic + "'] = " + std::to_string (port % 3) + ".0;\n";
+            }
+            std::string contents = "{\n\"in\" : [ " + inputs + " ],\n\"evaluation\": \"\n";
+            if (i % 2 == 0)
+                contents += "    offsets = {};\n" + offsets +
+                    "    sum = 0;\n    num = 0;\n    for key,value in pairs(mt) do\n"
+                    "        sum = sum + value + offsets[key];\n        num = num + 1;\n    end;\n"
+                    "    if num == 0 then error('all sensors lost'); end;\n    tmp = sum / num;\n"
+                    "    return 'average.temperature@" + rack + "', tmp, 'C', 0;\"\n}\n";
+            else
+                contents += "    hi = -1000; lo = 1000;\n    for key,value in pairs(mt) do\n"
+                    "        if value > hi then hi = value; end;\n        if value < lo then lo = value; end;\n    end;\n"
+                    "    return 'spread.temperature@" + rack + "', hi - lo, 'C';\"\n}\n";
+            std::string path = std::string (directory) + "/" + rack + ".cfg";
+            FILE *file = fopen (path.c_str (), "w");
+            if (!file)
+                return EXIT_FAILURE;
+            fputs (contents.c_str (), file);
+            fclose (file);
+            json_bytes += contents.size ();
+            manifest += (i == 0 ? "\"" : ",\n\"") + rack + "\" : " + contents;
+            sources.push_back (path);
+            std::string binary = std::string (directory) + "/" + rack + ".bin";
+            if (composite_evaluator_compile (path.c_str (), binary.c_str ()) != 0)
+                return EXIT_FAILURE;
+            compiled_bytes += zsys_file_size (binary.c_str ());
+            compiled.push_back (binary);
+        }
+        manifest += "} }\n";
+        std::string manifest_path = std::string (directory) + "/manifest.cfg";
+        FILE *file = fopen (manifest_path.c_str (), "w");
+        if (!file)
+            return EXIT_FAILURE;
+        fputs (manifest.c_str (), file);
+        fclose (file);
+        double json_us = s_load_us (sources);
+        double compiled_us = s_load_us (compiled);
+        double manifest_us = s_load_manifest_us (manifest_path);
+        printf ("%10zu %12zu %12zu %14.2f %14.2f %9.2fx %14.2f\n", size, json_bytes / size, compiled_bytes / size,
+                json_us, compiled_us, json_us / compiled_us, manifest_us);
+        fflush (stdout);
+        for (size_t i = 0; i < size; i++) {
+            unlink (sources [i].c_str ());
+            unlink (compiled [i].c_str ());
+        }
+        unlink (manifest_path.c_str ());
+    }
+    rmdir (directory);
+    return EXIT_SUCCESS;
+}
+
+static int
+s_bench_reductions (const std::vector <size_t> &sizes)
+{
+    // about this many inputs are reduced per measurement
+    static const size_t WORK = 20000000;
+    printf ("lanes: %zu\n", reduction_kernel_lanes ());
+    printf ("%10s %10s %16s %16s %8s\n", "groups", "inputs", "scalar_ns/group", "vector_ns/group", "speedup");
+    srand (42);
+    time_t now = 1000;
+    for (size_t size : sizes) {
+        std::vector <size_t> bounds (1, 0);
+        for (size_t g = 0; g < size; g++)
+            bounds.push_back (bounds.back () + 2 + rand () % 19);
+        size_t inputs = bounds.back ();
+        std::vector <double> values (inputs), offsets (inputs);
+        std::vector <time_t> valid_till (inputs);
+        for (size_t i = 0; i < inputs; i++) {
+            values [i] = 15 + (rand () % 2000) / 100.0;
+            offsets [i] = (rand () % 5 == 0) ? (rand () % 100) / 100.0 - 0.5 : 0;
+            valid_till [i] = (rand () % 5 == 0) ? now - 1 : now + 60;
+        }
+        std::vector <size_t> groups (size);
+        for (size_t g = 0; g < size; g++)
+            groups [g] = g;
+        std::vector <reduction_stats_t> scalar (size), batched (size);
+        size_t rounds = std::max ((size_t) 1, WORK / inputs);
+
+        int64_t start = zclock_usecs ();
+        for (size_t round = 0; round < rounds; round++) {
+            for (size_t g = 0; g < size; g++)
+                reduction_kernel_reduce_scalar (values.data (), offsets.data (), valid_till.data (),
+                                                bounds [g], bounds [g + 1], now, &scalar [g]);
+        }
+        int64_t scalar_us = zclock_usecs () - start;
+
+        start = zclock_usecs ();
+        for (size_t round = 0; round < rounds; round++)
+            reduction_kernel_reduce_groups (values.data (), offsets.data (), valid_till.data (),
+                                            bounds.data (), groups.data (), size, now, batched.data ());
+        int64_t vector_us = zclock_usecs () - start;
+
+        for (size_t g = 0; g < size; g++) {
+            if (scalar [g].count != batched [g].count
+            ||  scalar [g].min != batched [g].min
+            ||  scalar [g].max != batched [g].max
+            ||  fabs (scalar [g].sum - batched [g].sum) > 1e-9 * (1 + fabs (scalar [g].sum))) {
+                log_error ("Results of group %zu differ", g);
+                return EXIT_FAILURE;
+            }
+        }
+        double groups_done = (double) size * rounds;
+        printf ("%10zu %10zu %16.1f %16.1f %8.2f\n", size, inputs,
+                scalar_us * 1000.0 / groups_done, vector_us * 1000.0 / groups_done,
+                vector_us > 0 ? (double) scalar_us / vector_us : 0.0);
+        fflush (stdout);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main (int argc, char *argv [])
+{
+    int help = 0;
+    bool verbose = false;
+    bool propagation = false;
+    bool manifest = false;
+    std::vector <size_t> sizes = {100, 1000, 10000, 100000};
+
+// Some systems define struct option with non-"const" "char *"
+#if defined(__GNUC__) || defined(__GNUG__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wwrite-strings"
+#endif
+    static const char *short_options = "hvn:pm";
+    static struct option long_options[] =
+    {
+            {"help",            no_argument,        0,  'h'},
+            {"verbose",         no_argument,        0,  'v'},
+            {"sizes",           required_argument,  0,  'n'},
+            {"propagation",     no_argument,        0,  'p'},
+            {"manifest",        no_argument,        0,  'm'},
+            {0,                 0,                  0,  0}
+    };
+#if defined(__GNUC__) || defined(__GNUG__)
+#pragma GCC diagnostic pop
+#endif
+
+    while (true) {
+
+        int option_index = 0;
+        int c = getopt_long (argc, argv, short_options, long_options, &option_index);
+        if (c == -1)
+            break;
+        switch (c) {
+            case 'v':
+            {
+                verbose = true;
+                break;
+            }
+            case 'n':
+            {
+                sizes.clear ();
+                for (char *item = strtok (optarg, ","); item; item = strtok (NULL, ","))
+                    sizes.push_back ((size_t) atol (item));
+                break;
+            }
+            case 'p':
+            {
+                propagation = true;
+                break;
+            }
+            case 'm':
+            {
+                manifest = true;
+                break;
+            }
+            case 'h':
+            default:
+            {
+                help = 1;
+                break;
+            }
+        }
+    }
+    if (help || optind >= argc) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    ManageFtyLog::setInstanceFtylog (AGENT_NAME, LOG_CONFIG);
+    if (verbose)
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+
+    const char *benchmark = argv [optind];
+    if (streq (benchmark, "configurator"))
+        return s_bench_configurator (sizes, propagation, manifest);
+    if (streq (benchmark, "subscriptions"))
+        return s_bench_subscriptions (sizes);
+    if (streq (benchmark, "decode"))
+        return s_bench_decode ();
+    if (streq (benchmark, "evaluation"))
+        return s_bench_evaluation ();
+    if (streq (benchmark, "reductions"))
+        return s_bench_reductions (sizes);
+    if (streq (benchmark, "load"))
+        return s_bench_load (sizes);
+
+    usage ();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,368 @@
+/*  =========================================================================
+    fty_metric_composite_capture - Stream capture and replay tool
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    fty_metric_composite_capture - Stream capture and replay tool
+@discuss
+    'record' subscribes to malamute streams (by default ASSETS and
+    _METRICS_SENSOR) and stores every delivered message with its timestamp
+    into a capture file (see stream_capture).
+
+    'replay' publishes the captured messages again with original timing
+    scaled by --speed (0 means as fast as possible). Metrics keep their
+    captured time, so those older than their ttl arrive expired and are not
+    evaluated; --retime shifts the time of metrics by how much later they are
+    replayed than captured. Without --endpoint it
+    starts its own inproc broker and, on request, the configurator and
+    evaluator actors, so incidents can be reproduced locally. At the end
+    it prints throughput and STATS of the actors.
+@end
+*/
+
+#include <getopt.h>
+
+#include "fty_metric_composite_classes.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+static const char *ENDPOINT = "ipc://@/malamute";
+static const char *REPLAY_ENDPOINT = "inproc://fty-metric-composite-replay";
+
+void usage () {
+    puts ("fty-metric-composite-capture [options] record|replay\n"
+          "  --verbose / -v         verbose logging mode\n"
+          "  --file / -f            capture file (mandatory)\n"
+          "  --endpoint / -e        malamute endpoint (record: default ipc://@/malamute,\n"
+          "                         replay: default own inproc broker)\n"
+          "record options:\n"
+          "  --stream / -s          stream to record, can be repeated (default ASSETS and _METRICS_SENSOR)\n"
+          "  --pattern / -p         subject pattern (default .*)\n"
+          "  --duration / -d        stop after N seconds (default 0 = until interrupted)\n"
+          "replay options:\n"
+          "  --speed / -x           replay speed, 1 = original timing, 0 = as fast as possible (default 1)\n"
+          "  --retime / -r          shift time of metrics to the replay time, otherwise metrics captured\n"
+          "                         longer ago than their ttl arrive expired and are not evaluated\n"
+          "  --configurator / -c    run configurator (without systemctl) writing to given directory\n"
+          "  --composite / -m       run evaluator with given configuration file, can be repeated\n"
+          "  --settle / -t          ms to wait for actors to process everything (default 1000)\n"
+          "  --help / -h            this information\n"
+          );
+}
+
+//  Print STATS reply of the actor, one statistic per line
+static void
+s_print_stats (const char *name, zactor_t *actor)
+{
+    zstr_sendx (actor, "STATS", NULL);
+    zsock_set_rcvtimeo (actor, 5000);
+    zmsg_t *reply = zmsg_recv (actor);
+    if (!reply) {
+        printf ("%s: no STATS reply\n", name);
+        return;
+    }
+    char *key = zmsg_popstr (reply);
+    zstr_free (&key);   // STATS
+    key = zmsg_popstr (reply);
+    while (key) {
+        char *value = zmsg_popstr (reply);
+        printf ("%s: %s = %s\n", name, key, value ? value : "");
+        zstr_free (&value);
+        zstr_free (&key);
+        key = zmsg_popstr (reply);
+    }
+    zmsg_destroy (&reply);
+}
+
+static int
+s_record (const char *file, const char *endpoint, const std::vector <std::string> &streams, const char *pattern, int duration)
+{
+    stream_capture_t *capture = stream_capture_new (file, true);
+    if (!capture)
+        return EXIT_FAILURE;
+
+    char *name = zsys_sprintf ("fty-metric-composite-capture-%d", (int) getpid ());
+    mlm_client_t *client = mlm_client_new ();
+    if (mlm_client_connect (client, endpoint, 1000, name) == -1) {
+        log_error ("mlm_client_connect (endpoint = '%s') failed", endpoint);
+        mlm_client_destroy (&client);
+        stream_capture_destroy (&capture);
+        zstr_free (&name);
+        return EXIT_FAILURE;
+    }
+    zstr_free (&name);
+    for (const auto &stream : streams) {
+        if (mlm_client_set_consumer (client, stream.c_str (), pattern) == -1)
+            log_error ("mlm_client_set_consumer (stream = '%s', pattern = '%s') failed", stream.c_str (), pattern);
+    }
+
+    zpoller_t *poller = zpoller_new (mlm_client_msgpipe (client), NULL);
+    int64_t until = duration > 0 ? zclock_mono () + duration * 1000 : -1;
+    while (!zsys_interrupted) {
+        if (until >= 0 && zclock_mono () >= until)
+            break;
+        void *which = zpoller_wait (poller, 1000);
+        if (!which)
+            continue;
+        zmsg_t *message = mlm_client_recv (client);
+        if (!message)
+            continue;
+        if (streq (mlm_client_command (client), "STREAM DELIVER")) {
+            if (stream_capture_write (capture, zclock_usecs (), mlm_client_address (client), mlm_client_subject (client), message) != 0) {
+                log_error ("Writing to capture file '%s' failed", file);
+                zmsg_destroy (&message);
+                break;
+            }
+        }
+        zmsg_destroy (&message);
+    }
+    log_info ("Recorded %" PRIu64 " messages to '%s'", stream_capture_count (capture), file);
+    zpoller_destroy (&poller);
+    mlm_client_destroy (&client);
+    stream_capture_destroy (&capture);
+    return EXIT_SUCCESS;
+}
+
+//  Shift time of a metric by 'shift' seconds, other messages are left alone
+static void
+s_retime (zmsg_t **content_p, int64_t shift)
+{
+    if (!fty_proto_is (*content_p))
+        return;
+    fty_proto_t *proto = fty_proto_decode (content_p);
+    if (!proto)
+        return;
+    if (fty_proto_id (proto) == FTY_PROTO_METRIC)
+        fty_proto_set_time (proto, (uint64_t) ((int64_t) fty_proto_time (proto) + shift));
+    *content_p = fty_proto_encode (&proto);
+}
+
+static int
+s_replay (const char *file, const char *endpoint, double speed, bool retime, const char *configurator_dir,
+          const std::vector <std::string> &composites, int settle)
+{
+    stream_capture_t *capture = stream_capture_new (file, false);
+    if (!capture)
+        return EXIT_FAILURE;
+
+    zactor_t *broker = NULL;
+    if (!endpoint) {
+        endpoint = REPLAY_ENDPOINT;
+        broker = zactor_new (mlm_server, (void *) "Malamute");
+        zstr_sendx (broker, "BIND", endpoint, NULL);
+    }
+
+    std::vector <std::pair <std::string, zactor_t *>> actors;
+    if (configurator_dir) {
+        zactor_t *actor = zactor_new (fty_metric_composite_configurator_server, (void *) "fty-metric-composite-configurator");
+        zstr_sendx (actor, "CFG_DIRECTORY", configurator_dir, NULL);
+        zstr_sendx (actor, "DRY_RUN", "true", NULL);
+        zstr_sendx (actor, "CONNECT", endpoint, NULL);
+        zstr_sendx (actor, "PRODUCER", "_METRICS_UNAVAILABLE", NULL);
+        zstr_sendx (actor, "CONSUMER", FTY_PROTO_STREAM_ASSETS, ".*", NULL);
+        actors.push_back (std::make_pair (std::string ("configurator"), actor));
+    }
+    for (const auto &config : composites) {
+        std::string name = "fty-metric-composite-" + config.substr (config.rfind ('/') + 1);
+        zactor_t *actor = zactor_new (fty_metric_composite_server, (void *) name.c_str ());
+        zstr_sendx (actor, "CONNECT", endpoint, NULL);
+        if (fty_metric_composite_server_wait (actor, "CONNECT") == 0) {
+            // subscriptions are in place once CONFIG is answered
+            zstr_sendx (actor, "CONFIG", config.c_str (), NULL);
+            fty_metric_composite_server_wait (actor, "CONFIG");
+        }
+        actors.push_back (std::make_pair (name, actor));
+    }
+    if (configurator_dir)
+        zclock_sleep (500);  // to settle down the subscriptions of the configurator
+
+    // one producer per stream
+    std::map <std::string, mlm_client_t *> producers;
+    int64_t first = 0;
+    int64_t start = zclock_usecs ();
+    uint64_t sent = 0;
+    zmsg_t *content = stream_capture_read (capture);
+    while (content && !zsys_interrupted) {
+        if (sent == 0)
+            first = stream_capture_timestamp (capture);
+        if (speed > 0) {
+            int64_t due = start + (int64_t) ((stream_capture_timestamp (capture) - first) / speed);
+            int64_t now = zclock_usecs ();
+            if (due > now)
+                zclock_sleep ((int) ((due - now) / 1000));
+        }
+        if (retime) {
+            s_retime (&content, (zclock_usecs () - stream_capture_timestamp (capture)) / 1000000);
+            if (!content) {
+                log_error ("Captured message '%s' cannot be decoded", stream_capture_subject (capture));
+                content = stream_capture_read (capture);
+                continue;
+            }
+        }
+        mlm_client_t *producer = producers [stream_capture_stream (capture)];
+        if (!producer) {
+            producer = mlm_client_new ();
+            char *name = zsys_sprintf ("fty-metric-composite-replay-%s", stream_capture_stream (capture));
+            mlm_client_connect (producer, endpoint, 1000, name);
+            mlm_client_set_producer (producer, stream_capture_stream (capture));
+            zstr_free (&name);
+            producers [stream_capture_stream (capture)] = producer;
+        }
+        if (mlm_client_send (producer, stream_capture_subject (capture), &content) != 0) {
+            log_error ("mlm_client_send (subject = '%s') failed", stream_capture_subject (capture));
+            zmsg_destroy (&content);
+        }
+        sent++;
+        content = stream_capture_read (capture);
+    }
+    zmsg_destroy (&content);
+    int64_t elapsed = zclock_usecs () - start;
+    if (stream_capture_error (capture))
+        log_error ("Capture file '%s' is corrupted after %" PRIu64 " messages", file, sent);
+
+    printf ("replayed: %" PRIu64 " messages in %.3f s (%.0f msg/s), captured span %.3f s\n",
+            sent, elapsed / 1e6, elapsed > 0 ? sent * 1e6 / elapsed : 0.0,
+            (stream_capture_timestamp (capture) - first) / 1e6);
+
+    zclock_sleep (settle);
+    for (auto &actor : actors) {
+        s_print_stats (actor.first.c_str (), actor.second);
+        zactor_destroy (&actor.second);
+    }
+    for (auto &producer : producers)
+        mlm_client_destroy (&producer.second);
+    zactor_destroy (&broker);
+    stream_capture_destroy (&capture);
+    return EXIT_SUCCESS;
+}
+
+int main (int argc, char *argv [])
+{
+    int help = 0;
+    bool verbose = false;
+    const char *file = NULL;
+    const char *endpoint = NULL;
+    std::vector <std::string> streams;
+    const char *pattern = ".*";
+    int duration = 0;
+    double speed = 1.0;
+    bool retime = false;
+    const char *configurator_dir = NULL;
+    std::vector <std::string> composites;
+    int settle = 1000;
+
+// Some systems define struct option with non-"const" "char *"
+#if defined(__GNUC__) || defined(__GNUG__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wwrite-strings"
+#endif
+    static const char *short_options = "hvf:e:s:p:d:x:rc:m:t:";
+    static struct option long_options[] =
+    {
+            {"help",            no_argument,        0,  'h'},
+            {"verbose",         no_argument,        0,  'v'},
+            {"file",            required_argument,  0,  'f'},
+            {"endpoint",        required_argument,  0,  'e'},
+            {"stream",          required_argument,  0,  's'},
+            {"pattern",         required_argument,  0,  'p'},
+            {"duration",        required_argument,  0,  'd'},
+            {"speed",           required_argument,  0,  'x'},
+            {"retime",          no_argument,        0,  'r'},
+            {"configurator",    required_argument,  0,  'c'},
+            {"composite",       required_argument,  0,  'm'},
+            {"settle",          required_argument,  0,  't'},
+            {0,                 0,                  0,  0}
+    };
+#if defined(__GNUC__) || defined(__GNUG__)
+#pragma GCC diagnostic pop
+#endif
+
+    while (true) {
+
+        int option_index = 0;
+        int c = getopt_long (argc, argv, short_options, long_options, &option_index);
+        if (c == -1)
+            break;
+        switch (c) {
+            case 'v':
+                verbose = true;
+                break;
+            case 'f':
+                file = optarg;
+                break;
+            case 'e':
+                endpoint = optarg;
+                break;
+            case 's':
+                streams.push_back (optarg);
+                break;
+            case 'p':
+                pattern = optarg;
+                break;
+            case 'd':
+                duration = atoi (optarg);
+                break;
+            case 'x':
+                speed = atof (optarg);
+                break;
+            case 'r':
+                retime = true;
+                break;
+            case 'c':
+                configurator_dir = optarg;
+                break;
+            case 'm':
+                composites.push_back (optarg);
+                break;
+            case 't':
+                settle = atoi (optarg);
+                break;
+            case 'h':
+            default:
+                help = 1;
+                break;
+        }
+    }
+    if (help || !file || optind >= argc) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    ManageFtyLog::setInstanceFtylog ("fty-metric-composite-capture", LOG_CONFIG);
+    if (verbose)
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+
+    const char *command = argv [optind];
+    if (streq (command, "record")) {
+        if (streams.empty ()) {
+            streams.push_back (FTY_PROTO_STREAM_ASSETS);
+            streams.push_back ("_METRICS_SENSOR");
+        }
+        return s_record (file, endpoint ? endpoint : ENDPOINT, streams, pattern, duration);
+    }
+    if (streq (command, "replay"))
+        return s_replay (file, endpoint, speed, retime, configurator_dir, composites, settle);
+
+    usage ();
+    return EXIT_FAILURE;
+}
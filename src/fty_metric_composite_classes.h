@@ -49,6 +49,62 @@ typedef struct _proto_metric_unavailable_t proto_metric_unavailable_t;
 typedef struct _c_metric_conf_t c_metric_conf_t;
 #define C_METRIC_CONF_T_DEFINED
 #endif
+#ifndef C_METRIC_STATS_T_DEFINED
+typedef struct _c_metric_stats_t c_metric_stats_t;
+#define C_METRIC_STATS_T_DEFINED
+#endif
+#ifndef COMPOSITE_STATS_T_DEFINED
+typedef struct _composite_stats_t composite_stats_t;
+#define COMPOSITE_STATS_T_DEFINED
+#endif
+#ifndef TOPOLOGY_GENERATOR_T_DEFINED
+typedef struct _topology_generator_t topology_generator_t;
+#define TOPOLOGY_GENERATOR_T_DEFINED
+#endif
+#ifndef STREAM_CAPTURE_T_DEFINED
+typedef struct _stream_capture_t stream_capture_t;
+#define STREAM_CAPTURE_T_DEFINED
+#endif
+#ifndef COMPOSITE_EVALUATOR_T_DEFINED
+typedef struct _composite_evaluator_t composite_evaluator_t;
+#define COMPOSITE_EVALUATOR_T_DEFINED
+#endif
+#ifndef COMPOSITE_GRAPH_T_DEFINED
+typedef struct _composite_graph_t composite_graph_t;
+#define COMPOSITE_GRAPH_T_DEFINED
+#endif
+#ifndef SAMPLE_WINDOW_T_DEFINED
+typedef struct _sample_window_t sample_window_t;
+#define SAMPLE_WINDOW_T_DEFINED
+#endif
+#ifndef SUBSCRIPTION_PATTERNS_T_DEFINED
+typedef struct _subscription_patterns_t subscription_patterns_t;
+#define SUBSCRIPTION_PATTERNS_T_DEFINED
+#endif
+#ifndef PROTO_METRIC_DECODE_T_DEFINED
+typedef struct _proto_metric_decode_t proto_metric_decode_t;
+#define PROTO_METRIC_DECODE_T_DEFINED
+#endif
+#ifndef METRIC_RING_T_DEFINED
+typedef struct _metric_ring_t metric_ring_t;
+#define METRIC_RING_T_DEFINED
+#endif
+#ifndef LUA_ARENA_T_DEFINED
+typedef struct _lua_arena_t lua_arena_t;
+#define LUA_ARENA_T_DEFINED
+#endif
+#ifndef COMPOSITE_EXPRESSION_T_DEFINED
+typedef struct _composite_expression_t composite_expression_t;
+#define COMPOSITE_EXPRESSION_T_DEFINED
+#endif
+#ifndef REDUCTION_KERNEL_T_DEFINED
+typedef struct _reduction_kernel_t reduction_kernel_t;
+#define REDUCTION_KERNEL_T_DEFINED
+#endif
+#ifndef INPUT_SNAPSHOT_T_DEFINED
+typedef struct _input_snapshot_t input_snapshot_t;
+#define INPUT_SNAPSHOT_T_DEFINED
+#endif
 
 //  Extra headers
 
@@ -95,6 +151,20 @@ safe_malloc (size_t size, const char *file, unsigned line)
 #include "data.h"
 #include "proto_metric_unavailable.h"
 #include "c_metric_conf.h"
+#include "c_metric_stats.h"
+#include "composite_stats.h"
+#include "topology_generator.h"
+#include "stream_capture.h"
+#include "composite_evaluator.h"
+#include "composite_graph.h"
+#include "sample_window.h"
+#include "subscription_patterns.h"
+#include "proto_metric_decode.h"
+#include "metric_ring.h"
+#include "lua_arena.h"
+#include "composite_expression.h"
+#include "reduction_kernel.h"
+#include "input_snapshot.h"
 
 //  *** To avoid double-definitions, only define if building without draft ***
 #ifndef FTY_METRIC_COMPOSITE_BUILD_DRAFT_API
@@ -119,6 +189,76 @@ FTY_METRIC_COMPOSITE_PRIVATE void
 FTY_METRIC_COMPOSITE_PRIVATE void
     c_metric_conf_test (bool verbose);
 
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    c_metric_stats_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    composite_stats_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    topology_generator_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    stream_capture_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    composite_evaluator_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    composite_graph_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    sample_window_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    subscription_patterns_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    proto_metric_decode_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    metric_ring_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    lua_arena_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    composite_expression_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    reduction_kernel_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_METRIC_COMPOSITE_PRIVATE void
+    input_snapshot_test (bool verbose);
+
 //  Self test for private classes
 FTY_METRIC_COMPOSITE_PRIVATE void
     fty_metric_composite_private_selftest (bool verbose, const char *subtest);
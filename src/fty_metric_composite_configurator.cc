@@ -40,6 +40,9 @@ void usage () {
     puts ("fty-metric-composite-configurator [options] ...\n"
           "  --verbose / -v         verbose logging mode\n"
           "  --output-dir / -o      directory, where configuration files would be created (directory MUST exist)\n"
+          "  --stats-interval / -s  publish own runtime statistics as metrics every N seconds (default 0 = never)\n"
+          "  --manifest / -m        write all composites into one manifest <output-dir>/<name>.cfg\n"
+          "                         run by service fty-metric-composite@<name> instead of a file and service each\n"
           "  --help / -h            this information\n"
           );
 }
@@ -60,18 +63,22 @@ int main (int argc, char *argv [])
     int help = 0;
     bool verbose = false;
     char *output_dir = NULL;
+    int stats_interval = 0;
+    const char *manifest = NULL;
 
 // Some systems define struct option with non-"const" "char *"
 #if defined(__GNUC__) || defined(__GNUG__)
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wwrite-strings"
 #endif
-    static const char *short_options = "hvs:";
+    static const char *short_options = "hvs:m:";
     static struct option long_options[] =
     {
             {"help",            no_argument,        0,  1},
             {"verbose",         no_argument,        0,  'v'},
             {"output-dir",      required_argument,  0,  'o'},
+            {"stats-interval",  required_argument,  0,  's'},
+            {"manifest",        required_argument,  0,  'm'},
             {0,                 0,                  0,  0}
     };
 #if defined(__GNUC__) || defined(__GNUG__)
@@ -95,6 +102,16 @@ int main (int argc, char *argv [])
                 output_dir = optarg;
                 break;
             }
+            case 's':
+            {
+                stats_interval = atoi (optarg);
+                break;
+            }
+            case 'm':
+            {
+                manifest = optarg;
+                break;
+            }
             case 'h':
             default:
             {
@@ -125,10 +142,17 @@ int main (int argc, char *argv [])
         return EXIT_FAILURE;
     }
     zstr_sendx (server,  "CFG_DIRECTORY", output_dir, NULL);
+    if (manifest)
+        zstr_sendx (server,  "MANIFEST", manifest, NULL);
     zstr_sendx (server,  "CONNECT", ENDPOINT, NULL);
     zstr_sendx (server,  "LOAD", NULL);
     zstr_sendx (server,  "PRODUCER", "_METRICS_UNAVAILABLE", NULL);
     zstr_sendx (server,  "CONSUMER", FTY_PROTO_STREAM_ASSETS, ".*", NULL);
+    if (stats_interval > 0) {
+        char *interval = zsys_sprintf ("%d", stats_interval * 1000);
+        zstr_sendx (server,  "STATS_INTERVAL", interval, NULL);
+        zstr_free (&interval);
+    }
 
     zloop_t *check_configuration_trigger = zloop_new();
     // one in a minute
@@ -23,42 +23,81 @@
 @header
     fty_metric_composite_configurator_server - Composite metrics server configurator
 @discuss
+    On regeneration only what changed is touched: a configuration file
+    generated with the same contents leaves its service alone, a changed one
+    is rewritten and its service reloaded (fty-metric-composite reloads its
+    configuration on SIGHUP, keeping the connection and last values), new
+    ones are started and services whose files were not generated again are
+    stopped and their files removed.
+
+    Next to each configuration file its compiled form (<file>.bin, see
+    composite_evaluator_compile) is written, so that the agents started
+    after a regeneration do not parse JSON nor compile Lua.
+
+    With a manifest (actor command MANIFEST/<name>) all composites go into
+    one file <name>.cfg, run by one service fty-metric-composite@<name>
+    which hosts them all. Each regeneration which changes anything writes
+    the next generation of the manifest into a temporary file, syncs it
+    once and renames it over the old one, so the agent reloads either the
+    old or the new generation as a whole. The directory is listed only
+    while the manifest does not exist yet, to stop the services of the
+    files written before.
 @end
 */
 #include <string>
 #include <vector>
+#include <set>
+#include <map>
 #include <regex>
+#include <fstream>
+#include <sstream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "fty_metric_composite_classes.h"
+#include "fty_metric_composite_trace.h"
 
 // Copied from agent-nut
+// Jobs are only queued (--no-block): units are Type=notify, waiting for each to
+// be ready would stall the actor for as long as its agent retries to connect.
 // -1 - error, subprocess code - success
 static int
-s_bits_systemctl (const char *operation, const char *service)
+s_bits_systemctl (c_metric_conf_t *cfg, const char *operation, const char *service)
 {
+    assert (cfg);
     assert (operation);
     assert (service);
+    if (c_metric_conf_dry_run (cfg)) {
+        log_debug ("dry run, not calling `sudo systemctl '%s' '%s'`", operation, service);
+        return 0;
+    }
     log_debug ("calling `sudo systemctl '%s' '%s'`", operation, service);
 
-    std::vector <std::string> _argv = {"sudo", "systemctl", operation, service};
+    std::vector <std::string> _argv = {"sudo", "systemctl", "--no-block", operation, service};
 
+    int64_t start = zclock_mono ();
+    FTY_METRIC_COMPOSITE_TRACE2 (systemctl, operation, service);
     MlmSubprocess::SubProcess systemd (_argv);
     if (systemd.run()) {
         int result = systemd.wait (false);
         log_info ("sudo systemctl '%s' '%s' result  == %i (%s)",
                   operation, service, result, result == 0 ? "ok" : "failed");
+        FTY_METRIC_COMPOSITE_TRACE4 (systemctl_done, operation, service, result, zclock_mono () - start);
+        c_metric_stats_systemctl (c_metric_conf_stats (cfg), zclock_mono () - start, result != 0);
         return result;
     }
     log_error ("can't run sudo systemctl '%s' '%s' command", operation, service);
+    FTY_METRIC_COMPOSITE_TRACE4 (systemctl_done, operation, service, -1, zclock_mono () - start);
+    c_metric_stats_systemctl (c_metric_conf_stats (cfg), zclock_mono () - start, true);
     return -1;
 }
 
-// For each config file in top level of 'path_to_dir' do
-//  * systemctl stop and disable of service that uses this file
-//  * remove config file
+// Collect names of config files in top level of 'path_to_dir'
 // 0 - success, 1 - failure
 static int
-s_remove_and_stop (const char *path_to_dir)
+s_list_configs (const char *path_to_dir, std::set <std::string> &files)
 {
     assert (path_to_dir);
 
@@ -68,8 +107,8 @@ s_remove_and_stop (const char *path_to_dir)
         return 1;
     }
 
-    zlist_t *files = zdir_list (dir);
-    if (!files) {
+    zlist_t *list = zdir_list (dir);
+    if (!list) {
         zdir_destroy (&dir);
         log_error ("zdir_list () failed.");
         return 1;
@@ -77,25 +116,42 @@ s_remove_and_stop (const char *path_to_dir)
 
     std::regex file_rex (".+\\.cfg");
 
-    zfile_t *item = (zfile_t *) zlist_first (files);
+    zfile_t *item = (zfile_t *) zlist_first (list);
     while (item) {
-        if (std::regex_match (zfile_filename (item, path_to_dir), file_rex)) {
-            std::string filename = zfile_filename (item, path_to_dir);
-            filename.erase (filename.size () - 4);
-            std::string service = "fty-metric-composite@";
-            service += filename;
-            s_bits_systemctl ("stop", service.c_str ());
-            s_bits_systemctl ("disable", service.c_str ());
-            zfile_remove (item);
-            log_debug ("file removed");
-        }
-        item = (zfile_t *) zlist_next (files);
+        if (std::regex_match (zfile_filename (item, path_to_dir), file_rex))
+            files.insert (zfile_filename (item, path_to_dir));
+        item = (zfile_t *) zlist_next (list);
     }
-    zlist_destroy (&files);
+    zlist_destroy (&list);
     zdir_destroy (&dir);
     return 0;
 }
 
+// For each config file of 'files' in 'path_to_dir' do
+//  * systemctl stop and disable of service that uses this file
+//  * remove config file
+static void
+s_remove_and_stop (c_metric_conf_t *cfg, const char *path_to_dir, const std::set <std::string> &files)
+{
+    assert (cfg);
+    assert (path_to_dir);
+
+    for (const auto &file : files) {
+        std::string instance = file.substr (0, file.size () - 4);
+        std::string service = "fty-metric-composite@" + instance;
+        s_bits_systemctl (cfg, "stop", service.c_str ());
+        s_bits_systemctl (cfg, "disable", service.c_str ());
+        std::string fullpath = std::string (path_to_dir) + "/" + file;
+        unlink ((fullpath + COMPOSITE_EVALUATOR_COMPILED_SUFFIX).c_str ());
+        // the unit keeps the snapshot of its inputs next to the configuration
+        unlink ((std::string (path_to_dir) + "/" + instance + ".snapshot").c_str ());
+        if (unlink (fullpath.c_str ()) != 0)
+            log_error ("Removing config file '%s' failed", fullpath.c_str ());
+        else
+            log_debug ("file removed");
+    }
+}
+
 // Write contents to file
 // 0 - success, 1 - failure
 static int
@@ -133,11 +189,163 @@ s_write_file (const char *fullpath, const char *contents)
     return 0;
 }
 
+// Replace file 'fullpath' in 'path_to_dir' by 'contents': write a temporary file,
+// sync it and rename it over, so readers see the old or the new file, never a part
+// 0 - success, 1 - failure
+static int
+s_replace_file (const char *path_to_dir, const std::string &fullpath, const std::string &contents)
+{
+    std::string temporary = fullpath + ".tmp";
+    int fd = open (temporary.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        log_error ("Cannot create '%s': %s", temporary.c_str (), strerror (errno));
+        return 1;
+    }
+    size_t written = 0;
+    while (written < contents.size ()) {
+        ssize_t rv = write (fd, contents.data () + written, contents.size () - written);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv <= 0)
+            break;
+        written += (size_t) rv;
+    }
+    bool ok = written == contents.size () && fsync (fd) == 0;
+    ok = close (fd) == 0 && ok;
+    if (!ok || rename (temporary.c_str (), fullpath.c_str ()) != 0) {
+        log_error ("Writing '%s' failed: %s", fullpath.c_str (), strerror (errno));
+        unlink (temporary.c_str ());
+        return 1;
+    }
+    // the rename survives a crash only with the directory synced too
+    int dir = open (path_to_dir, O_RDONLY | O_DIRECTORY);
+    if (dir != -1) {
+        fsync (dir);
+        close (dir);
+    }
+    return 0;
+}
+
+// Write all 'composites' (name -> configuration) into manifest 'name' as its next
+// generation and start its service, or reload it if the manifest existed. An
+// unchanged manifest and its service are left alone.
+// 0 - success, 1 - failure
+static int
+s_write_manifest (c_metric_conf_t *cfg, const char *path_to_dir, const char *name, const std::map <std::string, std::string> &composites)
+{
+    std::string fullpath = std::string (path_to_dir) + "/" + name + ".cfg";
+    std::string service = std::string ("fty-metric-composite@") + name;
+
+    std::string body = "\"composites\" : {";
+    for (const auto &it : composites) {
+        std::string contents = it.second;
+        if (!contents.empty () && contents.back () == '\n')
+            contents.pop_back ();
+        body += (body.back () == '{' ? "\n\"" : ",\n\"") + it.first + "\" : " + contents;
+    }
+    body += "\n}\n}\n";
+
+    uint64_t generation = 0;
+    std::ifstream file (fullpath);
+    bool existed = file.is_open ();
+    if (existed) {
+        std::stringstream current;
+        current << file.rdbuf ();
+        const std::string &text = current.str ();
+        size_t at = text.find ("\"composites\"");
+        if (at != std::string::npos && text.compare (at, std::string::npos, body) == 0) {
+            log_debug ("manifest '%s' did not change", fullpath.c_str ());
+            return 0;
+        }
+        at = text.find ("\"generation\"");
+        if (at != std::string::npos && (at = text.find (':', at)) != std::string::npos)
+            generation = strtoull (text.c_str () + at + 1, NULL, 10);
+    }
+    generation++;
+    std::string contents = "{\n\"manifest\" : " + std::to_string (COMPOSITE_EVALUATOR_MANIFEST_VERSION) + ",\n"
+        "\"generation\" : " + std::to_string (generation) + ",\n" + body;
+    if (s_replace_file (path_to_dir, fullpath, contents) != 0)
+        return 1;
+    log_info ("Manifest '%s' generation %" PRIu64 " with %zu composites written", fullpath.c_str (), generation, composites.size ());
+    if (existed)
+        s_bits_systemctl (cfg, "reload-or-restart", service.c_str ());
+    else {
+        s_bits_systemctl (cfg, "enable", service.c_str ());
+        s_bits_systemctl (cfg, "start", service.c_str ());
+    }
+    return 0;
+}
+
+// Write configuration 'filename' (without extension) of a service and start it.
+// A file of 'previous' (and its service) is left alone when 'contents' did not
+// change, otherwise the running service is reloaded; it is removed from 'previous'.
+// 0 - success, 1 - failure
+static int
+s_write_and_start (c_metric_conf_t *cfg, const char *path_to_dir, const std::string &filename, const std::string &contents, std::set <std::string> &previous)
+{
+    std::string fullpath = path_to_dir;
+    fullpath += "/";
+    fullpath += filename;
+    fullpath += ".cfg";
+
+    std::string service = "fty-metric-composite";
+    service += "@";
+    service += filename;
+
+    std::string compiled = fullpath + COMPOSITE_EVALUATOR_COMPILED_SUFFIX;
+    bool existed = previous.erase (filename + ".cfg") > 0;
+    if (existed) {
+        std::ifstream file (fullpath);
+        std::stringstream current;
+        current << file.rdbuf ();
+        if (file && current.str () == contents) {
+            log_debug ("config file '%s' did not change", fullpath.c_str ());
+            // e.g. written by a version which did not compile them
+            if (access (compiled.c_str (), F_OK) != 0)
+                composite_evaluator_compile (fullpath.c_str (), compiled.c_str ());
+            return 0;
+        }
+    }
+    if (s_write_file (fullpath.c_str (), contents.c_str ()) != 0) {
+        log_error (
+                "Creating config file '%s' failed. Service '%s' not started.",
+                fullpath.c_str (), filename.c_str ());
+        return 1;
+    }
+    // the agent falls back to JSON when the compiled file is missing or older
+    if (composite_evaluator_compile (fullpath.c_str (), compiled.c_str ()) != 0)
+        log_warning ("Compiling config file '%s' failed", fullpath.c_str ());
+    if (existed)
+        s_bits_systemctl (cfg, "reload-or-restart", service.c_str ());
+    else {
+        s_bits_systemctl (cfg, "enable", service.c_str ());
+        s_bits_systemctl (cfg, "start", service.c_str ());
+    }
+    return 0;
+}
+
+// Keep configuration 'filename' (without extension): in 'manifest' if it is not
+// NULL, otherwise in its own file with its own service (see s_write_and_start)
+// 0 - success, 1 - failure
+static int
+s_store (c_metric_conf_t *cfg, const char *path_to_dir, const std::string &filename, const std::string &contents,
+         std::set <std::string> &previous, std::map <std::string, std::string> *manifest)
+{
+    if (manifest) {
+        (*manifest) [filename] = contents;
+        return 0;
+    }
+    return s_write_and_start (cfg, path_to_dir, filename, contents, previous);
+}
+
 // Generate todo
 // 0 - success, 1 - failure
 static void
-s_generate_and_start (const char *path_to_dir, const char *sensor_function, const char *asset_name, zlistx_t **sensors_p, std::set <std::string> &newMetricsGenerated)
+s_generate_and_start (c_metric_conf_t *cfg, const char *path_to_dir, const char *sensor_function, const char *asset_name, zlistx_t **sensors_p,
+                      std::set <std::string> &newMetricsGenerated, std::set <std::string> &previous,
+                      std::map <std::string, std::string> *manifest)
 {
+    assert (cfg);
     assert (path_to_dir);
     assert (asset_name);
     assert (sensors_p);
@@ -154,6 +362,7 @@ s_generate_and_start (const char *path_to_dir, const char *sensor_function, cons
         *sensors_p = NULL;
         return;
     }
+    FTY_METRIC_COMPOSITE_TRACE3 (generate_and_start, asset_name, sensor_function ? sensor_function : "", zlistx_size (sensors));
 
     std::string temp_in = "[ ", hum_in = "[ ";
 
@@ -234,25 +443,8 @@ s_generate_and_start (const char *path_to_dir, const char *sensor_function, cons
     }
     filename += "-temperature";
 
-    std::string fullpath = path_to_dir;
-    fullpath += "/";
-    fullpath += filename;
-    fullpath += ".cfg";
-
-    std::string service = "fty-metric-composite";
-    service += "@";
-    service += filename;
-
-    if (s_write_file (fullpath.c_str (), contents.c_str ()) == 0) {
-        s_bits_systemctl ("enable", service.c_str ());
-        s_bits_systemctl ("start", service.c_str ());
+    if (s_store (cfg, path_to_dir, filename, contents, previous, manifest) == 0)
         newMetricsGenerated.insert (result_topic);
-    }
-    else {
-        log_error (
-                "Creating config file '%s' failed. Service '%s' not started.",
-                fullpath.c_str (), filename.c_str ());
-    }
 
     contents = json_tmpl;
     contents.replace (contents.find ("##IN##"), strlen ("##IN##"), hum_in);
@@ -277,25 +469,8 @@ s_generate_and_start (const char *path_to_dir, const char *sensor_function, cons
     }
     filename += "-humidity";
 
-    fullpath = path_to_dir;
-    fullpath += "/";
-    fullpath += filename;
-    fullpath += ".cfg";
-
-    service = "fty-metric-composite";
-    service += "@";
-    service += filename;
-
-    if (s_write_file (fullpath.c_str (), contents.c_str ()) == 0) {
-        s_bits_systemctl ("enable", service.c_str ());
-        s_bits_systemctl ("start", service.c_str ());
+    if (s_store (cfg, path_to_dir, filename, contents, previous, manifest) == 0)
         newMetricsGenerated.insert (result_topic);
-    }
-    else {
-        log_error (
-                "Creating config file '%s' failed. Service '%s' not started.",
-                fullpath.c_str (), filename.c_str ());
-    }
     return;
 }
 
@@ -304,27 +479,41 @@ s_regenerate (c_metric_conf_t *cfg, data_t *data, std::set <std::string> &metric
 {
     assert (cfg);
     assert (data);
+    c_metric_stats_t *stats = c_metric_conf_stats (cfg);
+    int64_t start = zclock_mono ();
+    int64_t phase_start = start;
     // potential unavailable metrics are those, what are now still available
     metrics_unavailable = data_get_produced_metrics (data);
-    // 1. Delete all files in output dir and stop/disable services
-    int rv = s_remove_and_stop (c_metric_conf_cfgdir (cfg));
-    log_info ("Old configuration was removed");
-    if (rv != 0) {
-        log_error (
-                "Error removing old config files from directory '%s'. New config "
-                "files were NOT generated and services were NOT started.", c_metric_conf_cfgdir (cfg));
-        return;
+    // 1. Files in output dir are of the running services; with a manifest only
+    //    until it is written for the first time
+    const char *manifest_name = c_metric_conf_manifest (cfg);
+    std::map <std::string, std::string> manifest;
+    std::set <std::string> previous;
+    std::string manifest_path = std::string (c_metric_conf_cfgdir (cfg)) + "/" + (manifest_name ? manifest_name : "") + ".cfg";
+    if (!manifest_name || access (manifest_path.c_str (), F_OK) != 0) {
+        int rv = s_list_configs (c_metric_conf_cfgdir (cfg), previous);
+        if (rv != 0) {
+            log_error (
+                    "Error listing old config files in directory '%s'. New config "
+                    "files were NOT generated and services were NOT started.", c_metric_conf_cfgdir (cfg));
+            c_metric_stats_phase (stats, C_METRIC_STATS_REGENERATE, zclock_mono () - start);
+            return;
+        }
     }
 
-    // 2. Generate new files and enable/start services
+    // 2. Generate new files and enable/start or reload services, unchanged ones are left alone
     zlistx_t *assets = data_asset_names (data);
     if (!assets) {
         log_error ("data_asset_names () failed");
+        c_metric_stats_phase (stats, C_METRIC_STATS_REGENERATE, zclock_mono () - start);
         return;
     }
     log_debug ("propagation: %s",  c_metric_conf_propagation (cfg) ? "true": "false");
+    phase_start = zclock_mono ();
     data_reassign_sensors (data, c_metric_conf_propagation (cfg));
+    c_metric_stats_phase (stats, C_METRIC_STATS_REASSIGN, zclock_mono () - phase_start);
     log_info ("New configuration was deduced");
+    phase_start = zclock_mono ();
     const char *asset = (const char *) zlistx_first (assets);
     std::set <std::string> metricsAvailable;
     while (asset) {
@@ -334,13 +523,13 @@ s_regenerate (c_metric_conf_t *cfg, data_t *data, std::set <std::string> &metric
             // Ti, Hi
             sensors = data_get_assigned_sensors (data, asset, "input");
             if (sensors) {
-                s_generate_and_start (c_metric_conf_cfgdir (cfg), "input", asset, &sensors, metricsAvailable);
+                s_generate_and_start (cfg, c_metric_conf_cfgdir (cfg), "input", asset, &sensors, metricsAvailable, previous, manifest_name ? &manifest : NULL);
             }
 
             // To, Ho
             sensors = data_get_assigned_sensors (data, asset, "output");
             if (sensors) {
-                s_generate_and_start (c_metric_conf_cfgdir (cfg), "output", asset, &sensors, metricsAvailable);
+                s_generate_and_start (cfg, c_metric_conf_cfgdir (cfg), "output", asset, &sensors, metricsAvailable, previous, manifest_name ? &manifest : NULL);
             }
         }
         else {
@@ -348,17 +537,69 @@ s_regenerate (c_metric_conf_t *cfg, data_t *data, std::set <std::string> &metric
             // T, H
             sensors = data_get_assigned_sensors (data, asset, NULL);
             if (sensors) {
-                s_generate_and_start (c_metric_conf_cfgdir (cfg), NULL, asset, &sensors, metricsAvailable);
+                s_generate_and_start (cfg, c_metric_conf_cfgdir (cfg), NULL, asset, &sensors, metricsAvailable, previous, manifest_name ? &manifest : NULL);
             }
         }
         asset = (const char *) zlistx_next (assets);
     }
+    zlistx_destroy (&assets);
+    if (manifest_name && s_write_manifest (cfg, c_metric_conf_cfgdir (cfg), manifest_name, manifest) != 0) {
+        // the previous generation keeps running, nothing changed
+        log_error ("Manifest '%s' was NOT written, services were NOT changed", manifest_path.c_str ());
+        metrics_unavailable.clear ();
+        c_metric_stats_phase (stats, C_METRIC_STATS_GENERATE, zclock_mono () - phase_start);
+        c_metric_stats_phase (stats, C_METRIC_STATS_REGENERATE, zclock_mono () - start);
+        return;
+    }
     for (const auto &one_metric: metricsAvailable) {
         metrics_unavailable.erase (one_metric);
     }
     data_set_produced_metrics (data, metricsAvailable);
-    zlistx_destroy (&assets);
-    log_info ("Sensors were reconfigured");
+    c_metric_stats_phase (stats, C_METRIC_STATS_GENERATE, zclock_mono () - phase_start);
+
+    // 3. Delete files which were not generated again and stop/disable their services
+    phase_start = zclock_mono ();
+    s_remove_and_stop (cfg, c_metric_conf_cfgdir (cfg), previous);
+    c_metric_stats_phase (stats, C_METRIC_STATS_REMOVE, zclock_mono () - phase_start);
+    log_info ("%zu old configurations were removed", previous.size ());
+    c_metric_stats_phase (stats, C_METRIC_STATS_REGENERATE, zclock_mono () - start);
+    log_info ("Sensors were reconfigured in %" PRIi64 " ms", zclock_mono () - start);
+}
+
+// Regenerate the configuration and announce metrics which are not produced anymore
+static void
+s_reconfigure (c_metric_conf_t *cfg, data_t *data)
+{
+    int64_t start = zclock_mono ();
+    std::set <std::string> metrics_unavailable;
+    s_regenerate (cfg, data, metrics_unavailable);
+    if (!mlm_client_connected (c_metric_conf_client (cfg))) {
+        // nobody to tell (e.g. offline benchmark)
+        return;
+    }
+    for (const auto &one_metric: metrics_unavailable) {
+        proto_metric_unavailable_send (c_metric_conf_client (cfg), one_metric.c_str ());
+    }
+    // ASSETS messages which arrived meanwhile were waiting since we started
+    if (zsock_events (mlm_client_msgpipe (c_metric_conf_client (cfg))) & ZMQ_POLLIN) {
+        c_metric_stats_backlog (c_metric_conf_stats (cfg), start);
+    }
+}
+
+// Publish self-metrics if enabled and due, returns ms till the next publication
+static int64_t
+s_publish_stats (c_metric_conf_t *cfg, data_t *data, int64_t &last_publish)
+{
+    int interval = c_metric_conf_stats_interval (cfg);
+    if (interval <= 0)
+        return -1;
+    int64_t now = zclock_mono ();
+    if (now - last_publish >= interval) {
+        // keep metrics alive for two periods, so one late publication is not a gap
+        c_metric_stats_publish (c_metric_conf_stats (cfg), data, c_metric_conf_name (cfg), (uint32_t) (2 * interval / 1000 + 1));
+        last_publish = now;
+    }
+    return interval - (now - last_publish);
 }
 
 
@@ -389,9 +630,15 @@ fty_metric_composite_configurator_server (zsock_t *pipe, void* args)
 
     uint64_t timestamp = (uint64_t) zclock_mono ();
     uint64_t timeout = (uint64_t) 30000;
+    int64_t stats_timestamp = zclock_mono ();
 
     while (!zsys_interrupted) {
-        void *which = zpoller_wait (poller, timeout);
+        // wake up for the self-metrics publication too, if it comes sooner
+        int64_t wait = (int64_t) timeout;
+        int64_t stats_due = s_publish_stats (cfg, data, stats_timestamp);
+        if (stats_due >= 0 && stats_due < wait)
+            wait = stats_due;
+        void *which = zpoller_wait (poller, (int) wait);
 
         if (which == NULL) {
             if (zpoller_terminated (poller) || zsys_interrupted) {
@@ -401,12 +648,10 @@ fty_metric_composite_configurator_server (zsock_t *pipe, void* args)
                 break;
             }
             if (zpoller_expired (poller)) {
+                if ((uint64_t) zclock_mono () - timestamp < timeout)
+                    continue;   // woken up for the self-metrics only
                 if (data_is_reconfig_needed (data)) {
-                    std::set <std::string> metrics_unavailable;
-                    s_regenerate (cfg, data, metrics_unavailable);
-                    for (const auto &one_metric: metrics_unavailable) {
-                        proto_metric_unavailable_send (c_metric_conf_client (cfg), one_metric.c_str ());
-                    }
+                    s_reconfigure (cfg, data);
                 }
             }
             timestamp = (uint64_t) zclock_mono ();
@@ -420,18 +665,15 @@ fty_metric_composite_configurator_server (zsock_t *pipe, void* args)
                 continue;
             }
             bool old_is_propagation_needed = c_metric_conf_propagation (cfg);
-            if (actor_commands (cfg, &data, &message) == 1) {
+            int rv = actor_commands (pipe, cfg, &data, &message);
+            if (rv == 1) {
                 break;
             }
             // This is UGLY hack, because there is a need to call s_regenerate from actor commands in some cases
             // but s_regenerate is satic function here!
-            if (old_is_propagation_needed != c_metric_conf_propagation (cfg)) {
+            if (rv == 2 || old_is_propagation_needed != c_metric_conf_propagation (cfg)) {
                 // so, we need to regenerate configuration according new reality
-                std::set <std::string> metrics_unavailable;
-                s_regenerate (cfg, data, metrics_unavailable);
-                for (const auto &one_metric: metrics_unavailable ) {
-                    proto_metric_unavailable_send (c_metric_conf_client (cfg), one_metric.c_str ());
-                }
+                s_reconfigure (cfg, data);
             }
             continue;
         }
@@ -439,11 +681,7 @@ fty_metric_composite_configurator_server (zsock_t *pipe, void* args)
         uint64_t now = (uint64_t) zclock_mono ();
         if (now - timestamp >= timeout) {
              if (data_is_reconfig_needed (data)) {
-                std::set <std::string> metrics_unavailable;
-                s_regenerate (cfg, data, metrics_unavailable);
-                for (const auto &one_metric: metrics_unavailable) {
-                    proto_metric_unavailable_send (c_metric_conf_client (cfg), one_metric.c_str ());
-                }
+                s_reconfigure (cfg, data);
             }
             timestamp = (uint64_t) zclock_mono ();
         }
@@ -470,6 +708,9 @@ fty_metric_composite_configurator_server (zsock_t *pipe, void* args)
             }
             data_asset_store (data, &proto);
             assert (proto == NULL);
+            c_metric_stats_asset_message (
+                    c_metric_conf_stats (cfg),
+                    zsock_events (mlm_client_msgpipe (c_metric_conf_client (cfg))) & ZMQ_POLLIN);
         }
         else
         if (streq (command, "MAILBOX DELIVER") ||
@@ -1061,8 +1302,33 @@ fty_metric_composite_configurator_server_test (bool verbose)
             log_trace ("TRACE BLOCK-1 zsys_file_delete('%s')", expected_filename);
             zsys_file_delete (expected_filename);
             zstr_free (&expected_filename);
+            // compiled next to it
+            expected_filename = zsys_sprintf ("%s/%s%s", test_state_dir, it.c_str(), COMPOSITE_EVALUATOR_COMPILED_SUFFIX);
+            assert (expected_filename != NULL);
+            zsys_file_delete (expected_filename);
+            zstr_free (&expected_filename);
         }
 
+        // Runtime statistics reflect the reconfiguration above
+        zstr_send (configurator, "STATS");
+        zmsg_t *stats = zmsg_recv (configurator);
+        assert (stats);
+        char *part = zmsg_popstr (stats);
+        assert (streq (part, "STATS"));
+        zstr_free (&part);
+        char *key = zmsg_popstr (stats);
+        while (key) {
+            char *value = zmsg_popstr (stats);
+            assert (value);
+            log_debug ("STATS %s = %s", key, value);
+            if (streq (key, "regenerations") || streq (key, "asset_messages") || streq (key, "systemctl_calls"))
+                assert (atoi (value) > 0);
+            zstr_free (&value);
+            zstr_free (&key);
+            key = zmsg_popstr (stats);
+        }
+        zmsg_destroy (&stats);
+
         log_debug ("Test block -1- Ok\n");
     }
 
@@ -1369,6 +1635,11 @@ fty_metric_composite_configurator_server_test (bool verbose)
             log_trace ("TRACE BLOCK-2 zsys_file_delete('%s')", expected_filename);
             zsys_file_delete (expected_filename);
             zstr_free (&expected_filename);
+            // compiled next to it
+            expected_filename = zsys_sprintf ("%s/%s%s", test_state_dir, it.c_str(), COMPOSITE_EVALUATOR_COMPILED_SUFFIX);
+            assert (expected_filename != NULL);
+            zsys_file_delete (expected_filename);
+            zstr_free (&expected_filename);
         }
 
         zlistx_destroy (&expected_unavailable);
@@ -1376,6 +1647,58 @@ fty_metric_composite_configurator_server_test (bool verbose)
         log_debug ("Test block -2- Ok\n");
     }
 
+    log_debug ("TRACE ---===### (Test block -3-) ###===---\n");
+    {
+        // all composites go into one manifest, written again only when it changes
+        zstr_sendx (configurator, "DRY_RUN", "true", NULL);
+        zstr_sendx (configurator, "MANIFEST", "composites", NULL);
+        std::string manifest = std::string (test_state_dir) + "/composites.cfg";
+        for (int run = 0; run < 2; run++) {
+            zstr_sendx (configurator, "REGENERATE", NULL);
+            // STATS reply comes after the regeneration is done
+            zstr_send (configurator, "STATS");
+            zmsg_t *stats = zmsg_recv (configurator);
+            assert (stats);
+            zmsg_destroy (&stats);
+
+            std::vector <std::string> expected_configs = { "composites.cfg" };
+            assert (test_dir_contents (test_state_dir, expected_configs) == 0);
+            std::ifstream file (manifest);
+            std::stringstream contents;
+            contents << file.rdbuf ();
+            assert (contents.str ().find ("\"generation\" : 1,") != std::string::npos);
+            std::vector <composite_evaluator_t *> evaluators;
+            assert (composite_evaluator_load_source (manifest.c_str (), evaluators) == 0);
+            assert (evaluators.size () == 4);
+            std::string name = manifest + ":Rack01-input-humidity";     // in order of names
+            assert (streq (composite_evaluator_name (evaluators [0]), name.c_str ()));
+            for (auto &evaluator : evaluators)
+                composite_evaluator_destroy (&evaluator);
+        }
+
+        // back to a file per composite, the manifest is removed with the snapshot of its service
+        std::string snapshot = std::string (test_state_dir) + "/composites.snapshot";
+        std::ofstream (snapshot) << "inputs";
+        assert (access (snapshot.c_str (), F_OK) == 0);
+        zstr_sendx (configurator, "MANIFEST", "", NULL);
+        zstr_sendx (configurator, "REGENERATE", NULL);
+        zstr_send (configurator, "STATS");
+        zmsg_t *stats = zmsg_recv (configurator);
+        assert (stats);
+        zmsg_destroy (&stats);
+        assert (access (snapshot.c_str (), F_OK) != 0);
+        std::vector <std::string> expected_configs = {
+            "Rack01-input-temperature.cfg",
+            "Rack01-input-humidity.cfg",
+            "Rack01-output-temperature.cfg",
+            "Rack01-output-humidity.cfg"
+        };
+        assert (test_dir_contents (test_state_dir, expected_configs) == 0);
+        zstr_sendx (configurator, "DRY_RUN", "false", NULL);
+
+        log_debug ("Test block -3- Ok\n");
+    }
+
     log_trace ("TRACE DELETE Sensor15\n");
     asset = test_asset_new ("Sensor15", FTY_PROTO_ASSET_OP_DELETE);
     fty_proto_aux_insert (asset, "type", "%s", "device");
@@ -46,6 +46,34 @@ fty_metric_composite_private_selftest (bool verbose, const char *subtest)
         proto_metric_unavailable_test (verbose);
     if (streq (subtest, "$ALL") || streq (subtest, "c_metric_conf_test"))
         c_metric_conf_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "c_metric_stats_test"))
+        c_metric_stats_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "composite_stats_test"))
+        composite_stats_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "topology_generator_test"))
+        topology_generator_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "stream_capture_test"))
+        stream_capture_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "composite_evaluator_test"))
+        composite_evaluator_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "composite_graph_test"))
+        composite_graph_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "sample_window_test"))
+        sample_window_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "subscription_patterns_test"))
+        subscription_patterns_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "proto_metric_decode_test"))
+        proto_metric_decode_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "metric_ring_test"))
+        metric_ring_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "lua_arena_test"))
+        lua_arena_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "composite_expression_test"))
+        composite_expression_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "reduction_kernel_test"))
+        reduction_kernel_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "input_snapshot_test"))
+        input_snapshot_test (verbose);
 }
 /*
 ################################################################################
@@ -46,6 +46,20 @@ all_tests [] = {
     { "data", NULL, true, false, "data_test" },
     { "proto_metric_unavailable", NULL, true, false, "proto_metric_unavailable_test" },
     { "c_metric_conf", NULL, true, false, "c_metric_conf_test" },
+    { "c_metric_stats", NULL, true, false, "c_metric_stats_test" },
+    { "composite_stats", NULL, true, false, "composite_stats_test" },
+    { "topology_generator", NULL, true, false, "topology_generator_test" },
+    { "stream_capture", NULL, true, false, "stream_capture_test" },
+    { "composite_evaluator", NULL, true, false, "composite_evaluator_test" },
+    { "composite_graph", NULL, true, false, "composite_graph_test" },
+    { "sample_window", NULL, true, false, "sample_window_test" },
+    { "subscription_patterns", NULL, true, false, "subscription_patterns_test" },
+    { "proto_metric_decode", NULL, true, false, "proto_metric_decode_test" },
+    { "metric_ring", NULL, true, false, "metric_ring_test" },
+    { "lua_arena", NULL, true, false, "lua_arena_test" },
+    { "composite_expression", NULL, true, false, "composite_expression_test" },
+    { "reduction_kernel", NULL, true, false, "reduction_kernel_test" },
+    { "input_snapshot", NULL, true, false, "input_snapshot_test" },
     { "private_classes", NULL, false, false, "$ALL" }, // compat option for older projects
 #endif // FTY_METRIC_COMPOSITE_BUILD_DRAFT_API
 #ifdef FTY_METRIC_COMPOSITE_BUILD_DRAFT_API
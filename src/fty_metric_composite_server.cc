@@ -22,56 +22,325 @@
 @header
     fty_metric_composite_server - Composite metrics server
 @discuss
+    CONNECT/<endpoint>[/<attempts>] and CONFIG/<file> are answered on the pipe
+    by <command>/OK or <command>/ERROR/<reason>, so the caller knows when the
+    actor is ready instead of waiting for a fixed time; see
+    fty_metric_composite_server_wait. A failed connection is retried with
+    exponential backoff and random jitter (default 10 attempts), so that
+    agents restarted together do not hit the broker all at once. A CONFIG
+    which cannot be loaded is refused and the actor keeps running.
+
+    Besides CONNECT and CONFIG the actor accepts STATS command, which is
+    answered on the pipe by STATS/key1/value1/... with runtime statistics
+    (see composite_stats).
+
+    Command SHM/<interval_ms>, sent before CONFIG, switches the actor to
+    read its inputs from the fty shm metric store every interval_ms instead
+    of subscribing to _METRICS_SENSOR; CONNECT is then not needed. Only
+    inputs with a newer timestamp than the last one seen are passed on.
+
+    CONFIG can be sent repeatedly, every configuration file is loaded into
+    its own composite_evaluator and all are kept in one composite_graph.
+    CONFIG of a file which is loaded already reloads it without a restart:
+    the new evaluator replaces the old one in one step and keeps last values
+    of the inputs both have (composite_graph_replace), and only inputs not
+    subscribed yet are subscribed. Malamute cannot unsubscribe, messages of
+    removed inputs and of inputs now produced by another composite in memory
+    are dropped; inputs read from shm are polled only while some composite
+    needs them. A file which cannot be loaded leaves the old configuration
+    running.
+    A file may also be a manifest with all composites of the configurator
+    (see composite_evaluator_load_source). Its CONFIG loads all of them and
+    switches the graph to them in one step (composite_graph_reload), so the
+    next generation of the manifest replaces the previous one as a whole:
+    changed composites are reloaded as above, missing ones are removed.
+    A configuration may consume outputs of other configurations of the same
+    actor, these are passed in memory instead of subscribing to them. All
+    metrics produced for one received message are published. Configurations
+    with "evaluate_every_ms" are evaluated on a timer of the actor instead.
+
+    Command SHARDS/<n> with n > 1 moves the evaluation to n threads. Before
+    the first message is evaluated, the graph is split into n graphs (see
+    composite_graph_split), each evaluated by its own thread; the actor
+    only receives and decodes the messages and passes fixed-size records to
+    the thread owning the input through a metric_ring. Threads drain their
+    ring in batches and evaluate once per batch, so a slow script delays
+    only the composites of its thread. When a ring is full, the message is
+    lost for that thread and counted as ring_full. A thread waiting for
+    data is woken through its actor pipe, only when it said it would sleep.
+    CONFIG joins the graphs back and they are split again on the next
+    message. Inputs read from shm are always evaluated by the actor.
+
+    Command SNAPSHOT/<path> keeps last values of received inputs in an
+    input_snapshot file. Values still valid when the actor is started again
+    with the same file are restored after each CONFIG, so the first outputs
+    after a restart are computed over all sensors, not only over those which
+    reported since. Inputs read from shm are not kept, shm has them already.
 @end
 */
 
 #include "fty_metric_composite_classes.h"
-
-extern "C" {
-#include <lua.h>
-#include <lauxlib.h>
-#include <lualib.h>
-}
+#include "fty_metric_composite_trace.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
 #include <map>
-#include <iostream>
-#include <fstream>
-#include <cxxtools/jsondeserializer.h>
-#include <cxxtools/directory.h>
+#include <set>
 #include <fty_proto.h>
+#include <unistd.h>
+
+//  Time to live of published metrics
+static const uint64_t TTL = 5*60;
+
+//  Connection to the broker, the backoff doubles after each failed attempt
+static const int CONNECT_TIMEOUT = 1000;        // ms of one attempt
+static const int CONNECT_BACKOFF = 100;         // ms before the second attempt
+static const int CONNECT_BACKOFF_MAX = 5000;
+static const int CONNECT_ATTEMPTS = 10;
 
-struct value {
-  double value;
-  time_t valid_till;
-};
+//  Input read from shm in SHM mode
+typedef struct {
+    std::string topic;
+    std::string type;
+    std::string asset;
+    uint64_t timestamp;     // of the last value seen
+} shm_input_t;
 
-static std::string
-escape_regex (const std::string &notregex)
+//  Read inputs from shm, pass changed ones to the graph; returns number of changed
+static size_t
+s_poll_shm (std::vector <shm_input_t> &inputs, composite_graph_t *graph, composite_stats_t *stats)
 {
-    static const char *to_be_escaped = ".^$|()[]{}*+?\\";
-    std::string result;
+    size_t changed = 0;
+    for (auto &input : inputs) {
+        int64_t started = zclock_usecs ();
+        fty_proto_t *metric = NULL;
+        if (fty::shm::read_metric (input.asset, input.type, &metric) != 0 || metric == NULL)
+            continue;   // not there or expired
+        uint64_t timestamp = fty_proto_time (metric);
+        if (timestamp == input.timestamp) {
+            fty_proto_destroy (&metric);
+            continue;
+        }
+        input.timestamp = timestamp;
+        const char *text = fty_proto_value (metric);
+        double value = proto_metric_parse_value (text, strlen (text));
+        time_t valid_till = timestamp + fty_proto_ttl (metric);
+        fty_proto_destroy (&metric);
+        composite_stats_record (stats, COMPOSITE_STATS_DECODE, zclock_usecs () - started);
+        composite_stats_received (stats, input.topic.c_str ());
+        composite_graph_update (graph, input.topic, value, timestamp, valid_till);
+        FTY_METRIC_COMPOSITE_TRACE2 (cache_update, input.topic.c_str (), (int64_t) valid_till);
+        changed++;
+    }
+    return changed;
+}
 
-    for (char c: notregex) {
-        if (strchr (to_be_escaped,c)) {
-            result += '\\';
+//  Publish metrics produced by the evaluation to shm
+static void
+s_publish (const std::vector <composite_output_t> &outputs, composite_stats_t *stats, const char *name)
+{
+    for (const auto &output : outputs) {
+        const char *output_topic = output.topic.c_str ();
+        const char *at = strrchr (output_topic, '@');
+        if (at == NULL) {
+            FTY_METRIC_COMPOSITE_TRACE2 (invalid_topic, name, output_topic);
+            log_error ("Invalid output topic '%s'", output_topic);
+            continue;
+        }
+        int64_t started = zclock_usecs ();
+        fty_proto_t *n_met = fty_proto_new(FTY_PROTO_METRIC);
+        log_debug ("Creating new bios proto message");
+        fty_proto_set_name (n_met, "%s", at + 1);
+        fty_proto_set_type(n_met, "%.*s", (int) (at - output_topic), output_topic);
+        fty_proto_set_value(n_met, "%.2f", output.value);
+        fty_proto_set_unit(n_met,  "%s", output.unit.c_str ());
+        fty_proto_set_ttl(n_met,  TTL);
+        fty_proto_set_time(n_met, std::time (NULL));
+        FTY_METRIC_COMPOSITE_TRACE1 (shm_write, output_topic);
+        int rv = fty::shm::write_metric(n_met);
+        FTY_METRIC_COMPOSITE_TRACE2 (shm_write_done, output_topic, rv);
+        if (rv != 0) {
+            composite_stats_count (stats, COMPOSITE_STATS_SHM_FAILURES);
+            log_error ("shm publish failed.");
+        }
+        else {
+            composite_stats_published (stats, output_topic);
         }
-        result += c;
+        fty_proto_destroy(&n_met);
+        composite_stats_record (stats, COMPOSITE_STATS_PUBLISH, zclock_usecs () - started);
+    }
+}
+
+//  Thread evaluating one part of the graph
+typedef struct {
+    zactor_t *actor;
+    composite_graph_t *graph;
+    metric_ring_t *ring;
+    std::vector <std::string> topics;       // input index of the records -> topic
+    composite_stats_t *stats;               // evaluations and publications of the thread
+    std::atomic <bool> waiting;             // thread is about to sleep, needs WAKE
+    const char *name;
+} shard_t;
+
+//  Records the shard thread takes from the ring at once
+#define SHARD_BATCH         64
+#define SHARD_RING_SIZE     4096
+
+static void
+s_shard_actor (zsock_t *pipe, void *args)
+{
+    shard_t *shard = (shard_t *) args;
+    zpoller_t *poller = zpoller_new (pipe, NULL);
+    metric_record_t records [SHARD_BATCH];
+    std::vector <composite_output_t> outputs;
+    zsock_signal (pipe, 0);
+
+    while (!zsys_interrupted) {
+        size_t count = metric_ring_pop (shard->ring, records, SHARD_BATCH);
+        int64_t started = zclock_usecs ();
+        outputs.clear ();
+        size_t evaluations = 0;
+        if (count > 0) {
+            for (size_t i = 0; i < count; i++) {
+                const metric_record_t &record = records [i];
+                composite_graph_update (shard->graph, shard->topics [record.input], record.value, record.timestamp, record.valid_till);
+            }
+            evaluations += composite_graph_evaluate (shard->graph, time (NULL), TTL, outputs, shard->stats);
+        }
+        evaluations += composite_graph_tick (shard->graph, zclock_mono (), time (NULL), TTL, outputs, shard->stats);
+        if (evaluations > 0) {
+            composite_stats_record (shard->stats, COMPOSITE_STATS_EVALUATE, zclock_usecs () - started);
+            s_publish (outputs, shard->stats, shard->name);
+        }
+        if (count > 0)
+            continue;
+
+        // announce the sleep first, a record pushed meanwhile is seen below
+        shard->waiting = true;
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        if (metric_ring_size (shard->ring) > 0) {
+            shard->waiting = false;
+            continue;
+        }
+        void *which = zpoller_wait (poller, (int) composite_graph_timeout (shard->graph, zclock_mono ()));
+        shard->waiting = false;
+        if (which != pipe)
+            continue;
+        char *command = NULL;
+        void *target = NULL;
+        if (zsock_recv (pipe, "sp", &command, &target) != 0)
+            continue;
+        if (streq (command, "$TERM")) {
+            zstr_free (&command);
+            break;
+        }
+        else
+        if (streq (command, "STATS")) {
+            composite_stats_merge ((composite_stats_t *) target, shard->stats);
+            zsock_signal (pipe, 0);
+        }
+        // WAKE needs nothing more
+        zstr_free (&command);
+    }
+    zpoller_destroy (&poller);
+}
+
+//  Split the graph among new shard threads, fill routes topic -> (shard, input index)
+static void
+s_shards_start (composite_graph_t *graph, size_t count, const char *name,
+                std::vector <shard_t *> &shards, std::unordered_map <std::string, std::pair <size_t, uint32_t>> &routes)
+{
+    for (auto part : composite_graph_split (graph, count)) {
+        shard_t *shard = new shard_t ();
+        shard->graph = part;
+        shard->ring = metric_ring_new (SHARD_RING_SIZE);
+        shard->stats = composite_stats_new ();
+        shard->waiting = false;
+        shard->name = name;
+        for (size_t i = 0; i < composite_graph_size (part); i++) {
+            for (const auto &topic : composite_evaluator_inputs (composite_graph_at (part, i))) {
+                if (composite_graph_produces (part, topic) || routes.count (topic))
+                    continue;
+                routes [topic] = std::make_pair (shards.size (), (uint32_t) shard->topics.size ());
+                shard->topics.push_back (topic);
+            }
+        }
+        shard->actor = zactor_new (s_shard_actor, shard);
+        shards.push_back (shard);
+    }
+    log_info ("%s:\tEvaluating in %zu threads", name, shards.size ());
+}
+
+//  Stop shard threads, join their graphs back and keep their statistics
+static void
+s_shards_stop (composite_graph_t *graph, composite_stats_t *stats,
+               std::vector <shard_t *> &shards, std::unordered_map <std::string, std::pair <size_t, uint32_t>> &routes)
+{
+    for (auto shard : shards) {
+        zactor_destroy (&shard->actor);
+        // records left in the ring are lost, as they would be in a full ring
+        composite_stats_merge (stats, shard->stats);
+        composite_stats_destroy (&shard->stats);
+        int rv = composite_graph_join (graph, &shard->graph);
+        assert (rv == 0);   // parts of one acyclic graph
+        metric_ring_destroy (&shard->ring);
+        delete shard;
+    }
+    shards.clear ();
+    routes.clear ();
+}
+
+//  Connect the client to the broker, retry with exponential backoff and random
+//  jitter. The client is recreated after a failed attempt and replaced in the
+//  poller. Waiting ends early when a command ($TERM) arrives on the pipe.
+//  0 - success, -1 - attempts exhausted or interrupted
+static int
+s_connect (mlm_client_t **client_p, zpoller_t *poller, zsock_t *pipe,
+           const char *endpoint, const char *name, int attempts)
+{
+    // agents started in the same second must not share the jitter
+    unsigned int seed = (unsigned int) (getpid () ^ zclock_usecs ());
+    int backoff = CONNECT_BACKOFF;
+    for (int attempt = 1; ; attempt++) {
+        if (mlm_client_connect (*client_p, endpoint, CONNECT_TIMEOUT, name) == 0)
+            return 0;
+        if (attempt >= attempts || zsys_interrupted)
+            return -1;
+        int delay = backoff / 2 + rand_r (&seed) % (backoff / 2 + 1);
+        log_warning ("%s:\tCannot connect to '%s' (attempt %d of %d), next attempt in %d ms",
+            name, endpoint, attempt, attempts, delay);
+        zpoller_remove (poller, mlm_client_msgpipe (*client_p));
+        mlm_client_destroy (client_p);
+        *client_p = mlm_client_new ();
+        zpoller_add (poller, mlm_client_msgpipe (*client_p));
+        zmq_pollitem_t item = { zsock_resolve (pipe), 0, ZMQ_POLLIN, 0 };
+        if (zmq_poll (&item, 1, delay) != 0)
+            return -1;
+        backoff = std::min (backoff * 2, CONNECT_BACKOFF_MAX);
     }
-    return result;
 }
 
 void
 fty_metric_composite_server (zsock_t *pipe, void* args) {
-    static const uint64_t TTL = 5*60;
-    std::map<std::string, value> cache;
-    std::string lua_code;
     int phase = 0;
+    composite_stats_t *stats = composite_stats_new ();
 
     char *name = strdup ((char*) args);
+    composite_graph_t *graph = composite_graph_new ();
+    std::vector <composite_output_t> outputs;
+    int64_t shm_poll = 0;               // ms, 0 - inputs come from malamute
+    int64_t shm_due = 0;
+    std::vector <shm_input_t> shm_inputs;
+    size_t shard_count = 0;             // 0, 1 - evaluation in the actor
+    std::vector <shard_t *> shards;
+    std::unordered_map <std::string, std::pair <size_t, uint32_t>> routes;
+    input_snapshot_t *snapshot = NULL;
+    std::set <std::string> subscribed;  // on malamute, never unsubscribed
 
     mlm_client_t *client = mlm_client_new ();
 
@@ -81,7 +350,36 @@ fty_metric_composite_server (zsock_t *pipe, void* args) {
 
     while (!zsys_interrupted) {
 
-        void *which = zpoller_wait (poller, -1);
+        int64_t mono = zclock_mono ();
+        int64_t timeout = composite_graph_timeout (graph, mono);
+        if (shm_poll > 0 && !shm_inputs.empty ()) {
+            int64_t remaining = shm_due > mono ? shm_due - mono : 0;
+            if (timeout < 0 || remaining < timeout)
+                timeout = remaining;
+        }
+        void *which = zpoller_wait (poller, (int) timeout);
+        if (which == NULL && zpoller_expired (poller)) {
+            int64_t started = zclock_usecs ();
+            outputs.clear ();
+            size_t evaluations = 0;
+            mono = zclock_mono ();
+            if (shm_poll > 0 && !shm_inputs.empty () && shm_due <= mono) {
+                shm_due = mono + shm_poll;
+                if (s_poll_shm (shm_inputs, graph, stats) > 0) {
+                    started = zclock_usecs ();
+                    evaluations += composite_graph_evaluate (graph, time (NULL), TTL, outputs, stats);
+                }
+            }
+            // periodic evaluations
+            evaluations += composite_graph_tick (graph, mono, time (NULL), TTL, outputs, stats);
+            if (evaluations > 0) {
+                composite_stats_record (stats, COMPOSITE_STATS_EVALUATE, zclock_usecs () - started);
+                s_publish (outputs, stats, name);
+            }
+            continue;
+        }
+        if (which == NULL)
+            continue;   // interrupted
         if (which == pipe) {
             zmsg_t *msg = zmsg_recv (pipe);
             char *cmd = zmsg_popstr (msg);
@@ -96,57 +394,166 @@ fty_metric_composite_server (zsock_t *pipe, void* args) {
             else
             if (streq (cmd, "CONNECT")) {
                 char* endpoint = zmsg_popstr (msg);
-                mlm_client_connect(client, endpoint, 1000, name);
-                int rv = mlm_client_set_producer(client, "METRICS");
-                if (rv == -1) {
-                    log_error ("mlm_client_set_producer () failed.");
+                char *attempts = zmsg_popstr (msg);
+                const char *error = NULL;
+                if (!endpoint)
+                    error = "missing endpoint";
+                else
+                if (s_connect (&client, poller, pipe, endpoint, name,
+                               attempts ? atoi (attempts) : CONNECT_ATTEMPTS) != 0)
+                    error = "cannot connect to the broker";
+                else
+                if (mlm_client_set_producer (client, "METRICS") == -1)
+                    error = "mlm_client_set_producer () failed";
+                if (error) {
+                    log_error ("%s:\t%s", name, error);
+                    zstr_sendx (pipe, "CONNECT", "ERROR", error, NULL);
                 }
+                else {
+                    zstr_sendx (pipe, "CONNECT", "OK", NULL);
+                    phase = 1;
+                }
+                zstr_free (&attempts);
                 zstr_free(&endpoint);
-                phase = 1;
+            }
+            else
+            if (streq (cmd, "SHM")) {
+                char *interval = zmsg_popstr (msg);
+                shm_poll = interval ? atoll (interval) : 0;
+                if (shm_poll < 0)
+                    shm_poll = 0;
+                shm_due = zclock_mono ();
+                log_info ("%s:\tInputs are %s", name, shm_poll ? "polled from shm" : "received from malamute");
+                zstr_free (&interval);
+            }
+            else
+            if (streq (cmd, "SHARDS")) {
+                char *count = zmsg_popstr (msg);
+                s_shards_stop (graph, stats, shards, routes);
+                shard_count = count ? (size_t) atol (count) : 0;
+                zstr_free (&count);
+            }
+            else
+            if (streq (cmd, "SNAPSHOT")) {
+                char *path = zmsg_popstr (msg);
+                input_snapshot_destroy (&snapshot);
+                if (path && *path) {
+                    snapshot = input_snapshot_open (path, time (NULL));
+                    if (snapshot) {
+                        s_shards_stop (graph, stats, shards, routes);
+                        size_t restored = input_snapshot_restore (snapshot, graph, time (NULL));
+                        log_info ("%s:\tLast values of inputs are kept in '%s', %zu restored", name, path, restored);
+                    }
+                }
+                zstr_free (&path);
+            }
+            else
+            if (streq (cmd, "STATS")) {
+                composite_stats_t *all = stats;
+                if (!shards.empty ()) {
+                    all = composite_stats_new ();
+                    composite_stats_merge (all, stats);
+                    for (auto shard : shards) {
+                        zsock_send (shard->actor, "sp", "STATS", all);
+                        zsock_wait (shard->actor);
+                    }
+                }
+                zmsg_t *reply = composite_stats_encode (all);
+                if (reply)
+                    zmsg_send (&reply, pipe);
+                if (all != stats)
+                    composite_stats_destroy (&all);
             }
             else
             if (streq (cmd, "CONFIG")) {
-                if(phase < 1) {
+                if(phase < 1 && shm_poll == 0) {
                     log_error("CONFIG before CONNECT");
+                    zstr_sendx (pipe, "CONFIG", "ERROR", "CONFIG before CONNECT", NULL);
+                    zstr_free (&cmd);
+                    zmsg_destroy (&msg);
                     continue;
                 }
+                // the new configuration may connect parts of the graph
+                s_shards_stop (graph, stats, shards, routes);
                 char* filename = zmsg_popstr (msg);
+                if (!filename) {
+                    zstr_sendx (pipe, "CONFIG", "ERROR", "missing file name", NULL);
+                    zstr_free (&cmd);
+                    zmsg_destroy (&msg);
+                    continue;
+                }
                 log_trace ("%s:\tOpening '%s'", name, filename);
-                std::ifstream f(filename);
-                if ( !f.good() ) {
-                    log_error ("%s:\tCannot open config file '%s' correctly", name, filename);
+                // one configuration or all composites of a manifest
+                std::vector <composite_evaluator_t *> loaded;
+                int rv = composite_evaluator_load_source (filename, loaded);
+                if (rv != 0
+                ||  composite_graph_reload (graph, filename, loaded) != 0) {
+                    // refused, configurations loaded before keep running
+                    for (auto &evaluator : loaded)
+                        composite_evaluator_destroy (&evaluator);
+                    char *error = zsys_sprintf ("cannot load '%s'", filename);
+                    log_error ("%s:\t%s", name, error);
+                    zstr_sendx (pipe, "CONFIG", "ERROR", error, NULL);
+                    zstr_free (&error);
                     zstr_free (&filename);
                     zstr_free (&cmd);
                     zmsg_destroy (&msg);
-                    break; // if we cannot open config file -> just exit!
+                    continue;
                 }
-                try {
-                    cxxtools::JsonDeserializer json(f);
-                    json.deserialize();
-                    const cxxtools::SerializationInfo *si = json.si();
-                    si->getMember("evaluation") >>= lua_code;
-
-                    // Subscribe to all streams, create expired values in cache
-                    value expired;
-                    expired.valid_till = 0;
-                    for(auto it : si->getMember("in")) {
-                        std::string buff;
-                        it >>= buff;
-                        cache[buff] = expired;
-                        buff = "^" + escape_regex (buff) + "$";
-                        mlm_client_set_consumer(client, "_METRICS_SENSOR", buff.c_str());
-                        log_trace ("%s: Registered to receive '%s' from stream '%s'", name, buff.c_str(), "_METRICS_SENSOR");
+                // Subscribe to all streams, outputs of other composites are passed in memory;
+                // the whole graph is walked, a reload may remove the producer of an input
+                // or an input, or turn an input into an output of another composite
+                std::set <std::string> external;
+                for (size_t i = 0; i < composite_graph_size (graph); i++) {
+                    for (const auto &topic : composite_evaluator_inputs (composite_graph_at (graph, i))) {
+                        if (!composite_graph_produces (graph, topic))
+                            external.insert (topic);
                     }
-                    zstr_free (&filename);
-                    phase = 2;
                 }
-                catch ( const std::exception &e ) {
-                    log_error ("Cannot deserialize cfg file! with '%s'", e.what());
-                    zstr_free (&filename);
-                    zstr_free (&cmd);
-                    zmsg_destroy (&msg);
-                    break; // if we cannot load config file -> just exit!
+                std::vector <std::string> topics;
+                if (shm_poll > 0) {
+                    // only inputs still needed are polled, with the last timestamp seen kept
+                    std::map <std::string, uint64_t> seen;
+                    for (const auto &input : shm_inputs)
+                        seen [input.topic] = input.timestamp;
+                    shm_inputs.clear ();
+                    for (const auto &topic : external) {
+                        size_t at = topic.rfind ('@');
+                        if (at == std::string::npos) {
+                            log_error ("%s:\tInput '%s' is not <type>@<asset>, cannot read it from shm", name, topic.c_str ());
+                            continue;
+                        }
+                        auto it = seen.find (topic);
+                        shm_input_t input = {topic, topic.substr (0, at), topic.substr (at + 1), it == seen.end () ? 0 : it->second};
+                        shm_inputs.push_back (input);
+                    }
                 }
+                else {
+                    // malamute cannot unsubscribe, messages of inputs not needed anymore are dropped
+                    for (const auto &topic : external) {
+                        if (subscribed.insert (topic).second)
+                            topics.push_back (topic);
+                    }
+                }
+                // one round trip and one broker regex per pattern, not per input
+                int64_t started = zclock_usecs ();
+                std::vector <std::string> patterns = subscription_patterns_build (topics, SUBSCRIPTION_PATTERNS_MAX_LENGTH);
+                for (const auto &pattern : patterns) {
+                    mlm_client_set_consumer(client, "_METRICS_SENSOR", pattern.c_str());
+                    log_trace ("%s: Registered to receive '%s' from stream '%s'", name, pattern.c_str(), "_METRICS_SENSOR");
+                }
+                if (!topics.empty ())
+                    log_debug ("%s: Subscribed to %zu inputs with %zu patterns in %" PRIi64 " us",
+                        name, topics.size (), patterns.size (), zclock_usecs () - started);
+                // values of the previous run of the agent
+                if (snapshot) {
+                    size_t restored = input_snapshot_restore (snapshot, graph, time (NULL));
+                    if (restored > 0)
+                        log_info ("%s:\tRestored %zu inputs of '%s' from snapshot", name, restored, filename);
+                }
+                zstr_free (&filename);
+                phase = 2;
+                zstr_sendx (pipe, "CONFIG", "OK", NULL);
             }
             zstr_free (&cmd);
             zmsg_destroy (&msg);
@@ -162,90 +569,120 @@ fty_metric_composite_server (zsock_t *pipe, void* args) {
         zmsg_t *msg = mlm_client_recv(client);
         if(msg == NULL)
             continue;
-        fty_proto_t *yn = fty_proto_decode(&msg);
-        if(yn == NULL)
-            continue;
+        FTY_METRIC_COMPOSITE_TRACE2 (receive, name, mlm_client_subject (client));
+        int64_t started = zclock_usecs ();
+        // only time, ttl and value are needed, full decoding is the fallback
+        proto_metric_values_t values;
+        if (proto_metric_decode (msg, &values) == 0)
+            zmsg_destroy (&msg);
+        else {
+            fty_proto_t *yn = fty_proto_decode(&msg);
+            if(yn == NULL) {
+                FTY_METRIC_COMPOSITE_TRACE2 (decode_error, name, mlm_client_subject (client));
+                continue;
+            }
+            values.value = atof(fty_proto_value(yn));
+            values.ttl = fty_proto_ttl(yn);
+            values.time = fty_proto_time (yn);
+            fty_proto_destroy(&yn);
+        }
 
         // Update cache with updated values
         std::string topic = mlm_client_subject(client);
-        value val;
-        val.value = atof(fty_proto_value(yn));
-        uint32_t ttl = fty_proto_ttl(yn);
-        uint64_t timestamp = fty_proto_time (yn);
-        val.valid_till = timestamp + ttl;
-        log_trace ("%s: Got message '%s' with value %lf", name, topic.c_str(), val.value);
-        auto f = cache.find(topic);
-        if(f != cache.end()) {
-            f->second = val;
-        } else {
-            cache.insert(std::make_pair(topic, val));
-        }
-        fty_proto_destroy(&yn);
-
-        // Prepare data for computation
-#if LUA_VERSION_NUM > 501
-        lua_State *L = luaL_newstate();
-#else
-        lua_State *L = lua_open();
-#endif
-        luaL_openlibs(L);
-        lua_newtable(L);
-        time_t tme = time(NULL);
-        int error;
-        for(auto i : cache) {
-            if(tme > i.second.valid_till) {
-                // can't count average, missing measurements from sensor
+        double value = values.value;
+        uint64_t timestamp = values.time;
+        time_t valid_till = timestamp + values.ttl;
+        FTY_METRIC_COMPOSITE_TRACE2 (decode, topic.c_str (), zclock_usecs () - started);
+        composite_stats_record (stats, COMPOSITE_STATS_DECODE, zclock_usecs () - started);
+        composite_stats_received (stats, topic.c_str ());
+        log_trace ("%s: Got message '%s' with value %lf", name, topic.c_str(), value);
+        if (shard_count > 1 && shm_poll == 0) {
+            if (shards.empty ())
+                s_shards_start (graph, shard_count, name, shards, routes);
+            auto route = routes.find (topic);
+            if (route == routes.end ()) {
+                FTY_METRIC_COMPOSITE_TRACE1 (drop, topic.c_str ());
+                composite_stats_count (stats, COMPOSITE_STATS_DROPPED);
+                log_debug ("%s: Dropped message '%s', topic is not configured", name, topic.c_str());
                 continue;
             }
-            log_trace ("%s - %s, %f", name, i.first.c_str(), i.second.value);
-            lua_pushstring(L, i.first.c_str());
-            lua_pushnumber(L, i.second.value);
-            lua_settable(L, -3);
-        }
-        lua_setglobal(L, "mt");
-
-        // Do the real processing
-        error = luaL_loadbuffer(L, lua_code.c_str(), lua_code.length(), "line") ||
-            lua_pcall(L, 0, 3, 0);
-        if(error) {
-            log_error("%s", lua_tostring(L, -1));
-            goto next_iter;
-        }
-        log_trace ("%s: Total: %d", name, lua_gettop(L));
-        if(lua_gettop(L) == 3) {
-            if(strrchr(lua_tostring(L, -3), '@') == NULL) {
-                log_error ("Invalid output topic");
-                goto next_iter;
-            }
-            fty_proto_t *n_met = fty_proto_new(FTY_PROTO_METRIC);
-            log_debug ("Creating new bios proto message");
-            char *buff = strdup(lua_tostring(L, -3));
-            fty_proto_set_name (n_met, "%s", strrchr(buff, '@') + 1);
-            (*strrchr(buff, '@')) = 0;
-            fty_proto_set_type(n_met, "%s", buff);
-            fty_proto_set_value(n_met, "%.2f", lua_tonumber(L, -2));
-            fty_proto_set_unit(n_met,  "%s", lua_tostring(L, -1));
-            fty_proto_set_ttl(n_met,  TTL);
-            fty_proto_set_time(n_met, std::time (NULL));
-            int rv = fty::shm::write_metric(n_met);
-            if (rv != 0) {
-                log_error ("shm publish failed.");
+            shard_t *shard = shards [route->second.first];
+            metric_record_t record = {route->second.second, value, (time_t) timestamp, valid_till};
+            if (!metric_ring_push (shard->ring, &record)) {
+                composite_stats_count (stats, COMPOSITE_STATS_RING_FULL);
+                log_debug ("%s: Lost message '%s', evaluating thread is busy", name, topic.c_str());
+                continue;
             }
-            fty_proto_destroy(&n_met);
-            free (buff);
-        } else {
-            log_error ("Not enough valid data...\n");
+            if (snapshot)
+                input_snapshot_store (snapshot, topic, value, (time_t) timestamp, valid_till);
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            if (shard->waiting.exchange (false))
+                zstr_send (shard->actor, "WAKE");
+            continue;
+        }
+        if (composite_graph_produces (graph, topic)
+        ||  !composite_graph_update (graph, topic, value, timestamp, valid_till)) {
+            // not one of our inputs or produced by a composite in memory (a subscription
+            // left from a previous configuration), it must not take part in the evaluation
+            FTY_METRIC_COMPOSITE_TRACE1 (drop, topic.c_str ());
+            composite_stats_count (stats, COMPOSITE_STATS_DROPPED);
+            log_debug ("%s: Dropped message '%s', topic is not configured", name, topic.c_str());
+            continue;
         }
-next_iter:
-        lua_close(L);
+        FTY_METRIC_COMPOSITE_TRACE2 (cache_update, topic.c_str (), (int64_t) valid_till);
+        if (snapshot)
+            input_snapshot_store (snapshot, topic, value, (time_t) timestamp, valid_till);
+        started = zclock_usecs ();
+
+        // Do the real processing, composites consuming outputs of others are evaluated too
+        outputs.clear ();
+        composite_graph_evaluate (graph, time (NULL), TTL, outputs, stats);
+        composite_stats_record (stats, COMPOSITE_STATS_EVALUATE, zclock_usecs () - started);
+        s_publish (outputs, stats, name);
     }
 
 exit:
+    s_shards_stop (graph, stats, shards, routes);
+    input_snapshot_destroy (&snapshot);
+    composite_graph_destroy (&graph);
+    composite_stats_destroy (&stats);
     free (name);
     zpoller_destroy (&poller);
     mlm_client_destroy (&client);
 }
 
+//  ---------------------------------------------------------------------------
+//  Wait for the reply of the actor to CONNECT or CONFIG, log the reason of an error
+//  0 - OK, -1 - ERROR or interrupted
+
+int
+fty_metric_composite_server_wait (zactor_t *self, const char *command)
+{
+    assert (self);
+    assert (command);
+    zmsg_t *reply = zmsg_recv (self);
+    if (!reply)
+        return -1;  // interrupted
+    char *part = zmsg_popstr (reply);
+    char *status = zmsg_popstr (reply);
+    char *reason = zmsg_popstr (reply);
+    int rv = 0;
+    if (!part || !streq (part, command)) {
+        log_error ("%s:\tunexpected reply '%s'", command, part ? part : "");
+        rv = -1;
+    }
+    else
+    if (!status || !streq (status, "OK")) {
+        log_error ("%s:\t%s", command, reason ? reason : "failed");
+        rv = -1;
+    }
+    zstr_free (&reason);
+    zstr_free (&status);
+    zstr_free (&part);
+    zmsg_destroy (&reply);
+    return rv;
+}
+
 //  ---------------------------------------------------------------------------
 //  Selftest
 
@@ -286,10 +723,26 @@ fty_metric_composite_server_test (bool verbose)
     zactor_t *cm_server = zactor_new (fty_metric_composite_server, (void*) name);
     free(name);
     zstr_sendx (cm_server, "CONNECT", endpoint, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONNECT") == 0);
     char *test_config_file = zsys_sprintf ("%s/fty-metric-composite.cfg.example", SELFTEST_DIR_RO);
     assert (test_config_file != NULL);
     zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
-    zclock_sleep (500);   //THIS IS A HACK TO SETTLE DOWN THINGS
+    assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == 0);
+    zstr_free (&test_config_file);
+    // second composite consumes output of the first one in memory
+    test_config_file = zsys_sprintf ("%s/fty-metric-composite-row.cfg", SELFTEST_DIR_RW);
+    assert (test_config_file != NULL);
+    {
+        FILE *file = fopen (test_config_file, "w");
+        assert (file);
+        fputs ("{ \"in\" : [ \"average.temperature@world\" ],\n"
+               "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@row1\", \"unit\" : \"C\" } ] }\n",
+               file);
+        fclose (file);
+    }
+    zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == 0);
+    unlink (test_config_file);
     zstr_free (&test_config_file);
 
     // send one value
@@ -347,10 +800,291 @@ fty_metric_composite_server_test (bool verbose)
       m = resultT.get(0);
       assert (m);
       assert (streq (fty_proto_value (m), "85.00"));     // <<< (100 + 70) / 2
+      fty::shm::shmMetrics resultR;
+      fty::shm::read_metrics("row1", ".*temperature", resultR);
+      assert (resultR.size () == 1);
+      assert (streq (fty_proto_value (resultR.get (0)), "85.00"));
       fty_shm_delete_test_dir();
       m = NULL;
     }
 
+    // statistics
+    zstr_sendx (cm_server, "STATS", NULL);
+    zmsg_t *reply = zmsg_recv (cm_server);
+    assert (reply);
+    char *part = zmsg_popstr (reply);
+    assert (streq (part, "STATS"));
+    zstr_free (&part);
+    bool seen_th1 = false;
+    char *key = zmsg_popstr (reply);
+    while (key) {
+        char *value = zmsg_popstr (reply);
+        assert (value);
+        if (verbose)
+            log_debug ("%s = %s", key, value);
+        if (streq (key, "received"))
+            assert (streq (value, "3"));
+        if (streq (key, "received.temperature@TH1")) {
+            assert (streq (value, "2"));
+            seen_th1 = true;
+        }
+        if (streq (key, "evaluations"))
+            assert (streq (value, "6"));    // world and row1 for each message
+        if (streq (key, "dropped") || streq (key, "lua_errors"))
+            assert (streq (value, "0"));
+        if (streq (key, "decode_us.count") || streq (key, "evaluate_us.count"))
+            assert (streq (value, "3"));
+        zstr_free (&value);
+        zstr_free (&key);
+        key = zmsg_popstr (reply);
+    }
+    assert (seen_th1);
+    zmsg_destroy (&reply);
+    zactor_destroy (&cm_server);
+
+    // failures are answered, the actor keeps running
+    cm_server = zactor_new (fty_metric_composite_server, (void*) "composite-metrics-errors");
+    test_config_file = zsys_sprintf ("%s/fty-metric-composite.cfg.example", SELFTEST_DIR_RO);
+    zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == -1);     // before CONNECT
+    int64_t connect_started = zclock_mono ();
+    zstr_sendx (cm_server, "CONNECT", "inproc://bios-cm-server-test-nobody", "2", NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONNECT") == -1);
+    assert (zclock_mono () - connect_started >= 2000);  // two attempts and one backoff
+    zstr_sendx (cm_server, "CONNECT", endpoint, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONNECT") == 0);
+    zstr_sendx (cm_server, "CONFIG", "/nonexistent/fty-metric-composite.cfg", NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == -1);
+    zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == 0);
+    zstr_free (&test_config_file);
+    zactor_destroy (&cm_server);
+
+    // independent composites evaluated by two threads
+    fty_shm_set_test_dir(SELFTEST_DIR_RW);
+    cm_server = zactor_new (fty_metric_composite_server, (void*) "composite-metrics-shards");
+    zstr_sendx (cm_server, "CONNECT", endpoint, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONNECT") == 0);
+    zstr_sendx (cm_server, "SHARDS", "2", NULL);
+    test_config_file = zsys_sprintf ("%s/fty-metric-composite.cfg.example", SELFTEST_DIR_RO);
+    zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == 0);
+    zstr_free (&test_config_file);
+    test_config_file = zsys_sprintf ("%s/fty-metric-composite-rack9.cfg", SELFTEST_DIR_RW);
+    {
+        FILE *file = fopen (test_config_file, "w");
+        assert (file);
+        fputs ("{ \"in\" : [ \"temperature@TH9\" ],\n"
+               "  \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@rack9\", \"unit\" : \"C\" } ] }\n",
+               file);
+        fclose (file);
+    }
+    zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == 0);
+    unlink (test_config_file);
+    zstr_free (&test_config_file);
+    msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH1", "40", "C");
+    mlm_client_send (producer, "temperature@TH1", &msg_in);
+    msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH9", "33", "C");
+    mlm_client_send (producer, "temperature@TH9", &msg_in);
+    sleep(1);
+    {
+      fty::shm::shmMetrics resultT;
+      fty::shm::read_metrics("world", ".*temperature", resultT);
+      assert (resultT.size () == 1);
+      assert (streq (fty_proto_value (resultT.get (0)), "40.00"));
+      fty::shm::shmMetrics resultR;
+      fty::shm::read_metrics("rack9", ".*temperature", resultR);
+      assert (resultR.size () == 1);
+      assert (streq (fty_proto_value (resultR.get (0)), "33.00"));
+    }
+    // statistics of the threads are included
+    zstr_sendx (cm_server, "STATS", NULL);
+    reply = zmsg_recv (cm_server);
+    assert (reply);
+    part = zmsg_popstr (reply);
+    assert (streq (part, "STATS"));
+    zstr_free (&part);
+    key = zmsg_popstr (reply);
+    while (key) {
+        char *value = zmsg_popstr (reply);
+        if (streq (key, "evaluations") || streq (key, "received"))
+            assert (streq (value, "2"));
+        if (streq (key, "dropped") || streq (key, "ring_full"))
+            assert (streq (value, "0"));
+        zstr_free (&value);
+        zstr_free (&key);
+        key = zmsg_popstr (reply);
+    }
+    zmsg_destroy (&reply);
+    fty_shm_delete_test_dir();
+    zactor_destroy (&cm_server);
+
+    // warm restart: the second actor knows TH2 from the snapshot of the first
+    char *snapshot_file = zsys_sprintf ("%s/fty-metric-composite-server.snapshot", SELFTEST_DIR_RW);
+    unlink (snapshot_file);
+    for (int run = 0; run < 2; run++) {
+        fty_shm_set_test_dir(SELFTEST_DIR_RW);
+        cm_server = zactor_new (fty_metric_composite_server, (void*) "composite-metrics-snapshot");
+        zstr_sendx (cm_server, "CONNECT", endpoint, NULL);
+        assert (fty_metric_composite_server_wait (cm_server, "CONNECT") == 0);
+        zstr_sendx (cm_server, "SNAPSHOT", snapshot_file, NULL);
+        test_config_file = zsys_sprintf ("%s/fty-metric-composite.cfg.example", SELFTEST_DIR_RO);
+        zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+        assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == 0);
+        zstr_free (&test_config_file);
+        if (run == 0)
+            msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH2", "100", "C");
+        else
+            msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH1", "40", "C");
+        mlm_client_send (producer, run == 0 ? "temperature@TH2" : "temperature@TH1", &msg_in);
+        sleep(1);
+        {
+          fty::shm::shmMetrics resultT;
+          fty::shm::read_metrics("world", ".*temperature", resultT);
+          assert (resultT.size () == 1);
+          assert (streq (fty_proto_value (resultT.get (0)), run == 0 ? "100.00" : "70.00"));   // <<< (100 + 40) / 2
+        }
+        fty_shm_delete_test_dir();
+        zactor_destroy (&cm_server);
+    }
+    unlink (snapshot_file);
+    zstr_free (&snapshot_file);
+
+    // reload keeps values of the inputs which stay, subscribes only the new ones
+    fty_shm_set_test_dir(SELFTEST_DIR_RW);
+    cm_server = zactor_new (fty_metric_composite_server, (void*) "composite-metrics-reload");
+    zstr_sendx (cm_server, "CONNECT", endpoint, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONNECT") == 0);
+    test_config_file = zsys_sprintf ("%s/fty-metric-composite-reload.cfg", SELFTEST_DIR_RW);
+    const char *reload_configs [] = {
+        "{ \"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@reload\", \"unit\" : \"C\" } ] }\n",
+        "{ \"in\" : [ \"temperature@TH1\", \"temperature@TH2\", \"temperature@TH3\" ],\n"
+        "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@reload\", \"unit\" : \"C\" } ] }\n",
+        "{ \"in\" : "     // broken, the previous configuration keeps running
+    };
+    for (int run = 0; run < 3; run++) {
+        FILE *file = fopen (test_config_file, "w");
+        assert (file);
+        fputs (reload_configs [run], file);
+        fclose (file);
+        zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+        assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == (run < 2 ? 0 : -1));
+        if (run == 0) {
+            msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH1", "40", "C");
+            mlm_client_send (producer, "temperature@TH1", &msg_in);
+            msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH2", "100", "C");
+            mlm_client_send (producer, "temperature@TH2", &msg_in);
+        }
+        else {
+            msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH3", run == 1 ? "10" : "40", "C");
+            mlm_client_send (producer, "temperature@TH3", &msg_in);
+        }
+        sleep(1);
+        fty::shm::shmMetrics resultT;
+        fty::shm::read_metrics("reload", ".*temperature", resultT);
+        assert (resultT.size () == 1);
+        assert (streq (fty_proto_value (resultT.get (0)), run == 0 ? "70.00" : run == 1 ? "50.00" : "60.00"));
+    }
+    unlink (test_config_file);
+    zstr_free (&test_config_file);
+    fty_shm_delete_test_dir();
+    zactor_destroy (&cm_server);
+
+    // manifest: all composites in one file, the next generation replaces them at once
+    fty_shm_set_test_dir(SELFTEST_DIR_RW);
+    cm_server = zactor_new (fty_metric_composite_server, (void*) "composite-metrics-manifest");
+    zstr_sendx (cm_server, "CONNECT", endpoint, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONNECT") == 0);
+    test_config_file = zsys_sprintf ("%s/fty-metric-composite-manifest.cfg", SELFTEST_DIR_RW);
+    const char *manifests [] = {
+        "{ \"manifest\" : 1, \"generation\" : 1, \"composites\" : {\n"
+        "  \"manifest-a\" : { \"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@manifest-a\", \"unit\" : \"C\" } ] },\n"
+        "  \"manifest-b\" : { \"in\" : [ \"temperature@TH3\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"max.temperature@manifest-b\", \"unit\" : \"C\" } ] } } }\n",
+        "{ \"manifest\" : 1, \"generation\" : 2, \"composites\" : {\n"
+        "  \"manifest-a\" : { \"in\" : [ \"temperature@TH1\", \"temperature@TH2\" ],\n"
+        "    \"reductions\" : [ { \"function\" : \"max\", \"topic\" : \"average.temperature@manifest-a\", \"unit\" : \"C\" } ] } } }\n"
+    };
+    for (int run = 0; run < 2; run++) {
+        FILE *file = fopen (test_config_file, "w");
+        assert (file);
+        fputs (manifests [run], file);
+        fclose (file);
+        zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+        assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == 0);
+        msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH1", "40", "C");
+        mlm_client_send (producer, "temperature@TH1", &msg_in);
+        if (run == 0) {
+            msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH2", "100", "C");
+            mlm_client_send (producer, "temperature@TH2", &msg_in);
+        }
+        // composite 'manifest-b' is gone in the second generation
+        msg_in = fty_proto_encode_metric (NULL, ::time (NULL), 60, "temperature", "TH3", run == 0 ? "10" : "30", "C");
+        mlm_client_send (producer, "temperature@TH3", &msg_in);
+        sleep(1);
+        fty::shm::shmMetrics resultA, resultB;
+        fty::shm::read_metrics("manifest-a", ".*temperature", resultA);
+        assert (resultA.size () == 1);
+        assert (streq (fty_proto_value (resultA.get (0)), run == 0 ? "70.00" : "100.00"));   // TH2 kept its value
+        fty::shm::read_metrics("manifest-b", ".*temperature", resultB);
+        assert (resultB.size () == 1);
+        assert (streq (fty_proto_value (resultB.get (0)), "10.00"));
+    }
+    unlink (test_config_file);
+    zstr_free (&test_config_file);
+    fty_shm_delete_test_dir();
+    zactor_destroy (&cm_server);
+
+    // inputs polled from shm, no malamute involved
+    fty_shm_set_test_dir(SELFTEST_DIR_RW);
+    const char *sensors [][2] = { {"TH1", "40"}, {"TH2", "60"} };
+    for (auto sensor : sensors) {
+        fty_proto_t *metric = fty_proto_new (FTY_PROTO_METRIC);
+        fty_proto_set_name (metric, "%s", sensor [0]);
+        fty_proto_set_type (metric, "temperature");
+        fty_proto_set_value (metric, "%s", sensor [1]);
+        fty_proto_set_unit (metric, "C");
+        fty_proto_set_ttl (metric, 60);
+        fty_proto_set_time (metric, ::time (NULL));
+        int rv = fty::shm::write_metric (metric);
+        assert (rv == 0);
+        fty_proto_destroy (&metric);
+    }
+    cm_server = zactor_new (fty_metric_composite_server, (void*) "composite-metrics-shm");
+    zstr_sendx (cm_server, "SHM", "100", NULL);
+    test_config_file = zsys_sprintf ("%s/fty-metric-composite.cfg.example", SELFTEST_DIR_RO);
+    zstr_sendx (cm_server, "CONFIG", test_config_file, NULL);
+    assert (fty_metric_composite_server_wait (cm_server, "CONFIG") == 0);
+    zstr_free (&test_config_file);
+    zclock_sleep (1000);
+    {
+      fty::shm::shmMetrics resultT;
+      fty::shm::read_metrics("world", ".*temperature", resultT);
+      assert (resultT.size () == 1);
+      assert (streq (fty_proto_value (resultT.get (0)), "50.00"));    // <<< (40 + 60) / 2
+    }
+    // unchanged values are passed only once
+    zstr_sendx (cm_server, "STATS", NULL);
+    reply = zmsg_recv (cm_server);
+    assert (reply);
+    part = zmsg_popstr (reply);
+    assert (streq (part, "STATS"));
+    zstr_free (&part);
+    key = zmsg_popstr (reply);
+    while (key) {
+        char *value = zmsg_popstr (reply);
+        if (streq (key, "received"))
+            assert (streq (value, "2"));
+        zstr_free (&value);
+        zstr_free (&key);
+        key = zmsg_popstr (reply);
+    }
+    zmsg_destroy (&reply);
+    fty_shm_delete_test_dir();
+
     zactor_destroy (&cm_server);
     mlm_client_destroy (&producer);
     zactor_destroy (&server);
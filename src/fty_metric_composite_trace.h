@@ -0,0 +1,61 @@
+/*  =========================================================================
+    fty_metric_composite_trace - static tracepoints (USDT probes)
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef FTY_METRIC_COMPOSITE_TRACE_H_INCLUDED
+#define FTY_METRIC_COMPOSITE_TRACE_H_INCLUDED
+
+//  Probes are placed into provider 'fty_metric_composite' and can be listed by
+//      perf list 'sdt_fty_metric_composite:*'
+//  or used directly, e.g.
+//      bpftrace -e 'usdt:./src/.libs/libfty_metric_composite.so:fty_metric_composite:lua_call_done
+//                   { @us = hist (arg1); }'
+//
+//  When sys/sdt.h (systemtap-sdt-dev) is not available at configure time, or
+//  when built with FTY_METRIC_COMPOSITE_NO_TRACE defined, every probe compiles
+//  to nothing. Arguments must be integers or pointers; strings are passed as
+//  'const char *'. An enabled, but unattached probe costs a single nop.
+
+#if defined (HAVE_SYS_SDT_H) && !defined (FTY_METRIC_COMPOSITE_NO_TRACE)
+#   include <sys/sdt.h>
+#   define FTY_METRIC_COMPOSITE_TRACE0(probe) \
+        DTRACE_PROBE (fty_metric_composite, probe)
+#   define FTY_METRIC_COMPOSITE_TRACE1(probe, a1) \
+        DTRACE_PROBE1 (fty_metric_composite, probe, a1)
+#   define FTY_METRIC_COMPOSITE_TRACE2(probe, a1, a2) \
+        DTRACE_PROBE2 (fty_metric_composite, probe, a1, a2)
+#   define FTY_METRIC_COMPOSITE_TRACE3(probe, a1, a2, a3) \
+        DTRACE_PROBE3 (fty_metric_composite, probe, a1, a2, a3)
+#   define FTY_METRIC_COMPOSITE_TRACE4(probe, a1, a2, a3, a4) \
+        DTRACE_PROBE4 (fty_metric_composite, probe, a1, a2, a3, a4)
+#else
+#   define FTY_METRIC_COMPOSITE_TRACE0(probe) \
+        do {} while (0)
+#   define FTY_METRIC_COMPOSITE_TRACE1(probe, a1) \
+        do {} while (0)
+#   define FTY_METRIC_COMPOSITE_TRACE2(probe, a1, a2) \
+        do {} while (0)
+#   define FTY_METRIC_COMPOSITE_TRACE3(probe, a1, a2, a3) \
+        do {} while (0)
+#   define FTY_METRIC_COMPOSITE_TRACE4(probe, a1, a2, a3, a4) \
+        do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,342 @@
+/*  =========================================================================
+    input_snapshot - mmap backed file of last values of inputs for warm restart
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+/*
+@header
+    input_snapshot - mmap backed file of last values of inputs for warm restart
+@discuss
+    A restarted evaluator starts with all inputs expired and would publish
+    averages of whichever sensor reports first until all have reported
+    again. The actor therefore keeps the last value, timestamp and validity
+    of every received input in a file mapped into memory: storing a value
+    is a few writes to its fixed-size record, and the page cache keeps the
+    file when the process ends, so no periodic checkpoint is needed.
+
+    The file has a header (magic, record size, capacity, count) followed by
+    records of the value, timestamp, valid_till and the nul terminated
+    topic. A new record is written before the count is increased, so a
+    process killed meanwhile leaves at most an unused record. The file
+    doubles when full.
+
+    Opening the file keeps the records still valid and compacts the file.
+    They are restored into the graph after each CONFIG, once per input, so
+    inputs of configurations added later get their values too. An input
+    received in the meantime is newer than the snapshot and is not restored.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC      "FTYCMPS1"
+#define SNAPSHOT_CAPACITY   64          // records of a new file
+
+typedef struct {
+    char magic [8];
+    uint32_t record_size;
+    uint32_t capacity;
+    uint64_t count;                     // records in use
+} snapshot_header_t;
+
+typedef struct {
+    double value;
+    int64_t timestamp;
+    int64_t valid_till;
+    char topic [INPUT_SNAPSHOT_TOPIC_MAX + 1];
+} snapshot_record_t;
+
+struct _input_snapshot_t {
+    int fd;
+    size_t size;                        // of the mapping
+    snapshot_header_t *header;          // start of the mapping
+    snapshot_record_t *records;
+    std::unordered_map <std::string, size_t> index;     // topic -> record
+    std::vector <bool> pending;         // record is from the previous process, not yet restored
+};
+
+//  Size the file for 'capacity' records and map it; 0 - success, -1 - error,
+//  then the previous mapping stays in place
+static int
+s_map (input_snapshot_t *self, size_t capacity)
+{
+    size_t size = sizeof (snapshot_header_t) + capacity * sizeof (snapshot_record_t);
+    if (ftruncate (self->fd, (off_t) size) != 0)
+        return -1;
+    void *map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+    if (map == MAP_FAILED) {
+        int error = errno;
+        if (self->header && ftruncate (self->fd, (off_t) self->size) != 0)
+            log_warning ("Cannot shrink snapshot back: %s", strerror (errno));
+        errno = error;
+        return -1;
+    }
+    // the old mapping shows the same file, nothing to copy
+    if (self->header)
+        munmap (self->header, self->size);
+    self->size = size;
+    self->header = (snapshot_header_t *) map;
+    self->records = (snapshot_record_t *) (self->header + 1);
+    self->header->capacity = (uint32_t) capacity;
+    return 0;
+}
+
+//  Read valid records of an existing file
+static std::vector <snapshot_record_t>
+s_read (int fd, time_t now)
+{
+    std::vector <snapshot_record_t> records;
+    struct stat st;
+    if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (snapshot_header_t))
+        return records;
+    void *map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return records;
+    const snapshot_header_t *header = (const snapshot_header_t *) map;
+    const snapshot_record_t *stored = (const snapshot_record_t *) (header + 1);
+    if (memcmp (header->magic, SNAPSHOT_MAGIC, sizeof (header->magic)) == 0
+    &&  header->record_size == sizeof (snapshot_record_t)
+    &&  header->count <= header->capacity
+    &&  sizeof (snapshot_header_t) + header->count * sizeof (snapshot_record_t) <= (size_t) st.st_size) {
+        for (size_t i = 0; i < header->count; i++) {
+            if (stored [i].valid_till >= now && memchr (stored [i].topic, 0, sizeof (stored [i].topic)))
+                records.push_back (stored [i]);
+        }
+    }
+    munmap (map, st.st_size);
+    return records;
+}
+
+//  --------------------------------------------------------------------------
+//  Open snapshot file
+
+input_snapshot_t *
+input_snapshot_open (const char *path, time_t now)
+{
+    assert (path);
+    int fd = open (path, O_RDWR | O_CREAT, 0640);
+    if (fd == -1) {
+        log_error ("Cannot open snapshot '%s': %s", path, strerror (errno));
+        return NULL;
+    }
+    std::vector <snapshot_record_t> records = s_read (fd, now);
+
+    input_snapshot_t *self = new input_snapshot_t ();
+    self->fd = fd;
+    // the file is written anew, without expired and unused records
+    size_t capacity = SNAPSHOT_CAPACITY;
+    while (capacity < 2 * records.size ())
+        capacity *= 2;
+    if (ftruncate (fd, 0) != 0 || s_map (self, capacity) != 0) {
+        log_error ("Cannot map snapshot '%s': %s", path, strerror (errno));
+        input_snapshot_destroy (&self);
+        return NULL;
+    }
+    for (size_t i = 0; i < records.size (); i++) {
+        self->records [i] = records [i];
+        self->index [records [i].topic] = i;
+        self->pending.push_back (true);
+    }
+    memcpy (self->header->magic, SNAPSHOT_MAGIC, sizeof (self->header->magic));
+    self->header->record_size = sizeof (snapshot_record_t);
+    self->header->count = records.size ();
+    log_debug ("Snapshot '%s' has %zu valid inputs", path, records.size ());
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the input_snapshot
+
+void
+input_snapshot_destroy (input_snapshot_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        input_snapshot_t *self = *self_p;
+        if (self->header) {
+            msync (self->header, self->size, MS_ASYNC);
+            munmap (self->header, self->size);
+        }
+        close (self->fd);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Store last value of the input
+
+void
+input_snapshot_store (input_snapshot_t *self, const std::string &topic, double value, time_t timestamp, time_t valid_till)
+{
+    assert (self);
+    size_t i;
+    auto it = self->index.find (topic);
+    if (it != self->index.end ()) {
+        i = it->second;
+        self->pending [i] = false;
+    }
+    else {
+        if (topic.size () > INPUT_SNAPSHOT_TOPIC_MAX)
+            return;
+        i = self->header->count;
+        if (i == self->header->capacity && s_map (self, 2 * (size_t) self->header->capacity) != 0) {
+            log_error ("Cannot grow snapshot: %s", strerror (errno));
+            return;
+        }
+        memcpy (self->records [i].topic, topic.c_str (), topic.size () + 1);
+        self->index [topic] = i;
+        self->pending.push_back (false);
+    }
+    snapshot_record_t &record = self->records [i];
+    record.value = value;
+    record.timestamp = timestamp;
+    record.valid_till = valid_till;
+    if (i == self->header->count) {
+        // the record is complete before it is counted
+        std::atomic_signal_fence (std::memory_order_release);
+        self->header->count = i + 1;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Update 'graph' with inputs kept from the previous process
+
+size_t
+input_snapshot_restore (input_snapshot_t *self, composite_graph_t *graph, time_t now)
+{
+    assert (self);
+    assert (graph);
+    size_t restored = 0;
+    for (size_t i = 0; i < self->pending.size (); i++) {
+        const snapshot_record_t &record = self->records [i];
+        if (!self->pending [i] || record.valid_till < now)
+            continue;
+        if (composite_graph_update (graph, record.topic, record.value, record.timestamp, record.valid_till)) {
+            self->pending [i] = false;
+            restored++;
+        }
+    }
+    return restored;
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of inputs in the snapshot
+
+size_t
+input_snapshot_size (input_snapshot_t *self)
+{
+    assert (self);
+    return self->header->count;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+input_snapshot_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("input-snapshot-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    time_t now = time (NULL);
+    char *path = zsys_sprintf ("%s/input-snapshot.snapshot", SELFTEST_DIR_RW);
+    unlink (path);
+    input_snapshot_t *self = input_snapshot_open (path, now);
+    assert (self);
+    assert (input_snapshot_size (self) == 0);
+    input_snapshot_store (self, "temperature@TH1", 20, now, now + 60);
+    input_snapshot_store (self, "temperature@TH2", 25, now, now + 60);
+    input_snapshot_store (self, "temperature@TH1", 30, now, now + 60);       // updated in place
+    input_snapshot_store (self, "temperature@TH3", 99, now - 100, now - 40); // expired
+    input_snapshot_store (self, std::string (INPUT_SNAPSHOT_TOPIC_MAX + 1, 'x'), 1, now, now + 60);
+    assert (input_snapshot_size (self) == 3);
+    // more than the initial capacity
+    for (int i = 0; i < 200; i++)
+        input_snapshot_store (self, "humidity@TH" + std::to_string (i), i, now, now + 60);
+    assert (input_snapshot_size (self) == 203);
+    input_snapshot_destroy (&self);
+    assert (self == NULL);
+
+    // the next process restores valid inputs into its graph
+    self = input_snapshot_open (path, now);
+    assert (self);
+    assert (input_snapshot_size (self) == 202);
+    composite_graph_t *graph = composite_graph_new ();
+    composite_evaluator_t *evaluator = composite_evaluator_new ("snapshot");
+    char *config = zsys_sprintf ("%s/input-snapshot.cfg", SELFTEST_DIR_RW);
+    FILE *file = fopen (config, "w");
+    assert (file);
+    fputs ("{ \"in\" : [ \"temperature@TH1\", \"temperature@TH2\", \"temperature@TH3\" ],\n"
+           "  \"reductions\" : [ { \"function\" : \"average\", \"topic\" : \"average.temperature@rack\", \"unit\" : \"C\" } ] }\n",
+           file);
+    fclose (file);
+    int rv = composite_evaluator_load (evaluator, config);
+    assert (rv == 0);
+    unlink (config);
+    zstr_free (&config);
+    rv = composite_graph_add (graph, &evaluator);
+    assert (rv == 0);
+
+    // a value received meanwhile is newer than the snapshot
+    input_snapshot_store (self, "temperature@TH2", 50, now, now + 60);
+    composite_graph_update (graph, "temperature@TH2", 50, now, now + 60);
+    assert (input_snapshot_restore (self, graph, now) == 1);
+    std::vector <composite_output_t> outputs;
+    composite_graph_evaluate (graph, now, 60, outputs, NULL);
+    assert (outputs.size () == 1);
+    assert (outputs [0].value == 40);       // (30 + 50) / 2, TH3 expired
+    // each input is restored only once
+    assert (input_snapshot_restore (self, graph, now) == 0);
+    composite_graph_destroy (&graph);
+    input_snapshot_destroy (&self);
+
+    // a damaged file is started anew
+    file = fopen (path, "w");
+    assert (file);
+    fputs ("garbage", file);
+    fclose (file);
+    self = input_snapshot_open (path, now);
+    assert (self);
+    assert (input_snapshot_size (self) == 0);
+    input_snapshot_destroy (&self);
+    unlink (path);
+    zstr_free (&path);
+    //  @end
+    log_info (" * input_snapshot: OK\n");
+}
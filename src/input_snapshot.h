@@ -0,0 +1,72 @@
+/*  =========================================================================
+    input_snapshot - mmap backed file of last values of inputs for warm restart
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+#ifndef INPUT_SNAPSHOT_H_INCLUDED
+#define INPUT_SNAPSHOT_H_INCLUDED
+
+#include <string>
+
+//  Longest topic stored, fixed size records keep the updates in place
+#define INPUT_SNAPSHOT_TOPIC_MAX 103
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _input_snapshot_t input_snapshot_t;
+
+//  @interface
+//  Open snapshot file 'path', creating it if needed. Inputs stored by the
+//  previous process which are still valid at 'now' are kept for restore,
+//  the others are dropped. NULL if the file cannot be used.
+FTY_METRIC_COMPOSITE_EXPORT input_snapshot_t *
+    input_snapshot_open (const char *path, time_t now);
+
+//  Store last value of the input, topics longer than INPUT_SNAPSHOT_TOPIC_MAX are not stored
+FTY_METRIC_COMPOSITE_EXPORT void
+    input_snapshot_store (input_snapshot_t *self, const std::string &topic, double value, time_t timestamp, time_t valid_till);
+
+//  Update 'graph' with inputs kept from the previous process which are still
+//  valid at 'now', each input only once and only if no newer value was stored
+//  since. Returns number of inputs the graph took.
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    input_snapshot_restore (input_snapshot_t *self, composite_graph_t *graph, time_t now);
+
+//  Get number of inputs in the snapshot
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    input_snapshot_size (input_snapshot_t *self);
+
+//  Destroy the input_snapshot, the file stays
+FTY_METRIC_COMPOSITE_EXPORT void
+    input_snapshot_destroy (input_snapshot_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    input_snapshot_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,341 @@
+/*  =========================================================================
+    lua_arena - pooled allocator of Lua states reset after each evaluation
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    lua_arena - pooled allocator of Lua states reset after each evaluation
+@discuss
+    Lua state of one evaluation lives only until lua_close, so its blocks are
+    taken from chunks by moving a pointer and all are released at once by
+    lua_arena_reset, the chunks stay for the next evaluation. Blocks freed
+    during the evaluation (garbage collection, growing tables and strings)
+    go to free lists of their size class and are reused: classes are
+    multiples of 16 bytes up to 256 and powers of two up to 4096. Lua tells
+    the size of every block it frees or resizes, so blocks need no header.
+    Larger blocks come directly from malloc.
+
+    A block shrunk into a smaller class stays where it is, as Lua expects a
+    shrink never to fail; a large block shrunk below the limit then serves
+    as a block of its new class and is freed by the reset.
+
+    The memory of an evaluator is thus taken from the system once, for the
+    largest evaluation, instead of malloc and free of every block, which
+    keeps the heap of a long running agent from fragmenting.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <new>
+#include <vector>
+
+#define ALIGNMENT       16
+#define SMALL_LIMIT     256     // classes by ALIGNMENT up to here
+#define LARGE_LIMIT     4096    // then by powers of two, larger blocks use malloc
+#define CLASSES         (SMALL_LIMIT / ALIGNMENT + 4)
+
+struct _lua_arena_t {
+    std::vector <char *> chunks;
+    size_t chunk_size;
+    size_t chunk;               // chunk being filled
+    size_t offset;              // in that chunk
+    std::vector <void *> adopted;   // large blocks shrunk into a class
+    void *free_lists [CLASSES];
+    size_t in_use;              // bytes, by size classes
+    size_t peak;
+    size_t allocations;
+};
+
+//  Size class of 'size' bytes, CLASSES for large blocks
+static size_t
+s_class (size_t size)
+{
+    if (size <= SMALL_LIMIT)
+        return size == 0 ? 0 : (size - 1) / ALIGNMENT;
+    size_t index = SMALL_LIMIT / ALIGNMENT;
+    for (size_t limit = SMALL_LIMIT * 2; limit <= LARGE_LIMIT; limit *= 2, index++) {
+        if (size <= limit)
+            return index;
+    }
+    return CLASSES;
+}
+
+//  Size of blocks of the class
+static size_t
+s_class_size (size_t index)
+{
+    if (index < SMALL_LIMIT / ALIGNMENT)
+        return (index + 1) * ALIGNMENT;
+    return (size_t) SMALL_LIMIT << (index - SMALL_LIMIT / ALIGNMENT + 1);
+}
+
+static void *
+s_allocate (lua_arena_t *self, size_t index)
+{
+    size_t size = s_class_size (index);
+    self->allocations++;
+    self->in_use += size;
+    if (self->in_use > self->peak)
+        self->peak = self->in_use;
+    if (self->free_lists [index]) {
+        void *block = self->free_lists [index];
+        self->free_lists [index] = *(void **) block;
+        return block;
+    }
+    if (self->chunk < self->chunks.size () && self->offset + size > self->chunk_size) {
+        self->chunk++;
+        self->offset = 0;
+    }
+    if (self->chunk == self->chunks.size ()) {
+        char *chunk = (char *) malloc (self->chunk_size);
+        if (!chunk)
+            return NULL;
+        self->chunks.push_back (chunk);
+        self->offset = 0;
+    }
+    void *block = self->chunks [self->chunk] + self->offset;
+    self->offset += size;
+    return block;
+}
+
+static void
+s_release (lua_arena_t *self, void *block, size_t index)
+{
+    *(void **) block = self->free_lists [index];
+    self->free_lists [index] = block;
+    self->in_use -= s_class_size (index);
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new arena
+
+lua_arena_t *
+lua_arena_new (size_t chunk_size)
+{
+    lua_arena_t *self = new lua_arena_t ();
+    // at least one block of the largest class
+    self->chunk_size = chunk_size < LARGE_LIMIT ? LARGE_LIMIT : chunk_size;
+    self->adopted.reserve (16);
+    lua_arena_reset (self);
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the lua_arena
+
+void
+lua_arena_destroy (lua_arena_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        lua_arena_t *self = *self_p;
+        for (auto chunk : self->chunks)
+            free (chunk);
+        for (auto block : self->adopted)
+            free (block);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Allocate, resize or free a block with the semantics of lua_Alloc
+
+void *
+lua_arena_realloc (lua_arena_t *self, void *ptr, size_t osize, size_t nsize)
+{
+    assert (self);
+    size_t old_index = ptr ? s_class (osize) : CLASSES;
+    if (nsize == 0) {
+        if (ptr && old_index < CLASSES)
+            s_release (self, ptr, old_index);
+        else
+            free (ptr);
+        return NULL;
+    }
+    size_t new_index = s_class (nsize);
+    if (ptr && old_index == new_index) {
+        if (new_index < CLASSES)
+            return ptr;
+        self->allocations++;
+        return realloc (ptr, nsize);
+    }
+    // a shrink keeps the block, the rest of it is unused till the reset
+    if (ptr && nsize <= osize) {
+        if (old_index < CLASSES) {
+            self->in_use -= s_class_size (old_index) - s_class_size (new_index);
+            return ptr;
+        }
+        try {
+            self->adopted.push_back (ptr);
+        }
+        catch (const std::bad_alloc &) {
+            return NULL;
+        }
+        self->in_use += s_class_size (new_index);
+        if (self->in_use > self->peak)
+            self->peak = self->in_use;
+        return ptr;
+    }
+
+    void *block;
+    if (new_index < CLASSES)
+        block = s_allocate (self, new_index);
+    else {
+        self->allocations++;
+        block = malloc (nsize);
+    }
+    if (!block)
+        return NULL;
+    if (ptr) {
+        memcpy (block, ptr, osize < nsize ? osize : nsize);
+        if (old_index < CLASSES)
+            s_release (self, ptr, old_index);
+        else
+            free (ptr);
+    }
+    return block;
+}
+
+//  --------------------------------------------------------------------------
+//  Release all blocks at once
+
+void
+lua_arena_reset (lua_arena_t *self)
+{
+    assert (self);
+    self->chunk = 0;
+    self->offset = 0;
+    for (auto block : self->adopted)
+        free (block);
+    self->adopted.clear ();
+    for (size_t i = 0; i < CLASSES; i++)
+        self->free_lists [i] = NULL;
+    self->in_use = 0;
+    self->peak = 0;
+    self->allocations = 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of allocations since the last reset
+
+size_t
+lua_arena_allocations (lua_arena_t *self)
+{
+    assert (self);
+    return self->allocations;
+}
+
+//  --------------------------------------------------------------------------
+//  Get peak of bytes in use since the last reset
+
+size_t
+lua_arena_peak (lua_arena_t *self)
+{
+    assert (self);
+    return self->peak;
+}
+
+//  --------------------------------------------------------------------------
+//  Get bytes taken from the system for chunks
+
+size_t
+lua_arena_capacity (lua_arena_t *self)
+{
+    assert (self);
+    return self->chunks.size () * self->chunk_size;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+lua_arena_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("lua-arena-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+
+    //  @selftest
+    // classes cover all sizes
+    for (size_t size = 1; size <= LARGE_LIMIT; size++) {
+        size_t index = s_class (size);
+        assert (index < CLASSES);
+        assert (s_class_size (index) >= size);
+        assert (index == 0 || s_class_size (index - 1) < size);
+    }
+    assert (s_class (LARGE_LIMIT + 1) == CLASSES);
+
+    lua_arena_t *self = lua_arena_new (8192);
+    assert (self);
+    assert (lua_arena_capacity (self) == 0);
+
+    char *a = (char *) lua_arena_realloc (self, NULL, 5, 10);      // Lua 5.2 passes type as osize
+    assert (a);
+    assert (((uintptr_t) a) % ALIGNMENT == 0);
+    memcpy (a, "123456789", 10);
+    // growing within the class keeps the block
+    assert (lua_arena_realloc (self, a, 10, 16) == a);
+    // growing to another class copies
+    char *b = (char *) lua_arena_realloc (self, a, 16, 100);
+    assert (b != a);
+    assert (streq (b, "123456789"));
+    assert (lua_arena_peak (self) == 16 + 112);
+    // freed block is reused
+    char *c = (char *) lua_arena_realloc (self, NULL, 0, 12);
+    assert (c == a);
+    // large blocks
+    char *d = (char *) lua_arena_realloc (self, NULL, 0, 100000);
+    assert (d);
+    memset (d, 1, 100000);
+    d = (char *) lua_arena_realloc (self, d, 100000, 200000);
+    assert (d [99999] == 1);
+    // shrinking never allocates, a large block becomes a block of the class
+    char *e = (char *) lua_arena_realloc (self, d, 200000, 64);
+    assert (e == d);
+    assert (e [63] == 1);
+    assert (lua_arena_allocations (self) == 5);
+    assert (lua_arena_realloc (self, b, 100, 20) == b);
+    assert (lua_arena_realloc (self, b, 20, 0) == NULL);
+    assert (lua_arena_realloc (self, c, 12, 0) == NULL);
+    assert (lua_arena_realloc (self, e, 64, 0) == NULL);
+    assert (lua_arena_capacity (self) == 8192);
+
+    // many small blocks fill more chunks, reset keeps them
+    std::vector <void *> blocks;
+    for (int i = 0; i < 1000; i++)
+        blocks.push_back (lua_arena_realloc (self, NULL, 0, 24));
+    size_t capacity = lua_arena_capacity (self);
+    assert (capacity >= 32 * 1000);
+    lua_arena_reset (self);
+    assert (lua_arena_allocations (self) == 0);
+    assert (lua_arena_peak (self) == 0);
+    void *first = lua_arena_realloc (self, NULL, 0, 24);
+    assert (first == a);        // from the start of the first chunk again
+    for (int i = 1; i < 1000; i++)
+        lua_arena_realloc (self, NULL, 0, 24);
+    assert (lua_arena_capacity (self) == capacity);
+
+    lua_arena_destroy (&self);
+    assert (self == NULL);
+    //  @end
+    log_info (" * lua_arena: OK\n");
+}
@@ -0,0 +1,72 @@
+/*  =========================================================================
+    lua_arena - pooled allocator of Lua states reset after each evaluation
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef LUA_ARENA_H_INCLUDED
+#define LUA_ARENA_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _lua_arena_t lua_arena_t;
+
+//  @interface
+//  Create a new arena, getting memory from the system in chunks of 'chunk_size' bytes
+FTY_METRIC_COMPOSITE_EXPORT lua_arena_t *
+    lua_arena_new (size_t chunk_size);
+
+//  Allocate, resize or free (nsize == 0) a block with the semantics of lua_Alloc;
+//  'osize' is the size of 'ptr' when it is not NULL
+FTY_METRIC_COMPOSITE_EXPORT void *
+    lua_arena_realloc (lua_arena_t *self, void *ptr, size_t osize, size_t nsize);
+
+//  Release all blocks at once, chunks are kept for reuse. Only after lua_close
+//  of the state using the arena, when no large block is left
+FTY_METRIC_COMPOSITE_EXPORT void
+    lua_arena_reset (lua_arena_t *self);
+
+//  Get number of allocations since the last reset
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    lua_arena_allocations (lua_arena_t *self);
+
+//  Get peak of bytes in use since the last reset
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    lua_arena_peak (lua_arena_t *self);
+
+//  Get bytes taken from the system for chunks
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    lua_arena_capacity (lua_arena_t *self);
+
+//  Destroy the lua_arena
+FTY_METRIC_COMPOSITE_EXPORT void
+    lua_arena_destroy (lua_arena_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    lua_arena_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+/*  =========================================================================
+    metric_ring - single producer single consumer ring of metric records
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    metric_ring - single producer single consumer ring of metric records
+@discuss
+    Lock-free ring passing decoded metrics from the receiving thread to one
+    evaluating thread. Capacity is a power of two, positions only grow and
+    are masked on access. Each side owns one position and keeps a cached
+    copy of the other one, so the shared cache line is read only when the
+    ring looks full (producer) or empty (consumer). The release store of a
+    position publishes the records written before it.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <atomic>
+#include <thread>
+
+#define CACHE_LINE 64
+
+//  Sides are padded apart, so that they do not share a cache line
+struct _metric_ring_t {
+    metric_record_t *records;
+    size_t mask;
+    char pad1 [CACHE_LINE];
+    std::atomic <size_t> tail;                          // written by the producer
+    size_t head_cached;                                 // producer's copy of head
+    char pad2 [CACHE_LINE];
+    std::atomic <size_t> head;                          // written by the consumer
+    size_t tail_cached;                                 // consumer's copy of tail
+    char pad3 [CACHE_LINE];
+};
+
+//  --------------------------------------------------------------------------
+//  Create a new ring for at least 'capacity' records
+
+metric_ring_t *
+metric_ring_new (size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    metric_ring_t *self = new metric_ring_t ();
+    self->records = new metric_record_t [size];
+    self->mask = size - 1;
+    self->tail = 0;
+    self->head_cached = 0;
+    self->head = 0;
+    self->tail_cached = 0;
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the metric_ring
+
+void
+metric_ring_destroy (metric_ring_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        metric_ring_t *self = *self_p;
+        delete [] self->records;
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Append record, called only by the producer thread
+
+bool
+metric_ring_push (metric_ring_t *self, const metric_record_t *record)
+{
+    assert (self);
+    assert (record);
+    size_t tail = self->tail.load (std::memory_order_relaxed);
+    if (tail - self->head_cached > self->mask) {
+        self->head_cached = self->head.load (std::memory_order_acquire);
+        if (tail - self->head_cached > self->mask)
+            return false;
+    }
+    self->records [tail & self->mask] = *record;
+    self->tail.store (tail + 1, std::memory_order_release);
+    return true;
+}
+
+//  --------------------------------------------------------------------------
+//  Remove up to 'max' oldest records, called only by the consumer thread
+
+size_t
+metric_ring_pop (metric_ring_t *self, metric_record_t *records, size_t max)
+{
+    assert (self);
+    assert (records);
+    size_t head = self->head.load (std::memory_order_relaxed);
+    if (self->tail_cached - head < max)
+        self->tail_cached = self->tail.load (std::memory_order_acquire);
+    size_t count = self->tail_cached - head;
+    if (count > max)
+        count = max;
+    for (size_t i = 0; i < count; i++)
+        records [i] = self->records [(head + i) & self->mask];
+    if (count > 0)
+        self->head.store (head + count, std::memory_order_release);
+    return count;
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of records in the ring
+
+size_t
+metric_ring_size (metric_ring_t *self)
+{
+    assert (self);
+    return self->tail.load (std::memory_order_seq_cst) - self->head.load (std::memory_order_relaxed);
+}
+
+//  --------------------------------------------------------------------------
+//  Get capacity of the ring
+
+size_t
+metric_ring_capacity (metric_ring_t *self)
+{
+    assert (self);
+    return self->mask + 1;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+static void
+s_producer (metric_ring_t *ring, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        metric_record_t record = {(uint32_t) i, (double) i, (time_t) i, (time_t) i + 1};
+        while (!metric_ring_push (ring, &record))
+            std::this_thread::yield ();
+    }
+}
+
+void
+metric_ring_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("metric-ring-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+
+    //  @selftest
+    metric_ring_t *self = metric_ring_new (5);
+    assert (self);
+    assert (metric_ring_capacity (self) == 8);
+    assert (metric_ring_size (self) == 0);
+
+    metric_record_t records [16];
+    assert (metric_ring_pop (self, records, 16) == 0);
+    for (uint32_t i = 0; i < 8; i++) {
+        metric_record_t record = {i, i * 1.5, 100, 200};
+        assert (metric_ring_push (self, &record));
+    }
+    metric_record_t extra = {8, 0, 0, 0};
+    assert (!metric_ring_push (self, &extra));
+    assert (metric_ring_size (self) == 8);
+
+    // batches come in order, wrapping around the end
+    assert (metric_ring_pop (self, records, 3) == 3);
+    assert (records [0].input == 0 && records [2].input == 2);
+    assert (records [1].value == 1.5);
+    assert (metric_ring_push (self, &extra));
+    assert (metric_ring_pop (self, records, 16) == 6);
+    assert (records [0].input == 3 && records [5].input == 8);
+    assert (metric_ring_size (self) == 0);
+
+    metric_ring_destroy (&self);
+    assert (self == NULL);
+
+    // concurrent producer, nothing lost or reordered
+    static const size_t COUNT = 100000;
+    self = metric_ring_new (1024);
+    std::thread producer (s_producer, self, COUNT);
+    size_t expected = 0;
+    while (expected < COUNT) {
+        size_t count = metric_ring_pop (self, records, 16);
+        for (size_t i = 0; i < count; i++) {
+            assert (records [i].input == (uint32_t) expected);
+            assert (records [i].valid_till == (time_t) expected + 1);
+            expected++;
+        }
+    }
+    producer.join ();
+    assert (metric_ring_size (self) == 0);
+    metric_ring_destroy (&self);
+    //  @end
+    log_info (" * metric_ring: OK\n");
+}
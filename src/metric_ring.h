@@ -0,0 +1,75 @@
+/*  =========================================================================
+    metric_ring - single producer single consumer ring of metric records
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef METRIC_RING_H_INCLUDED
+#define METRIC_RING_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _metric_ring_t metric_ring_t;
+
+//  New value of one input
+typedef struct {
+    uint32_t input;         // index of the input topic, defined by the user of the ring
+    double value;
+    time_t timestamp;
+    time_t valid_till;
+} metric_record_t;
+
+//  @interface
+//  Create a new ring for at least 'capacity' records
+FTY_METRIC_COMPOSITE_EXPORT metric_ring_t *
+    metric_ring_new (size_t capacity);
+
+//  Append record, called only by the producer thread. False if the ring is full
+FTY_METRIC_COMPOSITE_EXPORT bool
+    metric_ring_push (metric_ring_t *self, const metric_record_t *record);
+
+//  Remove up to 'max' oldest records into 'records', called only by the consumer
+//  thread. Returns number of records removed
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    metric_ring_pop (metric_ring_t *self, metric_record_t *records, size_t max);
+
+//  Get number of records in the ring, exact only in the consumer thread
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    metric_ring_size (metric_ring_t *self);
+
+//  Get capacity of the ring
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    metric_ring_capacity (metric_ring_t *self);
+
+//  Destroy the metric_ring
+FTY_METRIC_COMPOSITE_EXPORT void
+    metric_ring_destroy (metric_ring_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    metric_ring_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,295 @@
+/*  =========================================================================
+    proto_metric_decode - partial decoder of fty_proto metric messages
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    proto_metric_decode - partial decoder of fty_proto metric messages
+@discuss
+    fty_proto_decode allocates the message, all its strings and the aux hash,
+    while the evaluation needs only time, ttl and value. The METRIC frame is
+    walked here in place: 2 bytes signature, 1 byte id, aux (4 bytes count
+    of string key, 4 bytes long string value pairs), time (8 bytes), ttl
+    (4 bytes), type, name, value and unit (1 byte length strings); numbers
+    are in network order. The signature is taken from a message encoded by
+    fty_proto itself. Anything not matching this layout exactly is left for
+    fty_proto_decode.
+
+    The value is converted by an exact fast path for decimals of at most 19
+    significant digits and with the decimal exponent within +-22, which both
+    fit in double and are converted by one correctly rounded operation. Other
+    strings go through strtod, so the result is always the same as of atof.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <cmath>
+
+//  --------------------------------------------------------------------------
+//  Signature of fty_proto frames, taken from the codec itself
+
+static uint16_t
+s_signature (void)
+{
+    static const uint16_t signature = [] () {
+        zmsg_t *msg = fty_proto_encode_metric (NULL, 0, 0, "type", "name", "0", "");
+        assert (msg);
+        const byte *data = zframe_data (zmsg_first (msg));
+        uint16_t result = (uint16_t) ((data [0] << 8) | data [1]);
+        zmsg_destroy (&msg);
+        return result;
+    } ();
+    return signature;
+}
+
+//  Read number of 'size' bytes in network order
+static bool
+s_get_number (const byte *&needle, const byte *ceiling, size_t size, uint64_t &number)
+{
+    if ((size_t) (ceiling - needle) < size)
+        return false;
+    number = 0;
+    for (size_t i = 0; i < size; i++)
+        number = (number << 8) | needle [i];
+    needle += size;
+    return true;
+}
+
+//  Read string with length of 'size' bytes in front of it
+static bool
+s_get_string (const byte *&needle, const byte *ceiling, size_t size, const char *&text, size_t &length)
+{
+    uint64_t number;
+    if (!s_get_number (needle, ceiling, size, number) || (uint64_t) (ceiling - needle) < number)
+        return false;
+    text = (const char *) needle;
+    length = (size_t) number;
+    needle += length;
+    return true;
+}
+
+//  --------------------------------------------------------------------------
+//  Read time, ttl and value of the fty_proto METRIC in 'msg'
+
+int
+proto_metric_decode (zmsg_t *msg, proto_metric_values_t *values)
+{
+    assert (msg);
+    assert (values);
+
+    if (zmsg_size (msg) != 1)
+        return -1;
+    zframe_t *frame = zmsg_first (msg);
+    const byte *needle = zframe_data (frame);
+    const byte *ceiling = needle + zframe_size (frame);
+
+    uint64_t signature, id;
+    if (!s_get_number (needle, ceiling, 2, signature) || signature != s_signature ()
+    ||  !s_get_number (needle, ceiling, 1, id) || id != FTY_PROTO_METRIC)
+        return -1;
+
+    const char *text;
+    size_t length;
+    uint64_t aux_size;
+    if (!s_get_number (needle, ceiling, 4, aux_size))
+        return -1;
+    for (uint64_t i = 0; i < aux_size; i++) {
+        if (!s_get_string (needle, ceiling, 1, text, length)
+        ||  !s_get_string (needle, ceiling, 4, text, length))
+            return -1;
+    }
+
+    uint64_t time, ttl;
+    const char *value;
+    size_t value_length;
+    if (!s_get_number (needle, ceiling, 8, time)
+    ||  !s_get_number (needle, ceiling, 4, ttl)
+    ||  !s_get_string (needle, ceiling, 1, text, length)                // type
+    ||  !s_get_string (needle, ceiling, 1, text, length)                // name
+    ||  !s_get_string (needle, ceiling, 1, value, value_length)
+    ||  !s_get_string (needle, ceiling, 1, text, length)                // unit
+    ||  needle != ceiling)
+        return -1;
+
+    values->time = time;
+    values->ttl = (uint32_t) ttl;
+    values->value = proto_metric_parse_value (value, value_length);
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Convert 'length' characters of 'text' to double like atof
+
+double
+proto_metric_parse_value (const char *text, size_t length)
+{
+    static const double powers [] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    static const uint64_t MAX_MANTISSA = (uint64_t) 1 << 53;
+
+    const char *needle = text;
+    const char *ceiling = text + length;
+    bool negative = false;
+    if (needle < ceiling && (*needle == '-' || *needle == '+')) {
+        negative = *needle == '-';
+        needle++;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool any_digit = false;
+    for (; needle < ceiling && *needle >= '0' && *needle <= '9'; needle++) {
+        mantissa = mantissa * 10 + (*needle - '0');
+        if (mantissa > 0)
+            digits++;
+        any_digit = true;
+        if (digits > 19)
+            break;
+    }
+    if (needle < ceiling && *needle == '.') {
+        needle++;
+        for (; needle < ceiling && *needle >= '0' && *needle <= '9'; needle++) {
+            mantissa = mantissa * 10 + (*needle - '0');
+            if (mantissa > 0)
+                digits++;
+            exponent--;
+            any_digit = true;
+            if (digits > 19)
+                break;
+        }
+    }
+    if (any_digit && needle < ceiling && (*needle == 'e' || *needle == 'E')) {
+        const char *start = needle++;
+        bool exponent_negative = false;
+        if (needle < ceiling && (*needle == '-' || *needle == '+')) {
+            exponent_negative = *needle == '-';
+            needle++;
+        }
+        int number = 0;
+        if (needle < ceiling && *needle >= '0' && *needle <= '9') {
+            for (; needle < ceiling && *needle >= '0' && *needle <= '9' && number < 1000; needle++)
+                number = number * 10 + (*needle - '0');
+            exponent += exponent_negative ? -number : number;
+        }
+        else
+            needle = start;     // not an exponent, handled by strtod below
+    }
+
+    if (any_digit && needle == ceiling && digits <= 19 && mantissa <= MAX_MANTISSA
+    &&  exponent >= -22 && exponent <= 22) {
+        double result = (double) mantissa;
+        if (exponent < 0)
+            result /= powers [-exponent];
+        else
+            result *= powers [exponent];
+        return negative ? -result : result;
+    }
+
+    // anything else exactly as atof, on the stack unless the string is very long
+    char buffer [64];
+    if (length < sizeof (buffer)) {
+        memcpy (buffer, text, length);
+        buffer [length] = 0;
+        return strtod (buffer, NULL);
+    }
+    return strtod (std::string (text, length).c_str (), NULL);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+proto_metric_decode_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("proto-metric-decode-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+
+    //  @selftest
+    // value conversion gives the same bits as atof
+    const char *numbers [] = {
+        "21.50", "-3", "+7", "0", "-0", "0.1", "0.3", "1e3", "2.5E-4", "123456789.123456789",
+        "99999999999999999999", "1.7976931348623157e308", "4.9e-324", "1e-30",
+        "12abc", "", "-", ".", ".5", "5.", "1e", "1e+", "nan", "inf", " 42",
+        "3.14159265358979323846264338327950288419716939937510582097494459230781640628620899"
+    };
+    for (const char *number : numbers) {
+        double expected = atof (number);
+        double value = proto_metric_parse_value (number, strlen (number));
+        if (std::isnan (expected))
+            assert (std::isnan (value));
+        else
+            assert (memcmp (&value, &expected, sizeof (double)) == 0);
+    }
+    // only 'length' characters are used
+    assert (proto_metric_parse_value ("12345", 2) == 12);
+
+    // same fields as fty_proto_decode
+    fty_proto_t *metric = fty_proto_new (FTY_PROTO_METRIC);
+    fty_proto_aux_insert (metric, "port", "%s", "1");
+    fty_proto_aux_insert (metric, "sname", "%s", "sensor-01");
+    fty_proto_set_time (metric, 1600000000);
+    fty_proto_set_ttl (metric, 300);
+    fty_proto_set_type (metric, "%s", "temperature");
+    fty_proto_set_name (metric, "%s", "sensor-01");
+    fty_proto_set_value (metric, "%s", "21.37");
+    fty_proto_set_unit (metric, "%s", "C");
+    zmsg_t *msg = fty_proto_encode (&metric);
+    assert (msg);
+
+    proto_metric_values_t values;
+    assert (proto_metric_decode (msg, &values) == 0);
+    metric = fty_proto_decode (&msg);
+    assert (metric);
+    assert (values.time == fty_proto_time (metric));
+    assert (values.ttl == fty_proto_ttl (metric));
+    assert (values.value == atof (fty_proto_value (metric)));
+    fty_proto_destroy (&metric);
+
+    msg = fty_proto_encode_metric (NULL, 1600000001, 60, "power", "ups-1", "1500", "W");
+    assert (proto_metric_decode (msg, &values) == 0);
+    assert (values.time == 1600000001);
+    assert (values.ttl == 60);
+    assert (values.value == 1500);
+
+    // truncated or extended frame is refused
+    zframe_t *frame = zmsg_first (msg);
+    zmsg_t *truncated = zmsg_new ();
+    zmsg_addmem (truncated, zframe_data (frame), zframe_size (frame) - 1);
+    assert (proto_metric_decode (truncated, &values) == -1);
+    zmsg_destroy (&truncated);
+    zmsg_addstr (msg, "extra");
+    assert (proto_metric_decode (msg, &values) == -1);
+    zmsg_destroy (&msg);
+
+    // other messages are left to fty_proto_decode
+    msg = fty_proto_encode_asset (NULL, "rack-1", FTY_PROTO_ASSET_OP_CREATE, NULL);
+    assert (proto_metric_decode (msg, &values) == -1);
+    zmsg_destroy (&msg);
+    msg = zmsg_new ();
+    zmsg_addstr (msg, "METRICUNAVAILABLE");
+    assert (proto_metric_decode (msg, &values) == -1);
+    zmsg_destroy (&msg);
+    //  @end
+    log_info (" * proto_metric_decode: OK\n");
+}
@@ -0,0 +1,58 @@
+/*  =========================================================================
+    proto_metric_decode - partial decoder of fty_proto metric messages
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef PROTO_METRIC_DECODE_H_INCLUDED
+#define PROTO_METRIC_DECODE_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Fields of a metric the evaluation needs
+typedef struct {
+    uint64_t time;          // unix time of the measurement
+    uint32_t ttl;           // seconds
+    double value;
+} proto_metric_values_t;
+
+//  @interface
+//  Read time, ttl and value of the fty_proto METRIC in 'msg' without decoding
+//  the other fields, the message is not modified. 0 - success, -1 - the message
+//  is not a METRIC, use fty_proto_decode
+FTY_METRIC_COMPOSITE_EXPORT int
+    proto_metric_decode (zmsg_t *msg, proto_metric_values_t *values);
+
+//  Convert 'length' characters of 'text' to double like atof, without allocation
+//  for plain decimal numbers
+FTY_METRIC_COMPOSITE_EXPORT double
+    proto_metric_parse_value (const char *text, size_t length);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    proto_metric_decode_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,277 @@
+/*  =========================================================================
+    reduction_kernel - masked sum, count, min and max over input arrays
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+/*
+@header
+    reduction_kernel - masked sum, count, min and max over input arrays
+@discuss
+    Builtin reductions need count, sum, min and max of the valid inputs of
+    a group with their calibration offsets added. Values, offsets and
+    validity of the inputs are kept by the evaluator in separate arrays,
+    ordered by group, so one group is a contiguous range of each array.
+
+    On x86 built by GCC or clang, CPUs with AVX2 (detected at run time)
+    process the range in blocks of 4 inputs with vector extensions compiled
+    for AVX2: validity is a lane mask from comparing 'valid_till' with 'now',
+    invalid lanes are masked out of the sum and replaced by -+inf for min
+    and max, and the lanes are combined at the end of the range. The last
+    block is shifted back to end with the range and its lanes already
+    reduced are masked out, so no scalar tail is needed. Ranges shorter
+    than a block, other CPUs and other compilers use the scalar loop. SSE2
+    has no packed compare of 64 bit integers, which the validity mask needs,
+    so the same vector code lowered to SSE2 was slower than the scalar loop
+    and the scalar loop stays the baseline.
+
+    reduction_kernel_reduce_groups reduces all groups of an evaluation in
+    one call, so thousands of small racks are one pass over the arrays.
+    The sum of the vector path is accumulated in a different order than of
+    the scalar loop and may differ from it in the last bits.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define REDUCTION_KERNEL_AVX2
+#define LANES 4
+typedef double vector_double_t __attribute__ ((vector_size (LANES * sizeof (double))));
+typedef int64_t vector_int_t __attribute__ ((vector_size (LANES * sizeof (int64_t))));
+//  Lanes of 'a' where 'mask' is set, of 'b' elsewhere
+#define SELECT(mask, a, b) \
+    ((vector_double_t) (((vector_int_t) (a) & (mask)) | ((vector_int_t) (b) & ~(mask))))
+#endif
+
+static const double INFINITE = std::numeric_limits <double>::infinity ();
+
+//  --------------------------------------------------------------------------
+//  Reduce inputs one at a time
+
+void
+reduction_kernel_reduce_scalar (const double *values, const double *offsets, const time_t *valid_till,
+                                size_t begin, size_t end, time_t now, reduction_stats_t *stats)
+{
+    assert (stats);
+    size_t count = 0;
+    double sum = 0.0;
+    double min = INFINITE;
+    double max = -INFINITE;
+    for (size_t i = begin; i < end; i++) {
+        if (now > valid_till [i])
+            continue;
+        double value = values [i] + offsets [i];
+        count++;
+        sum += value;
+        if (value < min)
+            min = value;
+        if (value > max)
+            max = value;
+    }
+    stats->count = count;
+    stats->sum = sum;
+    stats->min = min;
+    stats->max = max;
+}
+
+#if defined (REDUCTION_KERNEL_AVX2)
+//  Reduce range of at least LANES inputs
+__attribute__ ((target ("avx2"))) static void
+s_reduce_avx2 (const double *values, const double *offsets, const time_t *valid_till,
+               size_t begin, size_t end, time_t now, reduction_stats_t *stats)
+{
+    // lanes from k on, masks out lanes of the last block already reduced
+    static const vector_int_t FROM [LANES] = {
+        {-1, -1, -1, -1}, {0, -1, -1, -1}, {0, 0, -1, -1}, {0, 0, 0, -1}
+    };
+    vector_int_t now_lanes = vector_int_t {} + (int64_t) now;
+    vector_int_t count_lanes = {};
+    vector_double_t sum_lanes = {};
+    vector_double_t min_lanes = vector_double_t {} + INFINITE;
+    vector_double_t max_lanes = vector_double_t {} - INFINITE;
+    for (size_t i = begin; i < end; i += LANES) {
+        size_t at = std::min (i, end - LANES);
+        // the arrays are not aligned to the vector size
+        vector_double_t value, offset;
+        vector_int_t till;
+        memcpy (&value, values + at, sizeof (value));
+        memcpy (&offset, offsets + at, sizeof (offset));
+        memcpy (&till, valid_till + at, sizeof (till));
+        vector_int_t valid = (till >= now_lanes) & FROM [i - at];     // -1 in valid lanes
+        value += offset;
+        count_lanes -= valid;
+        sum_lanes += (vector_double_t) ((vector_int_t) value & valid);
+        min_lanes = SELECT (valid & (value < min_lanes), value, min_lanes);
+        max_lanes = SELECT (valid & (value > max_lanes), value, max_lanes);
+    }
+    stats->count = count_lanes [0] + count_lanes [1] + count_lanes [2] + count_lanes [3];
+    stats->sum = (sum_lanes [0] + sum_lanes [1]) + (sum_lanes [2] + sum_lanes [3]);
+    stats->min = std::min (std::min (min_lanes [0], min_lanes [1]), std::min (min_lanes [2], min_lanes [3]));
+    stats->max = std::max (std::max (max_lanes [0], max_lanes [1]), std::max (max_lanes [2], max_lanes [3]));
+}
+
+__attribute__ ((target ("avx2"))) static void
+s_reduce_groups_avx2 (const double *values, const double *offsets, const time_t *valid_till,
+                      const size_t *bounds, const size_t *groups, size_t count, time_t now,
+                      reduction_stats_t *stats)
+{
+    for (size_t i = 0; i < count; i++) {
+        size_t begin = bounds [groups [i]];
+        size_t end = bounds [groups [i] + 1];
+        if (end - begin < LANES)
+            reduction_kernel_reduce_scalar (values, offsets, valid_till, begin, end, now, &stats [i]);
+        else
+            s_reduce_avx2 (values, offsets, valid_till, begin, end, now, &stats [i]);
+    }
+}
+#endif
+
+//  True if the vector path can be used
+static bool
+s_vector (void)
+{
+#if defined (REDUCTION_KERNEL_AVX2)
+    static const bool vector = [] () {
+        __builtin_cpu_init ();
+        return sizeof (time_t) == sizeof (int64_t) && __builtin_cpu_supports ("avx2");
+    } ();
+    return vector;
+#else
+    return false;
+#endif
+}
+
+//  --------------------------------------------------------------------------
+//  Reduce inputs [begin, end) valid at 'now'
+
+void
+reduction_kernel_reduce (const double *values, const double *offsets, const time_t *valid_till,
+                         size_t begin, size_t end, time_t now, reduction_stats_t *stats)
+{
+    assert (stats);
+#if defined (REDUCTION_KERNEL_AVX2)
+    if (s_vector () && end - begin >= LANES) {
+        s_reduce_avx2 (values, offsets, valid_till, begin, end, now, stats);
+        return;
+    }
+#endif
+    reduction_kernel_reduce_scalar (values, offsets, valid_till, begin, end, now, stats);
+}
+
+//  --------------------------------------------------------------------------
+//  Reduce 'count' groups in one pass
+
+void
+reduction_kernel_reduce_groups (const double *values, const double *offsets, const time_t *valid_till,
+                                const size_t *bounds, const size_t *groups, size_t count, time_t now,
+                                reduction_stats_t *stats)
+{
+#if defined (REDUCTION_KERNEL_AVX2)
+    if (s_vector ()) {
+        s_reduce_groups_avx2 (values, offsets, valid_till, bounds, groups, count, now, stats);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; i++)
+        reduction_kernel_reduce_scalar (values, offsets, valid_till, bounds [groups [i]], bounds [groups [i] + 1], now, &stats [i]);
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of inputs processed at once
+
+size_t
+reduction_kernel_lanes (void)
+{
+#if defined (REDUCTION_KERNEL_AVX2)
+    return s_vector () ? LANES : 1;
+#else
+    return 1;
+#endif
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+reduction_kernel_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("reduction-kernel-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    time_t now = 1000;
+    // inputs of two groups: [0, 3) and [3, 13), with expired inputs
+    double values [] = {1, 2, 3,     10, -5, 7, 8, 100, 4, 6, 2, 9, -50};
+    double offsets [] = {0, 0, 1,    0, 0, 0, 0.5, 0, 0, 0, 0, 0, 0};
+    time_t valid_till [] = {1000, 999, 2000,    2000, 2000, 2000, 2000, 999, 2000, 2000, 2000, 2000, 10};
+    size_t bounds [] = {0, 3, 13};
+
+    reduction_stats_t stats;
+    reduction_kernel_reduce (values, offsets, valid_till, 0, 3, now, &stats);
+    assert (stats.count == 2 && stats.sum == 5 && stats.min == 1 && stats.max == 4);
+    reduction_kernel_reduce (values, offsets, valid_till, 3, 13, now, &stats);
+    assert (stats.count == 8);
+    assert (stats.sum == 41.5);
+    assert (stats.min == -5 && stats.max == 10);
+
+    // nothing valid
+    reduction_kernel_reduce (values, offsets, valid_till, 0, 13, 5000, &stats);
+    assert (stats.count == 0 && stats.sum == 0);
+    assert (stats.min == INFINITE && stats.max == -INFINITE);
+    reduction_kernel_reduce (values, offsets, valid_till, 3, 3, now, &stats);
+    assert (stats.count == 0);
+
+    // groups in any order
+    size_t groups [] = {1, 0};
+    reduction_stats_t batch [2];
+    reduction_kernel_reduce_groups (values, offsets, valid_till, bounds, groups, 2, now, batch);
+    assert (batch [0].count == 8 && batch [0].sum == 41.5);
+    assert (batch [1].count == 2 && batch [1].max == 4);
+
+    // the same as the scalar loop for every range
+    for (size_t begin = 0; begin <= 13; begin++) {
+        for (size_t end = begin; end <= 13; end++) {
+            for (time_t at = 5; at <= 2005; at += 500) {
+                reduction_stats_t scalar;
+                reduction_kernel_reduce (values, offsets, valid_till, begin, end, at, &stats);
+                reduction_kernel_reduce_scalar (values, offsets, valid_till, begin, end, at, &scalar);
+                assert (stats.count == scalar.count);
+                assert (stats.sum == scalar.sum);       // small integers are exact in any order
+                assert (stats.min == scalar.min && stats.max == scalar.max);
+            }
+        }
+    }
+    assert (reduction_kernel_lanes () >= 1);
+    //  @end
+    log_info (" * reduction_kernel: OK\n");
+}
@@ -0,0 +1,72 @@
+/*  =========================================================================
+    reduction_kernel - masked sum, count, min and max over input arrays
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+#ifndef REDUCTION_KERNEL_H_INCLUDED
+#define REDUCTION_KERNEL_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  Statistics of valid inputs with their offsets added
+typedef struct {
+    size_t count;
+    double sum;
+    double min;             // +inf when count is 0
+    double max;             // -inf when count is 0
+} reduction_stats_t;
+
+//  @interface
+//  Reduce inputs [begin, end) of the arrays which are valid at 'now'
+//  ('valid_till' not before 'now'), 'offsets' are added to 'values'
+FTY_METRIC_COMPOSITE_EXPORT void
+    reduction_kernel_reduce (const double *values, const double *offsets, const time_t *valid_till,
+                             size_t begin, size_t end, time_t now, reduction_stats_t *stats);
+
+//  Reduce 'count' groups in one pass, group g has inputs [bounds [g], bounds [g + 1]),
+//  'stats' [i] gets the statistics of group 'groups' [i]
+FTY_METRIC_COMPOSITE_EXPORT void
+    reduction_kernel_reduce_groups (const double *values, const double *offsets, const time_t *valid_till,
+                                    const size_t *bounds, const size_t *groups, size_t count, time_t now,
+                                    reduction_stats_t *stats);
+
+//  The same as reduction_kernel_reduce, one input at a time
+FTY_METRIC_COMPOSITE_EXPORT void
+    reduction_kernel_reduce_scalar (const double *values, const double *offsets, const time_t *valid_till,
+                                    size_t begin, size_t end, time_t now, reduction_stats_t *stats);
+
+//  Get number of inputs reduction_kernel_reduce processes at once, 1 when the CPU
+//  or the compiler does not support the vector path
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    reduction_kernel_lanes (void);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    reduction_kernel_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
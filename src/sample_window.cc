@@ -0,0 +1,291 @@
+/*  =========================================================================
+    sample_window - ring buffer of samples with incremental window statistics
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    sample_window - ring buffer of samples with incremental window statistics
+@discuss
+    Keeps last N (time, value) samples of one input. All statistics are
+    maintained on insertion in O(1) (amortized for min/max), so reading
+    them costs nothing:
+
+    * average - running sum of the window, recomputed from the samples
+      once per N insertions so that rounding errors do not accumulate
+    * min/max - monotonic queues of candidates (sequence number, value)
+    * rate    - difference of the newest and the oldest sample over time
+    * EWMA    - over all samples added, not only those in the window
+
+    Statistics of an empty window are 0.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+typedef std::pair <uint64_t, double> candidate_t;   // sequence number, value
+
+struct _sample_window_t {
+    std::vector <time_t> times;
+    std::vector <double> values;
+    size_t head;                        // position of the oldest sample
+    size_t size;
+    uint64_t sequence;                  // of the next sample
+    double sum;
+    double alpha;
+    double ewma;
+    std::deque <candidate_t> min;       // increasing values, front is the minimum
+    std::deque <candidate_t> max;       // decreasing values, front is the maximum
+};
+
+//  --------------------------------------------------------------------------
+//  Create a new sample_window
+
+sample_window_t *
+sample_window_new (size_t capacity, double alpha)
+{
+    sample_window_t *self = new sample_window_t ();
+    if (capacity < 1)
+        capacity = 1;
+    self->times.resize (capacity);
+    self->values.resize (capacity);
+    self->alpha = (alpha > 0 && alpha <= 1) ? alpha : 1;
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the sample_window
+
+void
+sample_window_destroy (sample_window_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        delete *self_p;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Add sample
+
+void
+sample_window_add (sample_window_t *self, time_t time, double value)
+{
+    assert (self);
+    size_t capacity = self->values.size ();
+    size_t tail = (self->head + self->size) % capacity;
+    if (self->size == capacity) {
+        // drop the oldest
+        self->sum -= self->values [self->head];
+        self->head = (self->head + 1) % capacity;
+        self->size--;
+    }
+    self->times [tail] = time;
+    self->values [tail] = value;
+    self->size++;
+    self->sum += value;
+    if (tail == capacity - 1) {
+        self->sum = 0;
+        for (size_t i = 0; i < self->size; i++)
+            self->sum += self->values [i];
+    }
+
+    uint64_t oldest = self->sequence + 1 - self->size;
+    while (!self->min.empty () && self->min.back ().second >= value)
+        self->min.pop_back ();
+    self->min.push_back (candidate_t (self->sequence, value));
+    if (self->min.front ().first < oldest)
+        self->min.pop_front ();
+    while (!self->max.empty () && self->max.back ().second <= value)
+        self->max.pop_back ();
+    self->max.push_back (candidate_t (self->sequence, value));
+    if (self->max.front ().first < oldest)
+        self->max.pop_front ();
+
+    self->ewma = self->sequence == 0 ? value : self->alpha * value + (1 - self->alpha) * self->ewma;
+    self->sequence++;
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of samples in the window
+
+size_t
+sample_window_size (sample_window_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+//  --------------------------------------------------------------------------
+//  Get average of samples in the window
+
+double
+sample_window_average (sample_window_t *self)
+{
+    assert (self);
+    return self->size ? self->sum / self->size : 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Get minimum of samples in the window
+
+double
+sample_window_min (sample_window_t *self)
+{
+    assert (self);
+    return self->size ? self->min.front ().second : 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Get maximum of samples in the window
+
+double
+sample_window_max (sample_window_t *self)
+{
+    assert (self);
+    return self->size ? self->max.front ().second : 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Get rate of change per second
+
+double
+sample_window_rate (sample_window_t *self)
+{
+    assert (self);
+    if (self->size < 2)
+        return 0;
+    size_t newest = (self->head + self->size - 1) % self->values.size ();
+    time_t duration = self->times [newest] - self->times [self->head];
+    if (duration == 0)
+        return 0;
+    return (self->values [newest] - self->values [self->head]) / duration;
+}
+
+//  --------------------------------------------------------------------------
+//  Get exponentially weighted moving average
+
+double
+sample_window_ewma (sample_window_t *self)
+{
+    assert (self);
+    return self->ewma;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+sample_window_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("sample-window-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    sample_window_t *self = sample_window_new (3, 0.5);
+    assert (self);
+    assert (sample_window_size (self) == 0);
+    assert (sample_window_average (self) == 0);
+    assert (sample_window_rate (self) == 0);
+
+    sample_window_add (self, 100, 10);
+    assert (sample_window_size (self) == 1);
+    assert (sample_window_average (self) == 10);
+    assert (sample_window_min (self) == 10);
+    assert (sample_window_max (self) == 10);
+    assert (sample_window_rate (self) == 0);
+    assert (sample_window_ewma (self) == 10);
+
+    sample_window_add (self, 110, 30);
+    sample_window_add (self, 120, 20);
+    assert (sample_window_size (self) == 3);
+    assert (sample_window_average (self) == 20);
+    assert (sample_window_min (self) == 10);
+    assert (sample_window_max (self) == 30);
+    assert (sample_window_rate (self) == 0.5);      // (20 - 10) / 20
+    assert (sample_window_ewma (self) == 20);       // 10 -> 20 -> 20
+
+    // 10 drops out
+    sample_window_add (self, 130, 40);
+    assert (sample_window_size (self) == 3);
+    assert (sample_window_average (self) == 30);
+    assert (sample_window_min (self) == 20);
+    assert (sample_window_max (self) == 40);
+    assert (sample_window_rate (self) == 0.5);      // (40 - 30) / 20
+    assert (sample_window_ewma (self) == 30);
+
+    // 30 and 20 drop out
+    sample_window_add (self, 140, 5);
+    sample_window_add (self, 150, 6);
+    assert (sample_window_average (self) == 17);
+    assert (sample_window_min (self) == 5);
+    assert (sample_window_max (self) == 40);
+    sample_window_add (self, 160, 7);
+    assert (sample_window_max (self) == 7);
+    assert (sample_window_min (self) == 5);
+    assert (sample_window_rate (self) == 0.1);
+    sample_window_destroy (&self);
+    assert (self == NULL);
+
+    // compare with brute force over a longer sequence
+    self = sample_window_new (7, 0.2);
+    std::vector <double> all;
+    for (int i = 0; i < 1000; i++) {
+        double value = (i * 7919) % 101 - 50;
+        all.push_back (value);
+        sample_window_add (self, i, value);
+        size_t from = all.size () > 7 ? all.size () - 7 : 0;
+        double sum = 0, min = all [from], max = all [from];
+        for (size_t j = from; j < all.size (); j++) {
+            sum += all [j];
+            min = std::min (min, all [j]);
+            max = std::max (max, all [j]);
+        }
+        assert (fabs (sample_window_average (self) - sum / (all.size () - from)) < 1e-9);
+        assert (sample_window_min (self) == min);
+        assert (sample_window_max (self) == max);
+    }
+    sample_window_destroy (&self);
+
+    // capacity is at least 1
+    self = sample_window_new (0, 0);
+    sample_window_add (self, 1, 1);
+    sample_window_add (self, 2, 2);
+    assert (sample_window_size (self) == 1);
+    assert (sample_window_average (self) == 2);
+    assert (sample_window_ewma (self) == 2);        // alpha 1
+    sample_window_destroy (&self);
+    //  @end
+    log_info (" * sample_window: OK\n");
+}
@@ -0,0 +1,80 @@
+/*  =========================================================================
+    sample_window - ring buffer of samples with incremental window statistics
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef SAMPLE_WINDOW_H_INCLUDED
+#define SAMPLE_WINDOW_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _sample_window_t sample_window_t;
+
+//  @interface
+//  Create a new window of last 'capacity' samples (at least 1), 'alpha' is
+//  the smoothing factor of EWMA (0 < alpha <= 1)
+FTY_METRIC_COMPOSITE_EXPORT sample_window_t *
+    sample_window_new (size_t capacity, double alpha);
+
+//  Add sample, the oldest one is dropped when the window is full
+FTY_METRIC_COMPOSITE_EXPORT void
+    sample_window_add (sample_window_t *self, time_t time, double value);
+
+//  Get number of samples in the window
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    sample_window_size (sample_window_t *self);
+
+//  Get average of samples in the window
+FTY_METRIC_COMPOSITE_EXPORT double
+    sample_window_average (sample_window_t *self);
+
+//  Get minimum of samples in the window
+FTY_METRIC_COMPOSITE_EXPORT double
+    sample_window_min (sample_window_t *self);
+
+//  Get maximum of samples in the window
+FTY_METRIC_COMPOSITE_EXPORT double
+    sample_window_max (sample_window_t *self);
+
+//  Get rate of change per second between the oldest and the newest sample,
+//  0 if they have the same time
+FTY_METRIC_COMPOSITE_EXPORT double
+    sample_window_rate (sample_window_t *self);
+
+//  Get exponentially weighted moving average of all samples added so far
+FTY_METRIC_COMPOSITE_EXPORT double
+    sample_window_ewma (sample_window_t *self);
+
+//  Destroy the sample_window
+FTY_METRIC_COMPOSITE_EXPORT void
+    sample_window_destroy (sample_window_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    sample_window_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
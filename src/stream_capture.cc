@@ -0,0 +1,407 @@
+/*  =========================================================================
+    stream_capture - capture file of malamute stream traffic
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    stream_capture - capture file of malamute stream traffic
+@discuss
+    File starts with 8 bytes magic "FTYCAP" 0x00 0x01, followed by records:
+
+        timestamp   varint, zigzag encoded difference from previous record (us)
+        stream      varint length + bytes
+        subject     varint length + bytes
+        frames      varint count, then for each frame varint length + bytes
+
+    Varints are LEB128 (7 bits per byte, least significant first), so a
+    typical METRIC record costs only a few bytes on top of its frame.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+static const char MAGIC [8] = { 'F', 'T', 'Y', 'C', 'A', 'P', 0x00, 0x01 };
+
+struct _stream_capture_t {
+    FILE *file;
+    bool write;
+    bool error;
+    uint64_t size;              // of the file being read
+    uint64_t count;
+    int64_t timestamp;          // of the last record
+    std::string stream;         // of the last record read
+    std::string subject;        // of the last record read
+    std::vector <char> buffer;  // for reading of frames
+};
+
+static int
+s_write_varint (FILE *file, uint64_t value)
+{
+    unsigned char bytes [10];
+    size_t size = 0;
+    do {
+        unsigned char byte = value & 0x7f;
+        value >>= 7;
+        if (value)
+            byte |= 0x80;
+        bytes [size++] = byte;
+    } while (value);
+    return fwrite (bytes, 1, size, file) == size ? 0 : -1;
+}
+
+//  0 - success, 1 - clean end of file, -1 - error
+static int
+s_read_varint (FILE *file, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc (file);
+        if (byte == EOF)
+            return shift == 0 ? 1 : -1;
+        *value |= ((uint64_t) (byte & 0x7f)) << shift;
+        if (!(byte & 0x80))
+            return 0;
+    }
+    return -1;
+}
+
+static int
+s_write_bytes (FILE *file, const void *data, size_t size)
+{
+    if (s_write_varint (file, size) != 0)
+        return -1;
+    if (size > 0 && fwrite (data, 1, size, file) != size)
+        return -1;
+    return 0;
+}
+
+static int
+s_read_bytes (stream_capture_t *self, std::string *string)
+{
+    uint64_t size;
+    if (s_read_varint (self->file, &size) != 0)
+        return -1;
+    // corrupted length must not make the buffer huge
+    off_t position = ftello (self->file);
+    if (position < 0 || size > self->size - (uint64_t) position)
+        return -1;
+    self->buffer.resize (size);
+    if (size > 0 && fread (self->buffer.data (), 1, size, self->file) != size)
+        return -1;
+    if (string)
+        string->assign (self->buffer.data (), size);
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Open capture file for writing or reading
+
+stream_capture_t *
+stream_capture_new (const char *path, bool write)
+{
+    assert (path);
+    FILE *file = fopen (path, write ? "wb" : "rb");
+    if (!file) {
+        log_error ("Cannot open capture file '%s': %s", path, strerror (errno));
+        return NULL;
+    }
+    if (write) {
+        if (fwrite (MAGIC, 1, sizeof (MAGIC), file) != sizeof (MAGIC)) {
+            log_error ("Cannot write capture file '%s'", path);
+            fclose (file);
+            return NULL;
+        }
+    }
+    else {
+        char magic [sizeof (MAGIC)];
+        if (fread (magic, 1, sizeof (magic), file) != sizeof (magic) ||
+            memcmp (magic, MAGIC, sizeof (MAGIC)) != 0) {
+            log_error ("File '%s' is not a capture file", path);
+            fclose (file);
+            return NULL;
+        }
+    }
+    struct stat info;
+    if (!write && fstat (fileno (file), &info) != 0) {
+        log_error ("Cannot read capture file '%s': %s", path, strerror (errno));
+        fclose (file);
+        return NULL;
+    }
+    stream_capture_t *self = new stream_capture_t ();
+    self->file = file;
+    self->write = write;
+    self->size = write ? 0 : (uint64_t) info.st_size;
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Flush and close the file, destroy the stream_capture
+
+void
+stream_capture_destroy (stream_capture_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        stream_capture_t *self = *self_p;
+        fclose (self->file);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Append one message
+
+int
+stream_capture_write (stream_capture_t *self, int64_t timestamp, const char *stream, const char *subject, zmsg_t *content)
+{
+    assert (self);
+    assert (self->write);
+    assert (stream);
+    assert (subject);
+    assert (content);
+
+    int64_t delta = timestamp - self->timestamp;
+    uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+    if (s_write_varint (self->file, zigzag) != 0
+    ||  s_write_bytes (self->file, stream, strlen (stream)) != 0
+    ||  s_write_bytes (self->file, subject, strlen (subject)) != 0
+    ||  s_write_varint (self->file, zmsg_size (content)) != 0)
+        return -1;
+    for (zframe_t *frame = zmsg_first (content); frame; frame = zmsg_next (content)) {
+        if (s_write_bytes (self->file, zframe_data (frame), zframe_size (frame)) != 0)
+            return -1;
+    }
+    self->timestamp = timestamp;
+    self->count++;
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Read next message
+
+zmsg_t *
+stream_capture_read (stream_capture_t *self)
+{
+    assert (self);
+    assert (!self->write);
+    if (self->error)
+        return NULL;
+
+    uint64_t zigzag, frames;
+    int rv = s_read_varint (self->file, &zigzag);
+    if (rv == 1)
+        return NULL;    // end of file
+    if (rv != 0
+    ||  s_read_bytes (self, &self->stream) != 0
+    ||  s_read_bytes (self, &self->subject) != 0
+    ||  s_read_varint (self->file, &frames) != 0) {
+        self->error = true;
+        return NULL;
+    }
+    zmsg_t *content = zmsg_new ();
+    for (uint64_t i = 0; i < frames; i++) {
+        if (s_read_bytes (self, NULL) != 0) {
+            zmsg_destroy (&content);
+            self->error = true;
+            return NULL;
+        }
+        zmsg_addmem (content, self->buffer.data (), self->buffer.size ());
+    }
+    self->timestamp += (int64_t) ((zigzag >> 1) ^ -(zigzag & 1));
+    self->count++;
+    return content;
+}
+
+//  --------------------------------------------------------------------------
+//  Get timestamp of the message read last
+
+int64_t
+stream_capture_timestamp (stream_capture_t *self)
+{
+    assert (self);
+    return self->timestamp;
+}
+
+//  --------------------------------------------------------------------------
+//  Get stream of the message read last
+
+const char *
+stream_capture_stream (stream_capture_t *self)
+{
+    assert (self);
+    return self->stream.c_str ();
+}
+
+//  --------------------------------------------------------------------------
+//  Get subject of the message read last
+
+const char *
+stream_capture_subject (stream_capture_t *self)
+{
+    assert (self);
+    return self->subject.c_str ();
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of messages written or read so far
+
+uint64_t
+stream_capture_count (stream_capture_t *self)
+{
+    assert (self);
+    return self->count;
+}
+
+//  --------------------------------------------------------------------------
+//  Return true if reading stopped because of corrupted file
+
+bool
+stream_capture_error (stream_capture_t *self)
+{
+    assert (self);
+    return self->error;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+stream_capture_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("stream-capture-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    char *path = zsys_sprintf ("%s/stream-capture-test.cap", SELFTEST_DIR_RW);
+    assert (path);
+
+    // not a capture file
+    assert (stream_capture_new ("/nonexistent/file", false) == NULL);
+
+    stream_capture_t *self = stream_capture_new (path, true);
+    assert (self);
+    zmsg_t *metric = fty_proto_encode_metric (NULL, 1500000000, 60, "temperature", "TH1", "40", "C");
+    assert (metric);
+    int rv = stream_capture_write (self, 1500000000000000, "_METRICS_SENSOR", "temperature@TH1", metric);
+    assert (rv == 0);
+    // timestamps do not need to be monotonic
+    rv = stream_capture_write (self, 1499999999000000, "_METRICS_SENSOR", "temperature@TH1", metric);
+    assert (rv == 0);
+    zmsg_t *empty = zmsg_new ();
+    zmsg_addstr (empty, "");
+    zmsg_addstr (empty, "second frame");
+    rv = stream_capture_write (self, 1500000001000000, "ASSETS", "", empty);
+    assert (rv == 0);
+    assert (stream_capture_count (self) == 3);
+    stream_capture_destroy (&self);
+    assert (self == NULL);
+
+    self = stream_capture_new (path, false);
+    assert (self);
+    zmsg_t *content = stream_capture_read (self);
+    assert (content);
+    assert (stream_capture_timestamp (self) == 1500000000000000);
+    assert (streq (stream_capture_stream (self), "_METRICS_SENSOR"));
+    assert (streq (stream_capture_subject (self), "temperature@TH1"));
+    assert (zmsg_size (content) == zmsg_size (metric));
+    assert (zframe_eq (zmsg_first (content), zmsg_first (metric)));
+    fty_proto_t *proto = fty_proto_decode (&content);
+    assert (proto);
+    assert (streq (fty_proto_value (proto), "40"));
+    fty_proto_destroy (&proto);
+
+    content = stream_capture_read (self);
+    assert (content);
+    assert (stream_capture_timestamp (self) == 1499999999000000);
+    zmsg_destroy (&content);
+
+    content = stream_capture_read (self);
+    assert (content);
+    assert (stream_capture_timestamp (self) == 1500000001000000);
+    assert (streq (stream_capture_stream (self), "ASSETS"));
+    assert (streq (stream_capture_subject (self), ""));
+    assert (zmsg_size (content) == 2);
+    char *frame = zmsg_popstr (content);
+    assert (streq (frame, ""));
+    zstr_free (&frame);
+    frame = zmsg_popstr (content);
+    assert (streq (frame, "second frame"));
+    zstr_free (&frame);
+    zmsg_destroy (&content);
+
+    assert (stream_capture_read (self) == NULL);
+    assert (!stream_capture_error (self));
+    assert (stream_capture_count (self) == 3);
+    stream_capture_destroy (&self);
+
+    // truncated file is reported as error
+    {
+        FILE *file = fopen (path, "ab");
+        assert (file);
+        fputc (0x02, file);     // timestamp only
+        fclose (file);
+    }
+    self = stream_capture_new (path, false);
+    assert (self);
+    for (int i = 0; i < 3; i++) {
+        content = stream_capture_read (self);
+        assert (content);
+        zmsg_destroy (&content);
+    }
+    assert (stream_capture_read (self) == NULL);
+    assert (stream_capture_error (self));
+    stream_capture_destroy (&self);
+
+    // length beyond the end of file is an error, not an allocation
+    {
+        FILE *file = fopen (path, "wb");
+        assert (file);
+        fwrite (MAGIC, 1, sizeof (MAGIC), file);
+        fputc (0x00, file);     // timestamp
+        s_write_varint (file, (uint64_t) 1 << 62);
+        fclose (file);
+    }
+    self = stream_capture_new (path, false);
+    assert (self);
+    assert (stream_capture_read (self) == NULL);
+    assert (stream_capture_error (self));
+    stream_capture_destroy (&self);
+
+    zmsg_destroy (&empty);
+    zmsg_destroy (&metric);
+    unlink (path);
+    zstr_free (&path);
+    //  @end
+    log_info (" * stream_capture: OK\n");
+}
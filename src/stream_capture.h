@@ -0,0 +1,83 @@
+/*  =========================================================================
+    stream_capture - capture file of malamute stream traffic
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef STREAM_CAPTURE_H_INCLUDED
+#define STREAM_CAPTURE_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _stream_capture_t stream_capture_t;
+
+//  @interface
+//  Open capture file 'path' for writing (truncates it) or for reading.
+//  Returns NULL if file cannot be opened or is not a capture file.
+FTY_METRIC_COMPOSITE_EXPORT stream_capture_t *
+    stream_capture_new (const char *path, bool write);
+
+//  Append one message delivered on 'stream' with 'subject' at 'timestamp'
+//  (microseconds). Frames of 'content' are stored as they are, message is not
+//  destroyed. Returns 0 on success, -1 on error.
+FTY_METRIC_COMPOSITE_EXPORT int
+    stream_capture_write (stream_capture_t *self, int64_t timestamp, const char *stream, const char *subject, zmsg_t *content);
+
+//  Read next message; its timestamp, stream and subject are valid until the
+//  next read. Returns NULL at the end of file or on error (see stream_capture_error).
+//  The caller is responsible for destroying the return value when finished with it
+FTY_METRIC_COMPOSITE_EXPORT zmsg_t *
+    stream_capture_read (stream_capture_t *self);
+
+//  Get timestamp (microseconds) of the message read last
+FTY_METRIC_COMPOSITE_EXPORT int64_t
+    stream_capture_timestamp (stream_capture_t *self);
+
+//  Get stream of the message read last
+FTY_METRIC_COMPOSITE_EXPORT const char *
+    stream_capture_stream (stream_capture_t *self);
+
+//  Get subject of the message read last
+FTY_METRIC_COMPOSITE_EXPORT const char *
+    stream_capture_subject (stream_capture_t *self);
+
+//  Get number of messages written or read so far
+FTY_METRIC_COMPOSITE_EXPORT uint64_t
+    stream_capture_count (stream_capture_t *self);
+
+//  Return true if reading stopped because of corrupted file
+FTY_METRIC_COMPOSITE_EXPORT bool
+    stream_capture_error (stream_capture_t *self);
+
+//  Flush and close the file, destroy the stream_capture
+FTY_METRIC_COMPOSITE_EXPORT void
+    stream_capture_destroy (stream_capture_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    stream_capture_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
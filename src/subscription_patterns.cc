@@ -0,0 +1,200 @@
+/*  =========================================================================
+    subscription_patterns - minimal set of stream subscription patterns for topics
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    subscription_patterns - minimal set of stream subscription patterns for topics
+@discuss
+    Every mlm_client_set_consumer is a synchronous round trip to malamute
+    and every pattern is one more regular expression the broker matches
+    against each message of the stream. Instead of one ^topic$ per input
+    the topics are combined into alternations per metric type:
+
+        ^temperature@(Sensor12|Sensor2|Sensor1)$
+
+    Alternatives are ordered longest first: zrex takes the first branch of
+    a group which matches and does not backtrack into the others, and only
+    this order makes the anchored pattern match the whole topic when one
+    asset name is a prefix of another. Patterns are split so that none is
+    longer than malamute accepts.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+//  --------------------------------------------------------------------------
+//  Escape regular expression metacharacters
+
+std::string
+subscription_patterns_escape (const std::string &text)
+{
+    static const char *to_be_escaped = ".^$|()[]{}*+?\\";
+    std::string result;
+
+    for (char c: text) {
+        if (strchr (to_be_escaped, c)) {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+//  Pattern of 'prefix' followed by one of 'alternatives'
+static std::string
+s_pattern (const std::string &prefix, const std::vector <std::string> &alternatives)
+{
+    if (alternatives.size () == 1)
+        return "^" + prefix + alternatives [0] + "$";
+    std::string pattern = "^" + prefix + "(";
+    for (size_t i = 0; i < alternatives.size (); i++) {
+        if (i > 0)
+            pattern += "|";
+        pattern += alternatives [i];
+    }
+    return pattern + ")$";
+}
+
+//  --------------------------------------------------------------------------
+//  Build anchored patterns matching exactly 'topics'
+
+std::vector <std::string>
+subscription_patterns_build (const std::vector <std::string> &topics, size_t max_length)
+{
+    // escaped type@ -> escaped assets, types in order of appearance
+    std::vector <std::string> prefixes;
+    std::map <std::string, std::vector <std::string>> alternatives;
+    std::set <std::string> seen;
+    for (const auto &topic : topics) {
+        if (!seen.insert (topic).second)
+            continue;
+        size_t at = topic.rfind ('@');
+        std::string prefix = at == std::string::npos ? "" : subscription_patterns_escape (topic.substr (0, at + 1));
+        std::string rest = at == std::string::npos ? topic : topic.substr (at + 1);
+        if (alternatives.find (prefix) == alternatives.end ())
+            prefixes.push_back (prefix);
+        alternatives [prefix].push_back (subscription_patterns_escape (rest));
+    }
+
+    std::vector <std::string> patterns;
+    for (const auto &prefix : prefixes) {
+        std::vector <std::string> &list = alternatives [prefix];
+        std::stable_sort (list.begin (), list.end (),
+            [] (const std::string &a, const std::string &b) { return a.length () > b.length (); });
+
+        // ^prefix( ... )$
+        size_t base = prefix.length () + 4;
+        std::vector <std::string> chunk;
+        size_t length = base;
+        for (const auto &alternative : list) {
+            size_t added = alternative.length () + (chunk.empty () ? 0 : 1);
+            if (!chunk.empty () && length + added > max_length) {
+                patterns.push_back (s_pattern (prefix, chunk));
+                chunk.clear ();
+                length = base;
+                added = alternative.length ();
+            }
+            chunk.push_back (alternative);
+            length += added;
+        }
+        if (!chunk.empty ())
+            patterns.push_back (s_pattern (prefix, chunk));
+    }
+    return patterns;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+//  Number of 'patterns' matching 'topic'
+static int
+s_matches (const std::vector <std::string> &patterns, const char *topic)
+{
+    int count = 0;
+    for (const auto &pattern : patterns) {
+        zrex_t *rex = zrex_new (pattern.c_str ());
+        assert (zrex_valid (rex));
+        if (zrex_matches (rex, topic))
+            count++;
+        zrex_destroy (&rex);
+    }
+    return count;
+}
+
+void
+subscription_patterns_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("subscription-patterns-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    assert (subscription_patterns_escape ("average.temperature@DC-1 (main)") == "average\\.temperature@DC-1 \\(main\\)");
+    assert (subscription_patterns_build (std::vector <std::string> (), 255).empty ());
+
+    std::vector <std::string> topics = {
+        "temperature@Sensor1", "humidity@Sensor1", "temperature@Sensor12",
+        "temperature@Sensor2", "temperature@Sensor1", "plain.topic"
+    };
+    std::vector <std::string> patterns = subscription_patterns_build (topics, 255);
+    assert (patterns.size () == 3);
+    assert (patterns [0] == "^temperature@(Sensor12|Sensor1|Sensor2)$");
+    assert (patterns [1] == "^humidity@Sensor1$");
+    assert (patterns [2] == "^plain\\.topic$");
+    for (const auto &topic : topics)
+        assert (s_matches (patterns, topic.c_str ()) == 1);
+    assert (s_matches (patterns, "temperature@Sensor") == 0);
+    assert (s_matches (patterns, "temperature@Sensor123") == 0);
+    assert (s_matches (patterns, "xtemperature@Sensor1") == 0);
+    assert (s_matches (patterns, "humidity@Sensor2") == 0);
+    assert (s_matches (patterns, "plainxtopic") == 0);
+
+    // many inputs are split by length
+    topics.clear ();
+    for (int i = 0; i < 400; i++) {
+        char topic [64];
+        snprintf (topic, sizeof (topic), "temperature@sensor-%d", i);
+        topics.push_back (topic);
+    }
+    patterns = subscription_patterns_build (topics, SUBSCRIPTION_PATTERNS_MAX_LENGTH);
+    assert (patterns.size () < 40);
+    for (const auto &pattern : patterns)
+        assert (pattern.length () <= SUBSCRIPTION_PATTERNS_MAX_LENGTH);
+    for (const auto &topic : topics)
+        assert (s_matches (patterns, topic.c_str ()) == 1);
+    assert (s_matches (patterns, "temperature@sensor-400") == 0);
+    if (verbose)
+        log_debug ("%zu topics -> %zu patterns", topics.size (), patterns.size ());
+    //  @end
+    log_info (" * subscription_patterns: OK\n");
+}
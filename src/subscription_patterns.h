@@ -0,0 +1,56 @@
+/*  =========================================================================
+    subscription_patterns - minimal set of stream subscription patterns for topics
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef SUBSCRIPTION_PATTERNS_H_INCLUDED
+#define SUBSCRIPTION_PATTERNS_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+//  Longest pattern malamute accepts (string field of mlm_proto)
+#define SUBSCRIPTION_PATTERNS_MAX_LENGTH 255
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Escape regular expression metacharacters in 'text'
+FTY_METRIC_COMPOSITE_EXPORT std::string
+    subscription_patterns_escape (const std::string &text);
+
+//  Build anchored patterns, each at most 'max_length' characters long, which
+//  together match exactly 'topics'. Topics of the same type (part before '@')
+//  share one alternation ^type@(asset1|asset2|...)$ as far as the length allows.
+FTY_METRIC_COMPOSITE_EXPORT std::vector <std::string>
+    subscription_patterns_build (const std::vector <std::string> &topics, size_t max_length);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    subscription_patterns_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,300 @@
+/*  =========================================================================
+    topology_generator - synthetic asset topology for tests and benchmarks
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    topology_generator - synthetic asset topology for tests and benchmarks
+@discuss
+    Generates ASSET messages of datacenters, rooms, rows, racks, one epdu
+    per rack and sensors attached to the epdu and logically assigned to
+    the rack, exactly as the configurator expects them from fty-asset.
+    Messages are generated lazily from the position in the topology, so
+    the generator itself takes no memory even for huge inventories.
+@end
+*/
+
+#include "fty_metric_composite_classes.h"
+
+#include <string>
+#include <set>
+#include <algorithm>
+
+struct _topology_generator_t {
+    size_t datacenters;
+    size_t rooms;           // per datacenter
+    size_t rows;            // per room
+    size_t racks;           // per row
+    size_t sensors;         // per rack
+    // number of assets in one subtree
+    size_t rack_size;
+    size_t row_size;
+    size_t room_size;
+    size_t datacenter_size;
+    size_t position;        // next asset to generate
+};
+
+//  --------------------------------------------------------------------------
+//  Create a new generator of the topology
+
+topology_generator_t *
+topology_generator_new (size_t datacenters, size_t rooms, size_t rows, size_t racks, size_t sensors)
+{
+    topology_generator_t *self = (topology_generator_t *) zmalloc (sizeof (topology_generator_t));
+    if (self) {
+        self->datacenters = datacenters;
+        self->rooms = rooms;
+        self->rows = rows;
+        self->racks = racks;
+        self->sensors = sensors;
+        self->rack_size = 2 + sensors;  // rack + epdu + sensors
+        self->row_size = 1 + racks * self->rack_size;
+        self->room_size = 1 + rows * self->row_size;
+        self->datacenter_size = 1 + rooms * self->room_size;
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new generator of topology with (at least) 'assets' assets
+
+topology_generator_t *
+topology_generator_new_for_size (size_t assets)
+{
+    static const size_t SENSORS = 4, MAX_RACKS = 10, MAX_ROWS = 10, MAX_ROOMS = 4;
+
+    size_t racks_total = (assets + SENSORS + 1) / (SENSORS + 2);
+    if (racks_total == 0)
+        racks_total = 1;
+    size_t racks = std::min (racks_total, MAX_RACKS);
+    size_t rows_total = (racks_total + racks - 1) / racks;
+    size_t rows = std::min (rows_total, MAX_ROWS);
+    size_t rooms_total = (rows_total + rows - 1) / rows;
+    size_t rooms = std::min (rooms_total, MAX_ROOMS);
+    size_t datacenters = (rooms_total + rooms - 1) / rooms;
+    return topology_generator_new (datacenters, rooms, rows, racks, SENSORS);
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the topology_generator
+
+void
+topology_generator_destroy (topology_generator_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        topology_generator_t *self = *self_p;
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Get total number of assets of the topology
+
+size_t
+topology_generator_size (topology_generator_t *self)
+{
+    assert (self);
+    return self->datacenters * self->datacenter_size;
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of sensors of the topology
+
+size_t
+topology_generator_sensors (topology_generator_t *self)
+{
+    assert (self);
+    return topology_generator_racks (self) * self->sensors;
+}
+
+//  --------------------------------------------------------------------------
+//  Get number of racks of the topology
+
+size_t
+topology_generator_racks (topology_generator_t *self)
+{
+    assert (self);
+    return self->datacenters * self->rooms * self->rows * self->racks;
+}
+
+//  --------------------------------------------------------------------------
+//  Start generating from the first asset again
+
+void
+topology_generator_reset (topology_generator_t *self)
+{
+    assert (self);
+    self->position = 0;
+}
+
+static fty_proto_t *
+s_asset_new (const std::string &name, const char *type, const char *subtype, const std::string *parents, size_t parents_count)
+{
+    fty_proto_t *asset = fty_proto_new (FTY_PROTO_ASSET);
+    fty_proto_set_name (asset, "%s", name.c_str ());
+    fty_proto_set_operation (asset, "%s", FTY_PROTO_ASSET_OP_CREATE);
+    fty_proto_aux_insert (asset, "status", "%s", "active");
+    fty_proto_aux_insert (asset, "type", "%s", type);
+    fty_proto_aux_insert (asset, "subtype", "%s", subtype);
+    // parents [0] is the closest one
+    for (size_t i = 0; i < parents_count; i++) {
+        char key [32];
+        snprintf (key, sizeof (key), "parent_name.%zu", i + 1);
+        fty_proto_aux_insert (asset, key, "%s", parents [i].c_str ());
+    }
+    return asset;
+}
+
+//  --------------------------------------------------------------------------
+//  Get next ASSET message, parents always go before their children
+
+fty_proto_t *
+topology_generator_next (topology_generator_t *self)
+{
+    assert (self);
+    if (self->position >= topology_generator_size (self))
+        return NULL;
+
+    size_t index = self->position++;
+    // parents of the current asset, the closest one first
+    std::string path [5];
+
+    size_t datacenter = index / self->datacenter_size;
+    size_t rest = index % self->datacenter_size;
+    path [3] = "DC" + std::to_string (datacenter + 1);
+    if (rest == 0)
+        return s_asset_new (path [3], "datacenter", "unknown", NULL, 0);
+
+    rest -= 1;
+    size_t room = rest / self->room_size;
+    rest = rest % self->room_size;
+    path [2] = path [3] + ".Room" + std::to_string (room + 1);
+    if (rest == 0)
+        return s_asset_new (path [2], "room", "unknown", path + 3, 1);
+
+    rest -= 1;
+    size_t row = rest / self->row_size;
+    rest = rest % self->row_size;
+    path [1] = path [2] + ".Row" + std::to_string (row + 1);
+    if (rest == 0)
+        return s_asset_new (path [1], "row", "unknown", path + 2, 2);
+
+    rest -= 1;
+    size_t rack = rest / self->rack_size;
+    rest = rest % self->rack_size;
+    path [0] = path [1] + ".Rack" + std::to_string (rack + 1);
+    if (rest == 0) {
+        fty_proto_t *asset = s_asset_new (path [0], "rack", "unknown", path + 1, 3);
+        fty_proto_ext_insert (asset, "u_size", "%s", "42");
+        return asset;
+    }
+    std::string epdu = path [0] + ".epdu";
+    if (rest == 1)
+        return s_asset_new (epdu, "device", "epdu", path, 4);
+
+    size_t sensor = rest - 2;
+    std::string parents [5] = { epdu, path [0], path [1], path [2], path [3] };
+    fty_proto_t *asset = s_asset_new (path [0] + ".Sensor" + std::to_string (sensor + 1), "device", "sensor", parents, 5);
+    fty_proto_ext_insert (asset, "port", "TH%zu", sensor + 1);
+    fty_proto_ext_insert (asset, "calibration_offset_t", "%s", "0.0");
+    fty_proto_ext_insert (asset, "calibration_offset_h", "%s", "0.0");
+    fty_proto_ext_insert (asset, "sensor_function", "%s", sensor % 2 == 0 ? "input" : "output");
+    fty_proto_ext_insert (asset, "logical_asset", "%s", path [0].c_str ());
+    return asset;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+topology_generator_test (bool verbose)
+{
+    ManageFtyLog::setInstanceFtylog ("topology-generator-test", "");
+    if ( verbose )
+        ManageFtyLog::getInstanceFtylog()->setVeboseMode();
+    // Note: If your selftest reads SCMed fixture data, please keep it in
+    // src/selftest-ro; if your test creates filesystem objects, please
+    // do so under src/selftest-rw. They are defined below along with a
+    // usecase (asert) to make compilers happy.
+    const char *SELFTEST_DIR_RO = "src/selftest-ro";
+    const char *SELFTEST_DIR_RW = "src/selftest-rw";
+    assert (SELFTEST_DIR_RO);
+    assert (SELFTEST_DIR_RW);
+
+    //  @selftest
+    topology_generator_t *self = topology_generator_new (1, 2, 2, 3, 4);
+    assert (self);
+    assert (topology_generator_size (self) == 79);
+    assert (topology_generator_racks (self) == 12);
+    assert (topology_generator_sensors (self) == 48);
+
+    data_t *data = data_new ();
+    std::set <std::string> seen;
+    size_t count = 0, sensors = 0, racks = 0;
+    fty_proto_t *asset = topology_generator_next (self);
+    assert (streq (fty_proto_aux_string (asset, "type", ""), "datacenter"));
+    while (asset) {
+        count++;
+        // parents go first
+        const char *parent = fty_proto_aux_string (asset, "parent_name.1", NULL);
+        if (parent)
+            assert (seen.count (parent) == 1);
+        seen.insert (fty_proto_name (asset));
+        if (streq (fty_proto_aux_string (asset, "subtype", ""), "sensor"))
+            sensors++;
+        if (streq (fty_proto_aux_string (asset, "type", ""), "rack"))
+            racks++;
+        data_asset_store (data, &asset);
+        assert (asset == NULL);
+        asset = topology_generator_next (self);
+    }
+    assert (count == 79);
+    assert (sensors == 48);
+    assert (racks == 12);
+    assert (topology_generator_next (self) == NULL);
+
+    // configurator places all the sensors
+    data_reassign_sensors (data, false);
+    assert (data_sensors_placed (data) == 48);
+    zlistx_t *assigned = data_get_assigned_sensors (data, "DC1.Room2.Row1.Rack3", "input");
+    assert (assigned);
+    assert (zlistx_size (assigned) == 2);
+    zlistx_destroy (&assigned);
+    data_destroy (&data);
+
+    topology_generator_reset (self);
+    asset = topology_generator_next (self);
+    assert (streq (fty_proto_name (asset), "DC1"));
+    fty_proto_destroy (&asset);
+    topology_generator_destroy (&self);
+
+    for (size_t size : {1, 100, 1000, 10000, 100000}) {
+        self = topology_generator_new_for_size (size);
+        assert (self);
+        assert (topology_generator_size (self) >= size);
+        // not much bigger than asked
+        assert (topology_generator_size (self) <= size + size / 4 + 10);
+        topology_generator_destroy (&self);
+    }
+    //  @end
+    log_info (" * topology_generator: OK\n");
+}
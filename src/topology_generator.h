@@ -0,0 +1,79 @@
+/*  =========================================================================
+    topology_generator - synthetic asset topology for tests and benchmarks
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef TOPOLOGY_GENERATOR_H_INCLUDED
+#define TOPOLOGY_GENERATOR_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _topology_generator_t topology_generator_t;
+
+//  @interface
+//  Create a new generator of 'datacenters' x 'rooms' x 'rows' x 'racks' topology,
+//  each rack has one epdu and 'sensors' sensors (alternately input and output)
+FTY_METRIC_COMPOSITE_EXPORT topology_generator_t *
+    topology_generator_new (size_t datacenters, size_t rooms, size_t rows, size_t racks, size_t sensors);
+
+//  Create a new generator of topology with (at least) 'assets' assets and
+//  realistic shape: 4 sensors per rack, up to 10 racks per row, 10 rows per room
+//  and 4 rooms per datacenter
+FTY_METRIC_COMPOSITE_EXPORT topology_generator_t *
+    topology_generator_new_for_size (size_t assets);
+
+//  Get total number of assets of the topology
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    topology_generator_size (topology_generator_t *self);
+
+//  Get number of sensors of the topology
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    topology_generator_sensors (topology_generator_t *self);
+
+//  Get number of racks of the topology
+FTY_METRIC_COMPOSITE_EXPORT size_t
+    topology_generator_racks (topology_generator_t *self);
+
+//  Get next ASSET message (operation CREATE), parents always go before
+//  their children. Returns NULL when all assets were generated.
+//  The caller is responsible for destroying the return value when finished with it
+FTY_METRIC_COMPOSITE_EXPORT fty_proto_t *
+    topology_generator_next (topology_generator_t *self);
+
+//  Start generating from the first asset again
+FTY_METRIC_COMPOSITE_EXPORT void
+    topology_generator_reset (topology_generator_t *self);
+
+//  Destroy the topology_generator
+FTY_METRIC_COMPOSITE_EXPORT void
+    topology_generator_destroy (topology_generator_t **self_p);
+
+//  Self test of this class
+FTY_METRIC_COMPOSITE_EXPORT void
+    topology_generator_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif